@@ -1,8 +1,12 @@
 #pragma once
+#ifdef LUMON_GLES
+#include <GLES3/gl3.h>
+#else
 #include <GL/glew.h>
+#endif
 
 struct Image
 {
     GLuint texture;
     int width, height;
-};
\ No newline at end of file
+};
@@ -0,0 +1,39 @@
+#include "ImageBatch.h"
+
+#include <algorithm>
+
+// A single reservation has to stay below the 16-bit index limit
+static constexpr int maxQuadsPerReserve = 65536 / 4 - 1;
+
+ImageBatch::ImageBatch(ImDrawList* drawList, const ImageAtlas& atlas, int quadCountHint)
+    : drawList(drawList), atlas(atlas), quadsPending(quadCountHint)
+{
+    drawList->PushTextureID(atlas.texture);
+}
+
+ImageBatch::~ImageBatch()
+{
+    // Give back what wasn't used
+    if (quadsReserved > 0) {
+        drawList->PrimUnreserve(quadsReserved * 6, quadsReserved * 4);
+    }
+    drawList->PopTextureID();
+}
+
+void ImageBatch::add(int image, const ImVec2& pos, float scale, ImU32 col)
+{
+    if (quadsReserved == 0) {
+        reserve();
+    }
+
+    const auto &atlasImage = atlas.images[image];
+    drawList->PrimRectUV(pos, ImVec2(pos.x + atlasImage.size.x*scale, pos.y + atlasImage.size.y*scale), atlasImage.uv0, atlasImage.uv1, col);
+    quadsReserved--;
+    quadsPending = std::max(quadsPending - 1, 0);
+}
+
+void ImageBatch::reserve()
+{
+    quadsReserved = std::clamp(quadsPending, 1, maxQuadsPerReserve);
+    drawList->PrimReserve(quadsReserved * 6, quadsReserved * 4);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "ImageDisplay.h"
+
+// Writes atlas images as quads straight into a draw list, skipping ImGui item layout.
+// Every quad shares the atlas texture and the draw list's current clip rect.
+class ImageBatch {
+public:
+    ImageBatch(ImDrawList* drawList, const ImageAtlas& atlas, int quadCountHint);
+    ~ImageBatch();
+
+    ImageBatch(const ImageBatch&) = delete;
+    ImageBatch& operator=(const ImageBatch&) = delete;
+
+    // Draws the atlas image at screen position pos (top left corner) scaled by scale
+    void add(int image, const ImVec2& pos, float scale, ImU32 col);
+
+private:
+    void reserve();
+
+    ImDrawList* drawList;
+    const ImageAtlas& atlas;
+    int quadsPending;
+    int quadsReserved = 0;
+};
@@ -1,10 +1,10 @@
 #include "ImageDisplay.h"
 
 #include "Image.h"
+#include "Log.h"
 
-#include <GL/glew.h>
+#include <algorithm>
 #include <unordered_map>
-#include <iostream>
 #include <optional>
 
 #define _CRT_SECURE_NO_WARNINGS
@@ -20,12 +20,14 @@ public:
         for (const auto& pair : imageCache) {
             glDeleteTextures(1, &pair.second.texture);
         }
+        for (auto texture : atlasTextures) {
+            glDeleteTextures(1, &texture);
+        }
     }
 
     void drawImGuiImage(const std::string& imagePath, float scale, std::optional<ImVec4> tint) final
     {
-        auto filePath = assetDir + imagePath;
-        if (auto image = getImageForFile(filePath)) {
+        if (auto image = getImage(imagePath)) {
             ImGui::Image((ImTextureID)(intptr_t)image->texture, ImVec2(image->width*scale, image->height*scale),
                         ImVec2(0,0), ImVec2(1,1), tint.value_or(ImVec4(1,1,1,1)));
         }
@@ -33,69 +35,149 @@ public:
 
     std::pair<int, int> getImageSize(const std::string &imagePath) final
     {
-        auto filePath = assetDir + imagePath;
-        if (auto image = getImageForFile(filePath)) {
+        if (auto image = getImage(imagePath)) {
             return std::make_pair(image->width, image->height);
         }
         return std::make_pair(0, 0);
     }
 
-    std::optional<Image> getImageForFile(const std::string& filePath)
+    // Cached by the path relative to the asset directory, so a hit doesn't build a path string
+    std::optional<Image> getImage(const std::string& imagePath)
     {
-        if (auto it = imageCache.find(filePath); it != imageCache.end()) {
+        if (auto it = imageCache.find(imagePath); it != imageCache.end()) {
             // Return from cache
             return it->second;
         }
 
         // Load as new into cache
-        return loadImageFromFile(filePath);
+        return loadImage(imagePath);
+    }
+
+    std::optional<Image> loadImage(const std::string &imagePath)
+    {
+        auto filePath = assetDir + imagePath;
+        auto pixels = loadPixelsFromFile(filePath);
+        if (!pixels) {
+            return std::nullopt;
+        }
+
+        // Cache the loaded image
+        auto newImage = Image{createTexture(pixels->data.data(), pixels->width, pixels->height), pixels->width, pixels->height};
+        imageCache.emplace(imagePath, newImage);
+        imageCacheBytes += textureBytes(pixels->width, pixels->height);
+        LOG_DEBUG("New image saved to cache: %s", filePath.c_str());
+        return newImage;
+    }
+
+    std::shared_ptr<const ImageAtlas> createImageAtlas(const std::vector<std::string>& imagePaths) final
+    {
+        std::vector<Pixels> sources;
+        for (const auto &imagePath : imagePaths) {
+            sources.push_back(loadPixelsFromFile(assetDir + imagePath).value_or(Pixels{}));
+        }
+
+        // Shelf packing, with a transparent gutter so linear filtering doesn't bleed between images
+        constexpr int padding = 2;
+        constexpr int maxAtlasWidth = 2048;
+        std::vector<std::pair<int, int>> offsets;
+        int atlasWidth = 0, atlasHeight = 0;
+        int shelfX = 0, shelfY = 0, shelfHeight = 0;
+        for (const auto &source : sources) {
+            if (shelfX > 0 && shelfX + source.width + padding*2 > maxAtlasWidth) {
+                shelfX = 0;
+                shelfY += shelfHeight;
+                shelfHeight = 0;
+            }
+            offsets.emplace_back(shelfX + padding, shelfY + padding);
+            shelfX += source.width + padding*2;
+            shelfHeight = std::max(shelfHeight, source.height + padding*2);
+            atlasWidth = std::max(atlasWidth, shelfX);
+            atlasHeight = std::max(atlasHeight, shelfY + shelfHeight);
+        }
+
+        auto atlas = std::make_shared<ImageAtlas>();
+        if (atlasWidth == 0 || atlasHeight == 0) {
+            LOG_ERROR("No images could be loaded into the atlas");
+            atlas->images.resize(sources.size());
+            return atlas;
+        }
+
+        std::vector<unsigned char> atlasPixels(static_cast<size_t>(atlasWidth) * atlasHeight * 4, 0);
+        for (size_t i = 0; i < sources.size(); i++) {
+            const auto &source = sources[i];
+            auto [x, y] = offsets[i];
+            for (int row = 0; row < source.height; row++) {
+                std::copy_n(&source.data[static_cast<size_t>(row) * source.width * 4], source.width * 4,
+                            &atlasPixels[(static_cast<size_t>(y + row) * atlasWidth + x) * 4]);
+            }
+            atlas->images.push_back(AtlasImage{ImVec2(static_cast<float>(source.width), static_cast<float>(source.height)),
+                                               ImVec2(static_cast<float>(x) / atlasWidth, static_cast<float>(y) / atlasHeight),
+                                               ImVec2(static_cast<float>(x + source.width) / atlasWidth, static_cast<float>(y + source.height) / atlasHeight)});
+        }
+
+        GLuint texture = createTexture(atlasPixels.data(), atlasWidth, atlasHeight);
+        atlasTextures.push_back(texture);
+        atlasBytes += textureBytes(atlasWidth, atlasHeight);
+        atlas->texture = (ImTextureID)(intptr_t)texture;
+        LOG_DEBUG("Packed %zu images into a %dx%d atlas", sources.size(), atlasWidth, atlasHeight);
+        return atlas;
     }
 
-    std::optional<Image> loadImageFromFile(const std::string &filePath)
+    std::pair<size_t, size_t> getTextureBytes() const final
+    {
+        return std::make_pair(imageCacheBytes, atlasBytes);
+    }
+
+    static size_t textureBytes(int width, int height)
+    {
+        return static_cast<size_t>(width) * height * 4;
+    }
+
+    // Decoded RGBA pixels of an image file
+    struct Pixels
+    {
+        std::vector<unsigned char> data;
+        int width = 0;
+        int height = 0;
+    };
+
+    std::optional<Pixels> loadPixelsFromFile(const std::string &filePath)
     {
         // Load texture from file
         FILE* f = fopen(filePath.c_str(), "rb");
         if (f == NULL) {
-            std::cerr << "Failed to open file " << filePath << std::endl;
+            LOG_ERROR("Failed to open file %s", filePath.c_str());
             return std::nullopt;
         }
         fseek(f, 0, SEEK_END);
         size_t file_size = (size_t)ftell(f);
         if (file_size == -1){
-            std::cerr << "Failed to get file size of file " << filePath << std::endl;
+            LOG_ERROR("Failed to get file size of file %s", filePath.c_str());
+            fclose(f);
             return std::nullopt;
         }
         fseek(f, 0, SEEK_SET);
         void* file_data = IM_ALLOC(file_size);
         fread(file_data, 1, file_size, f);
+        fclose(f);
 
-        int out_width = 0;
-        int out_height = 0;
-        GLuint out_texture = 0;
-        bool ret = loadTextureFromMemory(file_data, file_size, &out_texture, &out_width, &out_height);
+        // From https://github.com/ocornut/imgui/wiki/Image-Loading-and-Displaying-Examples
+        int image_width = 0;
+        int image_height = 0;
+        unsigned char* image_data = stbi_load_from_memory((const unsigned char*)file_data, (int)file_size, &image_width, &image_height, NULL, 4);
         IM_FREE(file_data);
-
-        if (ret) {
-            // Cache the loaded image
-            auto newImage = Image{out_texture, out_width, out_height};
-            imageCache.emplace(filePath, newImage);
-            std::cout << "New image saved to cache: " << filePath << std::endl;
-            return newImage;
+        if (image_data == NULL) {
+            LOG_ERROR("Failed to decode image %s", filePath.c_str());
+            return std::nullopt;
         }
 
-        return std::nullopt;
+        Pixels pixels{std::vector<unsigned char>(image_data, image_data + static_cast<size_t>(image_width) * image_height * 4), image_width, image_height};
+        stbi_image_free(image_data);
+        return pixels;
     }
 
-    // From https://github.com/ocornut/imgui/wiki/Image-Loading-and-Displaying-Examples
-    bool loadTextureFromMemory(const void* data, size_t data_size, GLuint* out_texture, int* out_width, int* out_height)
+    GLuint createTexture(const unsigned char* rgba, int width, int height)
     {
-        int image_width = 0;
-        int image_height = 0;
-        unsigned char* image_data = stbi_load_from_memory((const unsigned char*)data, (int)data_size, &image_width, &image_height, NULL, 4);
-        if (image_data == NULL) {
-            return false;
-        }
-
         GLuint image_texture;
         glGenTextures(1, &image_texture);
         glBindTexture(GL_TEXTURE_2D, image_texture);
@@ -103,19 +185,23 @@ public:
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image_width, image_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_data);
-        stbi_image_free(image_data);
+        // GLES 2.0 only samples non-power-of-two textures with clamped wrapping
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-        *out_texture = image_texture;
-        *out_width = image_width;
-        *out_height = image_height;
+#ifndef LUMON_GLES
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+#endif
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
 
-        return true;
+        return image_texture;
     }
 
     std::string assetDir;
     std::unordered_map<std::string, Image> imageCache;
+    std::vector<GLuint> atlasTextures;
+    size_t imageCacheBytes = 0;
+    size_t atlasBytes = 0;
 };
 
 std::shared_ptr<ImageDisplay> createImageDisplay(const std::string& assetDir)
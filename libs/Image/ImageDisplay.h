@@ -5,13 +5,34 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
+// Region of an atlas texture holding one of its source images
+struct AtlasImage
+{
+    ImVec2 size;
+    ImVec2 uv0, uv1;
+};
+
+// Several images packed into one texture, so they can be drawn together in a single batch
+struct ImageAtlas
+{
+    ImTextureID texture = 0;
+    std::vector<AtlasImage> images;
+};
+
 class ImageDisplay {
 public:
     virtual void drawImGuiImage(const std::string& imagePath, float scale, std::optional<ImVec4> tint) = 0;
     virtual std::pair<int, int> getImageSize(const std::string &imagePath) = 0;
 
+    // Images keep the order of imagePaths, a missing file leaves an empty region
+    virtual std::shared_ptr<const ImageAtlas> createImageAtlas(const std::vector<std::string>& imagePaths) = 0;
+
+    // Bytes of texture memory held by individually cached images and by atlases
+    virtual std::pair<size_t, size_t> getTextureBytes() const = 0;
+
     virtual ~ImageDisplay() = default;
 };
 
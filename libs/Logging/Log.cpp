@@ -0,0 +1,174 @@
+#include "Log.h"
+
+#include <array>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+    constexpr size_t messageCapacity = 256;
+    constexpr size_t ringCapacity = 1024; // Power of two
+    constexpr auto flushInterval = std::chrono::milliseconds(50);
+
+    struct LogRecord
+    {
+        double timestamp;
+        LogLevel level;
+        char message[messageCapacity];
+    };
+
+    const char* levelName(LogLevel level)
+    {
+        switch (level) {
+            case LogLevel::Debug: return "DEBUG";
+            case LogLevel::Info: return "INFO";
+            case LogLevel::Warning: return "WARNING";
+            case LogLevel::Error: return "ERROR";
+        }
+        return "";
+    }
+}
+
+class LoggerImpl : public Logger
+{
+public:
+    LoggerImpl() : startTime(std::chrono::steady_clock::now())
+    {
+        for (size_t i = 0; i < ringCapacity; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        flushThread = std::thread([this] { run(); });
+    }
+
+    ~LoggerImpl() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping = true;
+        }
+        wakeFlusher.notify_one();
+        flushThread.join();
+    }
+
+    void write(LogLevel level, const char* format, ...) final
+    {
+        // Multi-producer bounded queue (Vyukov): claim a slot by sequence number, never wait
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        Slot* slot;
+        for (;;) {
+            slot = &slots[pos & (ringCapacity - 1)];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->record.timestamp = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        slot->record.level = level;
+        va_list args;
+        va_start(args, format);
+        vsnprintf(slot->record.message, messageCapacity, format, args);
+        va_end(args);
+
+        slot->sequence.store(pos + 1, std::memory_order_release);
+    }
+
+    void flush() final
+    {
+        size_t target = enqueuePos.load(std::memory_order_acquire);
+        wakeFlusher.notify_one();
+        while (flushedPos.load(std::memory_order_acquire) < target) {
+            // Once shutdown has begun the flusher drains one last time and exits, nothing is left to wait for
+            if (stopping.load(std::memory_order_acquire)) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        LogRecord record;
+    };
+
+    void run()
+    {
+        for (;;) {
+            bool stop;
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wakeFlusher.wait_for(lock, flushInterval);
+                stop = stopping;
+            }
+            drain();
+            if (stop) {
+                return;
+            }
+        }
+    }
+
+    // Single consumer side of the queue
+    void drain()
+    {
+        bool wroteOut = false, wroteErr = false;
+        for (;;) {
+            Slot& slot = slots[dequeuePos & (ringCapacity - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != dequeuePos + 1) {
+                break;
+            }
+
+            const auto &record = slot.record;
+            bool isError = record.level >= LogLevel::Warning;
+            fprintf(isError ? stderr : stdout, "[%10.3f] %s: %s\n", record.timestamp, levelName(record.level), record.message);
+            (isError ? wroteErr : wroteOut) = true;
+
+            slot.sequence.store(dequeuePos + ringCapacity, std::memory_order_release);
+            dequeuePos++;
+            flushedPos.store(dequeuePos, std::memory_order_release);
+        }
+
+        if (uint64_t droppedCount = dropped.exchange(0, std::memory_order_relaxed)) {
+            fprintf(stderr, "[logger] %llu messages dropped, log queue was full\n", static_cast<unsigned long long>(droppedCount));
+            wroteErr = true;
+        }
+        if (wroteOut) {
+            fflush(stdout);
+        }
+        if (wroteErr) {
+            fflush(stderr);
+        }
+    }
+
+    std::chrono::steady_clock::time_point startTime;
+
+    std::array<Slot, ringCapacity> slots;
+    alignas(64) std::atomic<size_t> enqueuePos{0};
+    alignas(64) size_t dequeuePos = 0;
+    std::atomic<size_t> flushedPos{0};
+    std::atomic<uint64_t> dropped{0};
+
+    std::mutex wakeMutex;
+    std::condition_variable wakeFlusher;
+    // Written under wakeMutex, read without it by flush()
+    std::atomic<bool> stopping{false};
+    std::thread flushThread;
+};
+
+Logger& getLogger()
+{
+    static LoggerImpl logger;
+    return logger;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Asynchronous logging: callers format into a lock-free ring buffer and a background thread does the I/O,
+// so logging from the render thread never blocks. When the ring is full messages are dropped and counted.
+
+enum class LogLevel : uint8_t
+{
+    Debug = 0,
+    Info = 1,
+    Warning = 2,
+    Error = 3
+};
+
+// Messages below this level compile away entirely
+#ifndef LUMON_LOG_MIN_LEVEL
+#define LUMON_LOG_MIN_LEVEL 0
+#endif
+
+class Logger {
+public:
+    virtual void write(LogLevel level, const char* format, ...) __attribute__((format(printf, 3, 4))) = 0;
+
+    // Blocks until everything queued so far has been written, for use at shutdown
+    virtual void flush() = 0;
+
+    virtual ~Logger() = default;
+};
+
+Logger& getLogger();
+
+// Allows up to 'maxPerSecond' messages from one call site per second, counting the rest
+class LogRateLimiter
+{
+public:
+    explicit LogRateLimiter(uint32_t maxPerSecond) : maxPerSecond(maxPerSecond) {}
+
+    // Returns true if the message should be logged, with the number suppressed since the last one
+    bool allow(uint32_t& suppressedOut)
+    {
+        int64_t second = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        if (windowSecond.exchange(second, std::memory_order_relaxed) != second) {
+            windowCount.store(0, std::memory_order_relaxed);
+        }
+        if (windowCount.fetch_add(1, std::memory_order_relaxed) < maxPerSecond) {
+            suppressedOut = suppressed.exchange(0, std::memory_order_relaxed);
+            return true;
+        }
+        suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+private:
+    uint32_t maxPerSecond;
+    std::atomic<int64_t> windowSecond{0};
+    std::atomic<uint32_t> windowCount{0};
+    std::atomic<uint32_t> suppressed{0};
+};
+
+#define LOG_AT(level, ...) \
+    do { \
+        if constexpr (static_cast<int>(level) >= LUMON_LOG_MIN_LEVEL) { \
+            getLogger().write(level, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_DEBUG(...) LOG_AT(LogLevel::Debug, __VA_ARGS__)
+#define LOG_INFO(...) LOG_AT(LogLevel::Info, __VA_ARGS__)
+#define LOG_WARNING(...) LOG_AT(LogLevel::Warning, __VA_ARGS__)
+#define LOG_ERROR(...) LOG_AT(LogLevel::Error, __VA_ARGS__)
+
+// For call sites that can fire every frame
+#define LOG_RATE_LIMITED(level, maxPerSecond, ...) \
+    do { \
+        if constexpr (static_cast<int>(level) >= LUMON_LOG_MIN_LEVEL) { \
+            static LogRateLimiter logRateLimiter_(maxPerSecond); \
+            uint32_t logSuppressed_ = 0; \
+            if (logRateLimiter_.allow(logSuppressed_)) { \
+                if (logSuppressed_ > 0) { \
+                    getLogger().write(level, "(%u similar messages suppressed)", logSuppressed_); \
+                } \
+                getLogger().write(level, __VA_ARGS__); \
+            } \
+        } \
+    } while (0)
@@ -0,0 +1,309 @@
+#include "GridDataset.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+    constexpr size_t groupsPerRead = 4096;
+
+    // Cells are used in place, so a Number has to lay out exactly like a cell record
+    bool numberMatchesCellRecord()
+    {
+        alignas(Number) uint8_t bytes[sizeof(Number)] = {};
+        auto number = new (bytes) Number(7, true);
+        number->badGroupId = 0x01020304;
+        number->regenerateTicks = 0x0506;
+
+        uint8_t expected[gridDataset::cellSize];
+        gridDataset::encodeCell(0x01020304, 0x0506, 7, true, expected);
+        return sizeof(Number) == gridDataset::cellSize && memcmp(bytes, expected, sizeof(expected)) == 0;
+    }
+
+    bool readAt(int fd, uint8_t* out, size_t size, uint64_t offset)
+    {
+        while (size > 0) {
+            ssize_t result = pread(fd, out, size, static_cast<off_t>(offset));
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                return false;
+            }
+            out += result;
+            size -= static_cast<size_t>(result);
+            offset += static_cast<uint64_t>(result);
+        }
+        return true;
+    }
+}
+
+GridDataset::~GridDataset()
+{
+    if (cells) {
+        munmap(cells, mappedBytes);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+bool GridDataset::readGroups(std::vector<BadGroup>& groups)
+{
+    groups.clear();
+    groups.reserve(header.groupCount);
+    std::vector<uint8_t> buffer(groupsPerRead * gridDataset::groupSize);
+    int gridSize = getGridSize();
+    for (uint32_t first = 0; first < header.groupCount; first += groupsPerRead) {
+        uint32_t count = std::min<uint32_t>(groupsPerRead, header.groupCount - first);
+        if (!readAt(fd, buffer.data(), count * gridDataset::groupSize, header.groupsOffset + static_cast<uint64_t>(first) * gridDataset::groupSize)) {
+            LOG_ERROR("Failed to read the group table of dataset %s: %s", path.c_str(), strerror(errno));
+            return false;
+        }
+        fingerprint = gridDataset::fnv1a(buffer.data(), count * gridDataset::groupSize, fingerprint);
+        for (uint32_t i = 0; i < count; i++) {
+            gridDataset::Group record;
+            gridDataset::decodeGroup(&buffer[i * gridDataset::groupSize], record);
+            GridRect bounds{record.minX, record.minY, record.maxX, record.maxY};
+            if (record.bin >= binCount || bounds.minX < 0 || bounds.minY < 0 || bounds.maxX > gridSize || bounds.maxY > gridSize) {
+                LOG_ERROR("Dataset %s has a malformed group %u", path.c_str(), first + i);
+                return false;
+            }
+            auto &group = groups.emplace_back(first + i, record.bin);
+            group.bounds = bounds;
+            group.numberCount = static_cast<int>(record.numberCount);
+        }
+    }
+    return true;
+}
+
+bool GridDataset::countBadCells(int blockSize, std::vector<int>& counts) const
+{
+    int countBlock = getCountBlock();
+    if (blockSize <= 0 || blockSize % countBlock != 0) {
+        return false;
+    }
+    std::vector<uint8_t> table(header.countsBytes());
+    if (!readAt(fd, table.data(), table.size(), header.countsOffset)) {
+        LOG_ERROR("Failed to read the count table of dataset %s: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    int blocksPerSide = static_cast<int>(header.blocksPerSide());
+    int outPerSide = (getGridSize() + blockSize - 1) / blockSize;
+    int blocksPerOut = blockSize / countBlock;
+    counts.assign(static_cast<size_t>(outPerSide) * outPerSide, 0);
+    for (int bx = 0; bx < blocksPerSide; bx++) {
+        for (int by = 0; by < blocksPerSide; by++) {
+            auto count = gridDataset::get(&table[(static_cast<size_t>(bx) * blocksPerSide + by) * 4], 4);
+            counts[static_cast<size_t>(bx / blocksPerOut) * outPerSide + by / blocksPerOut] += static_cast<int>(count);
+        }
+    }
+    return true;
+}
+
+void GridDataset::setVisibleRanges(const std::vector<GridRect>& ranges)
+{
+    int lastChunk = static_cast<int>(chunksPerSide);
+    nextCover.clear();
+    for (const auto &range : ranges) {
+        if (range.empty()) {
+            continue;
+        }
+        validate(range);
+        nextCover.push_back(GridRect{std::max(0, (range.minX >> chunkShift) - 1), std::max(0, (range.minY >> chunkShift) - 1),
+                                     std::min(lastChunk, ((range.maxX - 1) >> chunkShift) + 2), std::min(lastChunk, ((range.maxY - 1) >> chunkShift) + 2)});
+    }
+
+    auto sameRect = [](const GridRect& a, const GridRect& b) {
+        return a.minX == b.minX && a.minY == b.minY && a.maxX == b.maxX && a.maxY == b.maxY;
+    };
+    if (std::equal(nextCover.begin(), nextCover.end(), cover.begin(), cover.end(), sameRect)) {
+        return;
+    }
+
+    for (const auto &rect : cover) {
+        for (int cx = rect.minX; cx < rect.maxX; cx++) {
+            for (int cy = rect.minY; cy < rect.maxY; cy++) {
+                chunkFlags[chunkIndex(cx, cy)] &= ~Covered;
+            }
+        }
+    }
+    for (const auto &rect : nextCover) {
+        for (int cx = rect.minX; cx < rect.maxX; cx++) {
+            for (int cy = rect.minY; cy < rect.maxY; cy++) {
+                chunkFlags[chunkIndex(cx, cy)] |= Covered;
+            }
+            // A column of chunks is contiguous in the file, so it's read ahead in one go
+            advise(chunkIndex(cx, rect.minY), chunkIndex(cx, rect.maxY), MADV_WILLNEED, true);
+        }
+    }
+    std::swap(cover, nextCover);
+    dropUncoveredChunks();
+}
+
+void GridDataset::validate(const GridRect& range)
+{
+    GridRect cellRange = range.intersection(GridRect{0, 0, getGridSize(), getGridSize()});
+    if (cellRange.empty()) {
+        return;
+    }
+    for (int cx = cellRange.minX >> chunkShift; cx <= (cellRange.maxX - 1) >> chunkShift; cx++) {
+        for (int cy = cellRange.minY >> chunkShift; cy <= (cellRange.maxY - 1) >> chunkShift; cy++) {
+            if ((chunkFlags[chunkIndex(cx, cy)] & Validated) == 0) {
+                validateChunk(cx, cy);
+            }
+        }
+    }
+}
+
+void GridDataset::validateChunk(int cx, int cy)
+{
+    auto &flags = chunkFlags[chunkIndex(cx, cy)];
+    flags |= Validated;
+
+    size_t chunkCells = static_cast<size_t>(1) << (2 * chunkShift);
+    Number* chunk = cells + chunkIndex(cx, cy) * chunkCells;
+    size_t corrected = 0;
+    for (size_t i = 0; i < chunkCells; i++) {
+        auto &number = chunk[i];
+        // Only written when wrong, so a valid chunk stays shared with the page cache
+        if (number.num > 9) {
+            number.num = number.num % 10;
+            corrected++;
+        }
+        if (number.hasBadGroup() && number.badGroupId >= header.groupCount) {
+            number.badGroupId = NoBadGroup;
+            corrected++;
+        }
+    }
+    if (corrected > 0) {
+        // Dropping it would bring the bad cells back from the file
+        flags |= Changed;
+        LOG_RATE_LIMITED(LogLevel::Warning, 1, "Dataset %s has %zu invalid cell field(s) in chunk (%d, %d), corrected in memory", path.c_str(),
+                         corrected, cx, cy);
+    }
+}
+
+void GridDataset::markChanged(int x, int y)
+{
+    chunkFlags[chunkIndex(x >> chunkShift, y >> chunkShift)] |= Changed;
+}
+
+void GridDataset::resetRegenerateScales()
+{
+    size_t chunkCells = static_cast<size_t>(1) << (2 * chunkShift);
+    for (const auto &rect : cover) {
+        for (int cx = rect.minX; cx < rect.maxX; cx++) {
+            for (int cy = rect.minY; cy < rect.maxY; cy++) {
+                Number* chunk = cells + chunkIndex(cx, cy) * chunkCells;
+                for (size_t i = 0; i < chunkCells; i++) {
+                    chunk[i].regenerateTicks = 0;
+                }
+            }
+        }
+    }
+}
+
+void GridDataset::advise(size_t firstChunk, size_t lastChunk, int advice, bool roundOutwards)
+{
+    size_t chunkBytes = header.chunkBytes();
+    size_t begin = firstChunk * chunkBytes;
+    size_t end = lastChunk * chunkBytes;
+    // Dropping has to stay inside the run, a page shared with a kept chunk would lose its changes
+    if (roundOutwards) {
+        begin = begin / pageSize * pageSize;
+        end = std::min(mappedBytes, (end + pageSize - 1) / pageSize * pageSize);
+    } else {
+        begin = (begin + pageSize - 1) / pageSize * pageSize;
+        end = end / pageSize * pageSize;
+    }
+    if (begin < end) {
+        madvise(reinterpret_cast<uint8_t*>(cells) + begin, end - begin, advice);
+    }
+}
+
+// Everything outside the cover that was never changed goes back to the file, including chunks only
+// touched on the way, such as the far ends of a large group being refined
+void GridDataset::dropUncoveredChunks()
+{
+    size_t chunkCount = chunkFlags.size();
+    size_t runStart = 0;
+    for (size_t i = 0; i <= chunkCount; i++) {
+        if (i < chunkCount && (chunkFlags[i] & (Covered | Changed)) == 0) {
+            continue;
+        }
+        if (runStart < i) {
+            advise(runStart, i, MADV_DONTNEED, false);
+        }
+        runStart = i + 1;
+    }
+}
+
+std::unique_ptr<GridDataset> openGridDataset(const std::string& path)
+{
+    if (!numberMatchesCellRecord()) {
+        LOG_ERROR("Datasets can't be mapped on this platform, cells don't match the dataset's cell records");
+        return nullptr;
+    }
+
+    std::unique_ptr<GridDataset> dataset(new GridDataset());
+    dataset->path = path;
+    dataset->fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (dataset->fd < 0) {
+        LOG_ERROR("Failed to open dataset %s: %s", path.c_str(), strerror(errno));
+        return nullptr;
+    }
+
+    struct stat fileStat{};
+    uint8_t headerBytes[gridDataset::headerSize];
+    if (fstat(dataset->fd, &fileStat) != 0 || !readAt(dataset->fd, headerBytes, sizeof(headerBytes), 0) ||
+        !gridDataset::decodeHeader(headerBytes, dataset->header)) {
+        LOG_ERROR("%s is not a grid dataset (or was written by a newer version)", path.c_str());
+        return nullptr;
+    }
+    const auto &header = dataset->header;
+    dataset->fingerprint = gridDataset::fnv1a(headerBytes, sizeof(headerBytes));
+    auto fileSize = static_cast<uint64_t>(fileStat.st_size);
+    if (header.cellsOffset + header.cellsBytes() > fileSize ||
+        header.groupsOffset + static_cast<uint64_t>(header.groupCount) * gridDataset::groupSize > fileSize ||
+        header.countsOffset + header.countsBytes() > fileSize) {
+        LOG_ERROR("Dataset %s is truncated", path.c_str());
+        return nullptr;
+    }
+
+    // Private so changes stay in memory, and no swap is reserved for a mapping that can be far larger
+    // than memory when only the changed chunks ever need it
+    dataset->mappedBytes = header.cellsBytes();
+    void* mapping = mmap(nullptr, dataset->mappedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_NORESERVE, dataset->fd,
+                         static_cast<off_t>(header.cellsOffset));
+    if (mapping == MAP_FAILED) {
+        LOG_ERROR("Failed to map dataset %s: %s", path.c_str(), strerror(errno));
+        return nullptr;
+    }
+    dataset->cells = static_cast<Number*>(mapping);
+    // Reads come from wherever the views are, prefetching is left to setVisibleRanges
+    madvise(mapping, dataset->mappedBytes, MADV_RANDOM);
+
+    dataset->pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    while ((1u << dataset->chunkShift) < header.chunkSize) {
+        dataset->chunkShift++;
+    }
+    dataset->chunkMask = static_cast<int>(header.chunkSize) - 1;
+    dataset->chunksPerSide = header.chunksPerSide();
+    dataset->chunkFlags.resize(dataset->chunksPerSide * dataset->chunksPerSide, 0);
+    dataset->cover.reserve(8);
+    dataset->nextCover.reserve(8);
+
+    LOG_INFO("Mapped dataset %s: %ux%u cells in %zu chunk(s) of %u, %u bad group(s)", path.c_str(), header.gridSize, header.gridSize,
+             dataset->chunkFlags.size(), header.chunkSize, header.groupCount);
+    return dataset;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "GridDatasetFormat.h"
+#include "Number.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A dataset file (GridDatasetFormat.h) with its cells mapped copy-on-write and used in place, so
+// opening one costs the same whatever its size and cells are only read in once a view reaches them.
+// The chunks around the visible ranges are prefetched; chunks that leave them are handed back to
+// the page cache unless one of their numbers was regenerated, so resident memory stays at roughly
+// what is on screen plus what has been refined.
+class GridDataset
+{
+public:
+    ~GridDataset();
+
+    int getGridSize() const { return static_cast<int>(header.gridSize); }
+
+    Number& cell(int x, int y)
+    {
+        size_t chunk = static_cast<size_t>(x >> chunkShift) * chunksPerSide + static_cast<size_t>(y >> chunkShift);
+        return cells[(chunk << (2 * chunkShift)) + static_cast<size_t>(((x & chunkMask) << chunkShift) + (y & chunkMask))];
+    }
+
+    // The whole group table, which is read once rather than mapped since the grid keeps its groups in
+    // memory. Also completes the fingerprint.
+    bool readGroups(std::vector<BadGroup>& groups);
+
+    // FNV-1a of the header and group table, the same for every copy of a dataset
+    uint64_t getFingerprint() const { return fingerprint; }
+
+    int getCountBlock() const { return static_cast<int>(header.countBlock); }
+    // Bad cells in every blockSize x blockSize block, x-major, from the count table. blockSize has to
+    // be a multiple of the count block.
+    bool countBadCells(int blockSize, std::vector<int>& counts) const;
+
+    // Checks the chunks in the ranges (see validate()), and otherwise only does any work when a range
+    // moves into another chunk
+    void setVisibleRanges(const std::vector<GridRect>& ranges);
+
+    // The file is trusted no further than its group table, so every chunk is checked once before its
+    // cells are used: digits past 9 and group ids past the table would index past the digit images and
+    // the groups. Bad cells are corrected in memory, becoming plain numbers, and their chunk is kept.
+    void validate(const GridRect& range);
+
+    // The cell's chunk keeps its changes from now on rather than being dropped when it leaves the view
+    void markChanged(int x, int y);
+
+    // Restarts the fade-in of the cells around the visible ranges. Cells elsewhere don't need it, they
+    // are read back from the file settled.
+    void resetRegenerateScales();
+
+private:
+    friend std::unique_ptr<GridDataset> openGridDataset(const std::string& path);
+
+    GridDataset() = default;
+
+    enum ChunkFlags : uint8_t { Covered = 1, Changed = 2, Validated = 4 };
+
+    size_t chunkIndex(int cx, int cy) const { return static_cast<size_t>(cx) * chunksPerSide + static_cast<size_t>(cy); }
+    void advise(size_t firstChunk, size_t lastChunk, int advice, bool roundOutwards);
+    void dropUncoveredChunks();
+    void validateChunk(int cx, int cy);
+
+    std::string path;
+    int fd = -1;
+    gridDataset::Header header;
+    uint64_t fingerprint = 0;
+
+    Number* cells = nullptr;
+    size_t mappedBytes = 0;
+    size_t pageSize = 4096;
+    int chunkShift = 0;
+    int chunkMask = 0;
+    size_t chunksPerSide = 0;
+
+    std::vector<uint8_t> chunkFlags;
+    // Visible ranges in chunks, grown by a chunk on every side so panning reaches prefetched cells
+    std::vector<GridRect> cover;
+    std::vector<GridRect> nextCover;
+};
+
+// Logs why and returns nullptr if the file can't be mapped as a dataset
+std::unique_ptr<GridDataset> openGridDataset(const std::string& path);
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// On-disk layout of grid datasets (.lmd), written by tools/DatasetConvert.cpp and mapped by
+// GridDataset. Everything is little-endian:
+//
+//   header   64 bytes at offset 0:
+//            u32 magic "LMD1", u16 version, u16 cell record size, u32 grid size (cells per side),
+//            u32 chunk size (cells per chunk side, a power of two), u32 count block (cells per
+//            count block side, a power of two no larger than the chunk size), u32 group count,
+//            u64 cells offset, u64 groups offset, u64 counts offset, 16 bytes reserved
+//
+//   cells    at the cells offset, a multiple of 64 KiB so the region can be mapped on its own.
+//            The grid is cut into chunk size x chunk size chunks, chunk (cx, cy) stored at index
+//            cx * chunksPerSide + cy, each chunk holding its cells at (x % chunk size) * chunk size
+//            + (y % chunk size). Chunks past the grid edge are padded out with empty cells, so
+//            every chunk has the same size and a viewport only ever touches the chunks it shows.
+//            Cell record, 8 bytes:
+//              u32 bad group id (0xffffffff for none), u16 fade-in in thousandths (1000 is fully
+//              shown), u8 digit in the low 4 bits with the horizontal offset flag in bit 4, u8 zero
+//
+//   groups   at the groups offset, group count records of 24 bytes, the group id being the index:
+//              u8 bin (0-based), 3 bytes zero, u32 number count, i32 min x, i32 min y,
+//              i32 max x, i32 max y (the half-open bounds of the group's cells)
+//
+//   counts   at the counts offset, a u32 per count block in x-major order: how many of the block's
+//            cells belong to a bad group, so overviews never have to read the cells
+namespace gridDataset
+{
+    constexpr uint32_t magic = 0x31444d4c;  // "LMD1"
+    constexpr uint16_t version = 1;
+    constexpr size_t headerSize = 64;
+    constexpr size_t cellSize = 8;
+    constexpr size_t groupSize = 24;
+    constexpr size_t cellsAlignment = 64 * 1024;
+
+    constexpr uint32_t noGroup = 0xffffffff;
+    constexpr uint16_t settledFade = 1000;
+    constexpr uint8_t horizontalOffsetBit = 0x10;
+
+    // Largest grid whose cell ids still fit an int
+    constexpr uint32_t maxGridSize = 46340;
+
+    struct Header
+    {
+        uint32_t gridSize = 0;
+        uint32_t chunkSize = 0;
+        uint32_t countBlock = 0;
+        uint32_t groupCount = 0;
+        uint64_t cellsOffset = 0;
+        uint64_t groupsOffset = 0;
+        uint64_t countsOffset = 0;
+
+        uint32_t chunksPerSide() const { return (gridSize + chunkSize - 1) / chunkSize; }
+        uint32_t blocksPerSide() const { return (gridSize + countBlock - 1) / countBlock; }
+        uint64_t chunkBytes() const { return static_cast<uint64_t>(chunkSize) * chunkSize * cellSize; }
+        uint64_t cellsBytes() const { return static_cast<uint64_t>(chunksPerSide()) * chunksPerSide() * chunkBytes(); }
+        uint64_t countsBytes() const { return static_cast<uint64_t>(blocksPerSide()) * blocksPerSide() * 4; }
+
+        // Byte offset of a cell's record within the cells region
+        uint64_t cellOffset(uint32_t x, uint32_t y) const
+        {
+            uint64_t chunk = static_cast<uint64_t>(x / chunkSize) * chunksPerSide() + y / chunkSize;
+            return chunk * chunkBytes() + (static_cast<uint64_t>(x % chunkSize) * chunkSize + y % chunkSize) * cellSize;
+        }
+    };
+
+    struct Group
+    {
+        uint8_t bin = 0;
+        uint32_t numberCount = 0;
+        int32_t minX = 0, minY = 0;
+        int32_t maxX = 0, maxY = 0;
+    };
+
+    inline void put(uint8_t* out, uint64_t value, size_t bytes)
+    {
+        for (size_t i = 0; i < bytes; i++) {
+            out[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    inline uint64_t get(const uint8_t* in, size_t bytes)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; i++) {
+            value |= static_cast<uint64_t>(in[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    constexpr uint64_t fnvOffset = 0xcbf29ce484222325ull;
+
+    // 64-bit FNV-1a, continuing from hash
+    inline uint64_t fnv1a(const uint8_t* data, size_t size, uint64_t hash = fnvOffset)
+    {
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ data[i]) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    inline bool isPowerOfTwo(uint32_t value)
+    {
+        return value != 0 && (value & (value - 1)) == 0;
+    }
+
+    inline void encodeHeader(const Header& header, uint8_t* out)
+    {
+        put(out, magic, 4);
+        put(out + 4, version, 2);
+        put(out + 6, cellSize, 2);
+        put(out + 8, header.gridSize, 4);
+        put(out + 12, header.chunkSize, 4);
+        put(out + 16, header.countBlock, 4);
+        put(out + 20, header.groupCount, 4);
+        put(out + 24, header.cellsOffset, 8);
+        put(out + 32, header.groupsOffset, 8);
+        put(out + 40, header.countsOffset, 8);
+        put(out + 48, 0, 8);
+        put(out + 56, 0, 8);
+    }
+
+    // False if the header isn't a dataset this version can read, or describes an impossible layout
+    inline bool decodeHeader(const uint8_t* in, Header& header)
+    {
+        if (get(in, 4) != magic || get(in + 4, 2) != version || get(in + 6, 2) != cellSize) {
+            return false;
+        }
+        header.gridSize = static_cast<uint32_t>(get(in + 8, 4));
+        header.chunkSize = static_cast<uint32_t>(get(in + 12, 4));
+        header.countBlock = static_cast<uint32_t>(get(in + 16, 4));
+        header.groupCount = static_cast<uint32_t>(get(in + 20, 4));
+        header.cellsOffset = get(in + 24, 8);
+        header.groupsOffset = get(in + 32, 8);
+        header.countsOffset = get(in + 40, 8);
+        return header.gridSize > 0 && header.gridSize <= maxGridSize && isPowerOfTwo(header.chunkSize) &&
+               isPowerOfTwo(header.countBlock) && header.countBlock <= header.chunkSize && header.cellsOffset % cellsAlignment == 0;
+    }
+
+    inline void encodeCell(uint32_t groupId, uint16_t fade, uint8_t digit, bool horizontalOffset, uint8_t* out)
+    {
+        put(out, groupId, 4);
+        put(out + 4, fade, 2);
+        out[6] = static_cast<uint8_t>((digit & 0xf) | (horizontalOffset ? horizontalOffsetBit : 0));
+        out[7] = 0;
+    }
+
+    inline void encodeGroup(const Group& group, uint8_t* out)
+    {
+        out[0] = group.bin;
+        out[1] = out[2] = out[3] = 0;
+        put(out + 4, group.numberCount, 4);
+        put(out + 8, static_cast<uint32_t>(group.minX), 4);
+        put(out + 12, static_cast<uint32_t>(group.minY), 4);
+        put(out + 16, static_cast<uint32_t>(group.maxX), 4);
+        put(out + 20, static_cast<uint32_t>(group.maxY), 4);
+    }
+
+    inline void decodeGroup(const uint8_t* in, Group& group)
+    {
+        group.bin = in[0];
+        group.numberCount = static_cast<uint32_t>(get(in + 4, 4));
+        group.minX = static_cast<int32_t>(get(in + 8, 4));
+        group.minY = static_cast<int32_t>(get(in + 12, 4));
+        group.maxX = static_cast<int32_t>(get(in + 16, 4));
+        group.maxY = static_cast<int32_t>(get(in + 20, 4));
+    }
+}
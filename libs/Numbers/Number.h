@@ -1,14 +1,52 @@
 #pragma once
 
-#include <memory>
-#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+// Half-open range of grid cells [minX, maxX) x [minY, maxY)
+struct GridRect
+{
+    int minX = 0, minY = 0;
+    int maxX = 0, maxY = 0;
+
+    bool empty() const { return minX >= maxX || minY >= maxY; }
+    bool contains(int x, int y) const { return x >= minX && x < maxX && y >= minY && y < maxY; }
+    bool intersects(const GridRect& other) const
+    {
+        return minX < other.maxX && other.minX < maxX && minY < other.maxY && other.minY < maxY;
+    }
+    GridRect intersection(const GridRect& other) const
+    {
+        return GridRect{std::max(minX, other.minX), std::max(minY, other.minY), std::min(maxX, other.maxX), std::min(maxY, other.maxY)};
+    }
+    void include(int x, int y)
+    {
+        if (empty()) {
+            *this = GridRect{x, y, x + 1, y + 1};
+            return;
+        }
+        minX = std::min(minX, x);
+        minY = std::min(minY, y);
+        maxX = std::max(maxX, x + 1);
+        maxY = std::max(maxY, y + 1);
+    }
+};
+
+constexpr uint32_t NoBadGroup = std::numeric_limits<uint32_t>::max();
+
+// Bad groups are sorted into this many bins, numbered from 0
+constexpr int binCount = 5;
 
 struct BadGroup
 {
-    BadGroup(int id, std::vector<int> numberIds, int binIdx) : id(id), numberIds(std::move(numberIds)), binIdx(binIdx) {}
+    BadGroup(uint32_t id, int binIdx) : id(id), binIdx(binIdx) {}
+
+    uint32_t id;
 
-    int id;
-    std::vector<int> numberIds;
+    // Members are found by scanning the bounds for cells carrying this group's id
+    GridRect bounds;
+    int numberCount = 0;
 
     bool isActive = false;
     bool superActive = false;
@@ -19,30 +57,26 @@ struct BadGroup
     bool refined = false;
 };
 
-using BadGroupPtr = std::shared_ptr<BadGroup>;
-
-struct NumberDisplayInfos
+// Packed grid cell. Display positions are derived from the grid coordinates and viewport, not stored.
+struct Number
 {
-    explicit NumberDisplayInfos(bool horizontalOffset) : horizontalOffset(horizontalOffset) {}
+    Number() : num(0), horizontalOffset(0) {}
+    Number(int num, bool horizontalOffset) : num(static_cast<uint8_t>(num)), horizontalOffset(horizontalOffset ? 1 : 0) {}
 
-    bool horizontalOffset;
-    float centerX = -1.f, centerY = -1.f;
-    float refinedX = -1.f, refinedY = -1.f;
-    bool isVisible = false;
-};
+    uint32_t badGroupId = NoBadGroup;
 
-struct Number
-{
-    Number(int id, int gridX, int gridY, int num, bool horizontalOffset) : id(id), gridX(gridX), gridY(gridY), num(num), displayInfos(NumberDisplayInfos(horizontalOffset)) {}
+    // Regenerate scale quantised to thousandths (the fade-in advances in whole thousandths)
+    uint16_t regenerateTicks = 0;
+
+    uint8_t num : 4;
+    uint8_t horizontalOffset : 1;
 
-    int id;
-    int gridX, gridY;
-    int num;
-    NumberDisplayInfos displayInfos;
+    bool hasBadGroup() const { return badGroupId != NoBadGroup; }
 
-    BadGroupPtr badGroup = nullptr;
+    float getRegenerateScale() const { return static_cast<float>(regenerateTicks) * regenerateScaleStep; }
+    void setRegenerateScale(float scale) { regenerateTicks = static_cast<uint16_t>(scale / regenerateScaleStep + 0.5f); }
 
-    float regenerateScale = 0.f;
+    static constexpr float regenerateScaleStep = 0.001f;
 };
 
-using NumberPtr = std::shared_ptr<Number>;
\ No newline at end of file
+static_assert(sizeof(Number) == 8, "Number should stay packed into 8 bytes");
@@ -1,214 +1,439 @@
 #include "NumberGrid.h"
 
+#include "GridDataset.h"
 #include "PerlinNoise.hpp"
+#include "TimerWheel.h"
 
-#include <cstdlib>
-#include <map>
+#include <algorithm>
 #include <random>
-#include <set>
-#include <optional>
 
 class NumberGridImpl : public NumberGrid {
 public:
-    explicit NumberGridImpl(int gridSize)
+    NumberGridImpl(int gridSize, unsigned int seed, float badThreshold) : gridSize(gridSize), generator(seed), badThresh(badThreshold)
     {
         generateGrid(gridSize);
+        scheduleSpawns(initialSpawnDelay);
     }
 
-    std::map<int, std::map<int, NumberPtr>> getGrid() final
+    NumberGridImpl(std::unique_ptr<GridDataset> gridDataset, std::vector<BadGroup> groups, unsigned int seed)
+        : gridSize(gridDataset->getGridSize()), dataset(std::move(gridDataset)), badGroups(std::move(groups)), generator(seed), badThresh(0.f)
     {
-        return grid;
+        scheduleSpawns(initialSpawnDelay);
     }
 
     void update() final
     {
-        visibleBadGroups.clear();
-        bool activeGroupStillVisible = false;
-        bool newActiveBadGroup = false;
+        firedTimers.clear();
+        timerWheel.advance(firedTimers);
 
-        for (auto it = badGroups.begin(); it != badGroups.end(); ) {
-            if (it->second->numberIds.empty()) {
-                it = badGroups.erase(it);
-            } else {
-                ++it;
+        // Only groups with a timer due this tick are touched
+        for (const auto &timer : firedTimers) {
+            if (timer.kind == SpawnTimer) {
+                spawnActiveGroup();
+            } else if (auto badGroup = getBadGroup(timer.id)) {
+                pulseGroup(*badGroup);
             }
         }
+    }
 
-        // Update visible groups and check if active group is still visible
-        for (const auto &[groupId, badGroup] : badGroups) {
-            for (const auto &numId : badGroup->numberIds) {
-                auto num = numberIdMap.at(numId);
-                if (num->displayInfos.isVisible) {
-                    visibleBadGroups.emplace(groupId);
+    void setMaxActiveGroups(int maxGroups) final
+    {
+        maxActiveGroups = std::max(maxGroups, 0);
+        scheduleSpawns(initialSpawnDelay);
+    }
 
-                    if (badGroup->isActive && groupId == *activeBadGroup && !badGroup->refined) {
-                        activeGroupStillVisible = true;
-                    }
-                }
-            }
+    int getMaxActiveGroups() const final
+    {
+        return maxActiveGroups;
+    }
+
+    int getActiveGroupCount() const final
+    {
+        return activeGroupCount;
+    }
+
+    bool activateGroup(uint32_t id) final
+    {
+        auto group = getBadGroup(id);
+        if (!group || group->isActive || group->refined || !isGroupVisible(*group)) {
+            return false;
         }
+        group->isActive = true;
+        group->scale = 0;
+        activeGroupCount++;
+        pushEvent(GridEventType::GroupActivated, group->id);
+        pulseGroup(*group);
+        return true;
+    }
 
-        if (activeBadGroup && !activeGroupStillVisible) {
-            activeBadGroup.reset();
-            newActiveBadGroup = true;
-            newBadGroupCountdown = randomNumber(1, 3) * 25;
+    bool refineGroup(uint32_t id) final
+    {
+        auto group = getBadGroup(id);
+        if (!group || group->refined) {
+            return false;
         }
+        group->refined = true;
+        // Its numbers are about to be read wherever they are, not just on screen
+        if (dataset) {
+            dataset->validate(group->bounds);
+        }
+        pushEvent(GridEventType::GroupRefined, id);
+        return true;
+    }
 
-        // Select a new active group if necessary
-        if (!activeBadGroup && !visibleBadGroups.empty() && newBadGroupCountdown == 0) {
-            auto randomIndex = randomNumber(0, static_cast<int>(visibleBadGroups.size()) - 1);
-            auto it = visibleBadGroups.begin();
-            std::advance(it, randomIndex);
-            activeBadGroup = *it;
+    int getGridSize() const final
+    {
+        return gridSize;
+    }
+
+    uint64_t getContentId() const final
+    {
+        return dataset ? dataset->getFingerprint() : 0;
+    }
+
+    void setVisibleRange(const GridRect& range) final
+    {
+        visibleRanges.assign(1, range);
+        if (dataset) {
+            dataset->setVisibleRanges(visibleRanges);
         }
+    }
 
-        // Update active groups / their scale
-        for (const auto &[groupId, badGroup] : badGroups) {
-            badGroup->isActive = activeBadGroup && groupId == *activeBadGroup;
-            if (badGroup->isActive) {
-                if (newActiveBadGroup) {
-                    badGroup->scale = 0;
-                } else {
-                    if (!badGroup->reachedMax) {
-                        if (badGroup->scale < 0.23) {
-                            badGroup->scale += (0.0005 * randomNumber(1, 10));
-                        }
-                    } else {
-                        badGroup->scale -= (0.0001 * randomNumber(1, 10));
-                    }
+    void setVisibleRanges(const std::vector<GridRect>& ranges) final
+    {
+        visibleRanges.assign(ranges.begin(), ranges.end());
+        if (dataset) {
+            dataset->setVisibleRanges(visibleRanges);
+        }
+    }
 
-                    if (badGroup->scale >= 0.23) {
-                        if (!badGroup->superActive || badGroup->scale >= 0.24) {
-                            badGroup->reachedMax = true;
-                        } else {
-                            badGroup->scale += 0.00001;
-                        }
-                    } else if (badGroup->scale <= 0.0) {
-                        badGroup->isActive = false;
-                        badGroup->superActive = false;
-                        badGroup->reachedMax = false;
-                        activeBadGroup.reset();
-                        newBadGroupCountdown = randomNumber(1, 3) * 25;
-                    }
-                }
-            } else {
-                badGroup->scale = 0;
-            }
+    Number* getGridNumber(int x, int y) final
+    {
+        if (x < 0 || y < 0 || x >= gridSize || y >= gridSize) {
+            return nullptr;
+        }
+        return &cell(x, y);
+    }
+
+    Number* getGridNumber(int id) final
+    {
+        if (id < 0 || id / gridSize >= gridSize) {
+            return nullptr;
+        }
+        return &cell(id / gridSize, id % gridSize);
+    }
+
+    std::vector<BadGroup>& getBadGroups() final
+    {
+        return badGroups;
+    }
+
+    BadGroup* getBadGroup(uint32_t id) final
+    {
+        return id < badGroups.size() ? &badGroups[id] : nullptr;
+    }
+
+    void regenerateNumber(int x, int y) final
+    {
+        setNumber(x, y, randomNumber(0, 9));
+    }
+
+    void setNumber(int x, int y, int digit) final
+    {
+        auto &number = cell(x, y);
+        if (dataset) {
+            dataset->markChanged(x, y);
         }
+        if (auto group = getBadGroup(number.badGroupId)) {
+            group->numberCount--;
+        }
+        pushEvent(GridEventType::NumberRegenerated, number.badGroupId, x, y);
+        number.badGroupId = NoBadGroup;
+        number.num = static_cast<uint8_t>(digit);
+        number.regenerateTicks = 0;
+    }
 
-        if (newBadGroupCountdown > 0) {
-            newBadGroupCountdown -= 5;
+    void resetRegenerateScales() final
+    {
+        if (dataset) {
+            dataset->resetRegenerateScales();
+            return;
+        }
+        for (auto &number : numbers) {
+            number.regenerateTicks = 0;
         }
     }
 
-    NumberPtr getGridNumber(int x, int y) final
+    int getBadCellCountBlock() const final
+    {
+        return dataset ? dataset->getCountBlock() : 1;
+    }
+
+    void countBadCells(int blockSize, std::vector<int>& counts) final
     {
-        if (auto itr = grid.find(x); itr != grid.end()) {
-            if (auto itr2 = itr->second.find(y); itr2 != itr->second.end()) {
-                return itr2->second;
+        int blocksPerSide = (gridSize + blockSize - 1) / blockSize;
+        counts.assign(static_cast<size_t>(blocksPerSide) * blocksPerSide, 0);
+        if (dataset) {
+            dataset->countBadCells(blockSize, counts);
+            return;
+        }
+        for (int x = 0; x < gridSize; x++) {
+            for (int y = 0; y < gridSize; y++) {
+                if (numbers[numberId(x, y)].hasBadGroup()) {
+                    counts[static_cast<size_t>(x / blockSize) * blocksPerSide + y / blockSize]++;
+                }
             }
         }
-        return nullptr;
     }
 
-    NumberPtr getGridNumber(int id) final
+    int randomNumber(int min, int max) final
+    {
+        std::uniform_int_distribution<> dist(min, max);
+        return dist(generator);
+    }
+
+    void setEventsEnabled(bool enabled) final
     {
-        if (auto itr = numberIdMap.find(id); itr != numberIdMap.end()) {
-            return itr->second;
+        eventsEnabled = enabled;
+        if (enabled) {
+            events.reserve(eventsReserve);
+        } else {
+            events.clear();
         }
-        return nullptr;
     }
 
-    std::map<int, BadGroupPtr> getBadGroups() const final
+    void takeEvents(std::vector<GridEvent>& taken) final
     {
-        return badGroups;
+        taken.clear();
+        std::swap(taken, events);
     }
 
 private:
-    std::map<int, std::map<int, NumberPtr>> grid;
-    std::map<int, NumberPtr> numberIdMap;
+    int gridSize;
+
+    // Column-major, a number's id is its index. Empty when the cells come from a dataset instead.
+    std::vector<Number> numbers;
+    std::unique_ptr<GridDataset> dataset;
+    std::vector<BadGroup> badGroups;
+
+    // Usually one, more when the grid is shown in several viewports
+    std::vector<GridRect> visibleRanges;
+
+    // Enough for a frame with a lot of refines landing, so the queue doesn't grow during a run
+    static constexpr size_t eventsReserve = 1024;
+    bool eventsEnabled = false;
+    std::vector<GridEvent> events;
 
-    std::map<int, BadGroupPtr> badGroups;
+    // Group lifecycle: a spawn timer activates a visible group, which then pulses every tick until it
+    // fades out, is refined or leaves the view, after which a cooldown spawn timer takes its place
+    enum TimerKind : uint8_t { SpawnTimer, PulseTimer };
+    TimerWheel timerWheel;
+    std::vector<TimerWheel::Timer> firedTimers;
+    int maxActiveGroups = 1;
+    int activeGroupCount = 0;
+    int pendingSpawns = 0;
 
-    std::set<int> visibleBadGroups;
-    std::optional<int> activeBadGroup = std::nullopt;
-    int newBadGroupCountdown = 50;
+    static constexpr int initialSpawnDelay = 10;
+    static constexpr int spawnRetryDelay = 5;
+    static constexpr int spawnSampleAttempts = 16;
+
+    // Seeded once so a given seed always reproduces the same grid and activity
+    std::mt19937 generator;
 
     siv::PerlinNoise perlinBadNumbers{ 505 };
     float badScale = 0.4f;
-    float badThresh = 0.5f;
+    float badThresh;
     bool newBad = false;
 
+    int numberId(int x, int y) const
+    {
+        return x * gridSize + y;
+    }
+
+    Number& cell(int x, int y)
+    {
+        return dataset ? dataset->cell(x, y) : numbers[numberId(x, y)];
+    }
+
+    // Keeps one spawn timer queued for every free activation slot
+    void scheduleSpawns(int delay)
+    {
+        while (activeGroupCount + pendingSpawns < maxActiveGroups) {
+            timerWheel.schedule(delay, 0, SpawnTimer);
+            pendingSpawns++;
+        }
+    }
+
+    void spawnActiveGroup()
+    {
+        pendingSpawns--;
+        if (activeGroupCount >= maxActiveGroups) {
+            return;
+        }
+
+        // Sample visible cells rather than scanning every group for one that's on screen
+        BadGroup* candidate = nullptr;
+        for (int attempt = 0; attempt < spawnSampleAttempts && !candidate && !visibleRanges.empty(); attempt++) {
+            // A single view draws no extra numbers, so seeded runs replay as before
+            const auto &visibleRange = visibleRanges.size() > 1 ? visibleRanges[randomNumber(0, static_cast<int>(visibleRanges.size()) - 1)] : visibleRanges[0];
+            if (!visibleRange.empty()) {
+                int x = randomNumber(visibleRange.minX, visibleRange.maxX - 1);
+                int y = randomNumber(visibleRange.minY, visibleRange.maxY - 1);
+                auto group = getBadGroup(cell(x, y).badGroupId);
+                if (group && !group->isActive && !group->refined) {
+                    candidate = group;
+                }
+            }
+        }
+
+        if (!candidate) {
+            scheduleSpawns(spawnRetryDelay);
+            return;
+        }
+
+        candidate->isActive = true;
+        candidate->scale = 0;
+        activeGroupCount++;
+        pushEvent(GridEventType::GroupActivated, candidate->id);
+        pulseGroup(*candidate);
+    }
+
+    void pulseGroup(BadGroup& badGroup)
+    {
+        if (!badGroup.isActive) {
+            return;
+        }
+        if (badGroup.refined || !isGroupVisible(badGroup)) {
+            deactivateGroup(badGroup);
+            return;
+        }
+
+        if (!badGroup.reachedMax) {
+            if (badGroup.scale < 0.23) {
+                badGroup.scale += (0.0005 * randomNumber(1, 10));
+            }
+        } else {
+            badGroup.scale -= (0.0001 * randomNumber(1, 10));
+        }
+
+        if (badGroup.scale >= 0.23) {
+            if (!badGroup.superActive || badGroup.scale >= 0.24) {
+                badGroup.reachedMax = true;
+            } else {
+                badGroup.scale += 0.00001;
+            }
+        } else if (badGroup.scale <= 0.0) {
+            deactivateGroup(badGroup);
+            return;
+        }
+
+        timerWheel.schedule(1, badGroup.id, PulseTimer);
+    }
+
+    void deactivateGroup(BadGroup& badGroup)
+    {
+        badGroup.isActive = false;
+        badGroup.superActive = false;
+        badGroup.reachedMax = false;
+        badGroup.scale = 0;
+        activeGroupCount--;
+        pushEvent(GridEventType::GroupDeactivated, badGroup.id);
+        scheduleSpawns(randomNumber(1, 3) * 5);
+    }
+
+    void pushEvent(GridEventType type, uint32_t groupId, int x = -1, int y = -1)
+    {
+        if (eventsEnabled) {
+            events.push_back(GridEvent{type, groupId, x, y});
+        }
+    }
+
+    bool isGroupVisible(const BadGroup& group)
+    {
+        for (const auto &visibleRange : visibleRanges) {
+            auto overlap = group.bounds.intersection(visibleRange);
+            for (int x = overlap.minX; x < overlap.maxX; x++) {
+                for (int y = overlap.minY; y < overlap.maxY; y++) {
+                    if (cell(x, y).badGroupId == group.id) {
+                        return true;
+                    }
+                }
+            }
+        }
+        return false;
+    }
+
     void generateGrid(int size)
     {
-        int numberId = 0;
-        std::set<int> badNumbers;
+        numbers.reserve(static_cast<size_t>(size) * size);
+        std::vector<bool> badNumbers(static_cast<size_t>(size) * size, false);
         for (int x = 0; x < size; x++) {
             for (int y = 0; y < size; y++) {
-                grid[x][y] = std::make_shared<Number>(numberId, x, y, randomNumber(0,9), randomBool());
-                numberIdMap[numberId] = grid[x][y];
+                int digit = randomNumber(0,9);
+                numbers.emplace_back(digit, randomBool());
 
                 // Determine if bad
-                if (perlinBadNumbers.noise2D_01(x*badScale,y*badScale) > badThresh) {
-                    badNumbers.insert(numberId);
-                }
-
-                numberId++;
+                badNumbers[numberId(x, y)] = perlinBadNumbers.noise2D_01(x*badScale,y*badScale) > badThresh;
             }
         }
 
         // Assign 'bad groups'
-        auto checkAdjacent = [&](int x, int y) -> BadGroupPtr {
+        auto checkAdjacent = [&](int x, int y) -> uint32_t {
             if (auto gridNum = getGridNumber(x, y)) {
-                return gridNum->badGroup;
+                return gridNum->badGroupId;
             }
-            return nullptr;
+            return NoBadGroup;
         };
 
-        int badGroup = 0;
-        for (const auto &badNumId : badNumbers) {
-            auto gridNumber = numberIdMap.at(badNumId);
-            if (!gridNumber->badGroup) {
-                for (int checkX = -1; checkX <= 1; checkX++) {
+        for (int x = 0; x < size; x++) {
+            for (int y = 0; y < size; y++) {
+                auto &gridNumber = numbers[numberId(x, y)];
+                if (!badNumbers[numberId(x, y)] || gridNumber.hasBadGroup()) {
+                    continue;
+                }
+
+                for (int checkX = -1; checkX <= 1 && !gridNumber.hasBadGroup(); checkX++) {
                     for (int checkY = -1; checkY <= 1; checkY++) {
                         if (checkX == 0 && checkY == 0) {
                             continue;
                         }
-                        if (auto badGroupPtr = checkAdjacent(gridNumber->gridX + checkX, gridNumber->gridY + checkY)) {
-                            gridNumber->badGroup = badGroupPtr;
-                            gridNumber->badGroup->numberIds.emplace_back(gridNumber->id);
+                        if (auto groupId = checkAdjacent(x + checkX, y + checkY); groupId != NoBadGroup) {
+                            gridNumber.badGroupId = groupId;
                             break;
                         }
                     }
-                    if (gridNumber->badGroup) {
-                        break;
-                    }
                 }
 
-                if (!gridNumber->badGroup) {
-                    gridNumber->badGroup = std::make_shared<BadGroup>(badGroup++, std::vector{gridNumber->id}, randomNumber(0,4));
-                    badGroups.emplace(badGroup, gridNumber->badGroup);
+                if (!gridNumber.hasBadGroup()) {
+                    gridNumber.badGroupId = static_cast<uint32_t>(badGroups.size());
+                    badGroups.emplace_back(gridNumber.badGroupId, randomNumber(0,4));
                 }
+
+                auto &group = badGroups[gridNumber.badGroupId];
+                group.bounds.include(x, y);
+                group.numberCount++;
             }
         }
     }
 
-    int randomNumber(int min, int max) final
-    {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
-        std::uniform_int_distribution<> dist(min, max);
-        return dist(gen);
-    }
-
-    static bool randomBool()
+    bool randomBool()
     {
-        return rand() > (RAND_MAX / 2);
+        return std::bernoulli_distribution(0.5)(generator);
     }
 
 };
 
-std::shared_ptr<NumberGrid> createNumberGrid(int gridSize)
+std::shared_ptr<NumberGrid> createNumberGrid(int gridSize, unsigned int seed, float badThreshold)
 {
-    return std::make_shared<NumberGridImpl>(gridSize);
-}
\ No newline at end of file
+    return std::make_shared<NumberGridImpl>(gridSize, seed, badThreshold);
+}
+
+std::shared_ptr<NumberGrid> loadNumberGrid(const std::string& datasetPath, unsigned int seed)
+{
+    auto dataset = openGridDataset(datasetPath);
+    std::vector<BadGroup> groups;
+    if (!dataset || !dataset->readGroups(groups)) {
+        return nullptr;
+    }
+    return std::make_shared<NumberGridImpl>(std::move(dataset), std::move(groups), seed);
+}
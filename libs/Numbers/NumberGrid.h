@@ -2,23 +2,97 @@
 
 #include "Number.h"
 
-#include <map>
 #include <memory>
+#include <string>
+#include <vector>
+
+enum class GridEventType : uint8_t
+{
+    GroupActivated,
+    GroupDeactivated,
+    GroupRefined,
+    // The cell at x, y got a new digit, groupId is the group it left
+    NumberRegenerated
+};
+
+// A change to group or cell state, so views can follow the grid without rescanning it
+struct GridEvent
+{
+    GridEventType type;
+    uint32_t groupId = NoBadGroup;
+    int x = -1, y = -1;
+};
 
 class NumberGrid
 {
 public:
     virtual void update() = 0;
 
-    virtual std::map<int, std::map<int, NumberPtr>> getGrid() = 0;
-    virtual NumberPtr getGridNumber(int x, int y) = 0;
-    virtual NumberPtr getGridNumber(int id) = 0;
+    // How many bad groups may be active (pulsing) at the same time
+    virtual void setMaxActiveGroups(int maxGroups) = 0;
+    virtual int getMaxActiveGroups() const = 0;
+    virtual int getActiveGroupCount() const = 0;
+
+    // Starts a visible, unrefined group pulsing right away, even past the active group limit
+    virtual bool activateGroup(uint32_t id) = 0;
+    // The group stops pulsing on its next tick. Its numbers stay in it until they're regenerated.
+    virtual bool refineGroup(uint32_t id) = 0;
+
+    virtual int getGridSize() const = 0;
+    // Fingerprint of the dataset the grid was loaded from, 0 for a generated grid
+    virtual uint64_t getContentId() const = 0;
+
+    // Cells currently on screen, used to pick which bad groups can activate
+    virtual void setVisibleRange(const GridRect& range) = 0;
+    // The same for several views of the grid at once, a group in any of them counts as visible
+    virtual void setVisibleRanges(const std::vector<GridRect>& ranges) = 0;
 
-    virtual std::map<int, BadGroupPtr> getBadGroups() const = 0;
+    virtual Number* getGridNumber(int x, int y) = 0;
+    virtual Number* getGridNumber(int id) = 0;
+
+    virtual std::vector<BadGroup>& getBadGroups() = 0;
+    virtual BadGroup* getBadGroup(uint32_t id) = 0;
+
+    // Removes the number from its bad group and gives it a new digit
+    virtual void regenerateNumber(int x, int y) = 0;
+    // The same with a digit picked elsewhere, such as by another kiosk. digit has to be 0-9.
+    virtual void setNumber(int x, int y, int digit) = 0;
+
+    // Starts every number fading in again. A dataset grid only restarts the numbers around the
+    // visible ranges, the rest are read back settled.
+    virtual void resetRegenerateScales() = 0;
+
+    // Bad cells in every blockSize x blockSize block, x-major, for overviews that mustn't read every
+    // cell of a dataset grid. blockSize has to be a multiple of getBadCellCountBlock().
+    virtual int getBadCellCountBlock() const = 0;
+    virtual void countBadCells(int blockSize, std::vector<int>& counts) = 0;
 
     virtual int randomNumber(int min, int max) = 0;
 
+    // Events are only queued once enabled, so a grid nobody drains doesn't keep growing its queue
+    virtual void setEventsEnabled(bool enabled) = 0;
+    // Everything queued since the last call, swapped into events so both vectors keep their capacity
+    virtual void takeEvents(std::vector<GridEvent>& events) = 0;
+
     virtual ~NumberGrid() = default;
 };
 
-std::shared_ptr<NumberGrid> createNumberGrid(int gridSize);
\ No newline at end of file
+// Calls fn(x, y, number) for every number still belonging to the group
+template <typename Fn>
+void forEachGroupNumber(NumberGrid& grid, const BadGroup& group, Fn&& fn)
+{
+    for (int x = group.bounds.minX; x < group.bounds.maxX; x++) {
+        for (int y = group.bounds.minY; y < group.bounds.maxY; y++) {
+            Number* number = grid.getGridNumber(x, y);
+            if (number->badGroupId == group.id) {
+                fn(x, y, *number);
+            }
+        }
+    }
+}
+
+std::shared_ptr<NumberGrid> createNumberGrid(int gridSize, unsigned int seed, float badThreshold = 0.5f);
+
+// The digits and bad groups come from a dataset file (GridDatasetFormat.h) instead of the generator,
+// which is then only used for activity and regenerated digits. Returns nullptr if it can't be opened.
+std::shared_ptr<NumberGrid> loadNumberGrid(const std::string& datasetPath, unsigned int seed);
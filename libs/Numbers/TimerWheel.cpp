@@ -0,0 +1,54 @@
+#include "TimerWheel.h"
+
+#include <algorithm>
+
+TimerWheel::TimerWheel()
+{
+    for (auto &slot : inner) {
+        slot.reserve(initialSlotCapacity);
+    }
+}
+
+void TimerWheel::schedule(uint64_t delayTicks, uint32_t id, uint8_t kind)
+{
+    insert(Timer{tick + std::max<uint64_t>(delayTicks, 1), id, kind});
+}
+
+void TimerWheel::advance(std::vector<Timer>& fired)
+{
+    tick++;
+
+    // Start of an inner revolution: pull the next block of timers in from the outer wheel
+    if ((tick & (innerSize - 1)) == 0) {
+        uint64_t block = tick >> innerBits;
+        if ((block & (outerSize - 1)) == 0) {
+            cascading.swap(overflow);
+            for (const auto &timer : cascading) {
+                insert(timer);
+            }
+            cascading.clear();
+        }
+
+        auto &slot = outer[block & (outerSize - 1)];
+        cascading.swap(slot);
+        for (const auto &timer : cascading) {
+            insert(timer);
+        }
+        cascading.clear();
+    }
+
+    auto &slot = inner[tick & (innerSize - 1)];
+    fired.insert(fired.end(), slot.begin(), slot.end());
+    slot.clear();
+}
+
+void TimerWheel::insert(const Timer& timer)
+{
+    if (timer.due - tick < innerSize) {
+        inner[timer.due & (innerSize - 1)].push_back(timer);
+    } else if ((timer.due >> innerBits) - (tick >> innerBits) < outerSize) {
+        outer[(timer.due >> innerBits) & (outerSize - 1)].push_back(timer);
+    } else {
+        overflow.push_back(timer);
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical timer wheel ticked once per grid update. Timers due within 256 ticks sit in the inner
+// wheel, later ones in coarser outer slots (or an overflow list) and cascade inwards as they come due,
+// so advancing only ever touches the timers that fire.
+class TimerWheel
+{
+public:
+    struct Timer
+    {
+        uint64_t due;
+        uint32_t id;
+        uint8_t kind;
+    };
+
+    TimerWheel();
+
+    // Delays shorter than one tick fire on the next advance
+    void schedule(uint64_t delayTicks, uint32_t id, uint8_t kind);
+
+    // Moves to the next tick and appends every timer due on it to 'fired'
+    void advance(std::vector<Timer>& fired);
+
+    uint64_t now() const { return tick; }
+
+private:
+    static constexpr int innerBits = 8;
+    static constexpr uint64_t innerSize = 1u << innerBits;
+    static constexpr uint64_t outerSize = 64;
+
+    // Room reserved in every inner slot, so steady pulsing doesn't grow a slot on its first use
+    static constexpr size_t initialSlotCapacity = 8;
+
+    void insert(const Timer& timer);
+
+    std::array<std::vector<Timer>, innerSize> inner;
+    std::array<std::vector<Timer>, outerSize> outer;
+    std::vector<Timer> overflow;
+    std::vector<Timer> cascading;
+
+    uint64_t tick = 0;
+};
@@ -0,0 +1,25 @@
+# Writes OUTPUT with the short SHA of SOURCE_DIR's checkout. Run on every build of numbers_bench, the
+# header is only touched when the SHA changed, so an unchanged checkout doesn't recompile the bench.
+set(sha "unknown")
+if(GIT_EXECUTABLE)
+    execute_process(
+            COMMAND ${GIT_EXECUTABLE} rev-parse --short HEAD
+            WORKING_DIRECTORY ${SOURCE_DIR}
+            OUTPUT_VARIABLE head_sha
+            OUTPUT_STRIP_TRAILING_WHITESPACE
+            RESULT_VARIABLE result
+            ERROR_QUIET
+    )
+    if(result EQUAL 0 AND head_sha)
+        set(sha ${head_sha})
+    endif()
+endif()
+
+set(content "#pragma once\n\n#define NUMBERS_BENCH_GIT_SHA \"${sha}\"\n")
+set(previous "")
+if(EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} previous)
+endif()
+if(NOT previous STREQUAL content)
+    file(WRITE ${OUTPUT} "${content}")
+endif()
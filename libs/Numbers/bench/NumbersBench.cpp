@@ -0,0 +1,280 @@
+// Microbenchmarks for the Numbers library.
+//
+// Usage: numbers_bench [--sizes 100,500,1000] [--thresholds 0.4,0.5,0.6] [--seed n] [--output results.json]
+//
+// Results are written as JSON (schema below is kept stable so runs can be compared across releases/architectures):
+// {
+//   "schema": 1, "git_sha": "...", "arch": "...", "compiler": "...", "seed": n,
+//   "results": [ { "benchmark": "...", "grid_size": n, "bad_threshold": f, "bad_groups": n,
+//                  "iterations": n, "total_ms": f, "ns_per_op": f, "rss_delta_bytes": n }, ... ]
+// }
+
+#include "NumberGrid.h"
+#include "NumbersBenchGitSha.h"
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include <json.hpp>
+
+namespace
+{
+    constexpr int schemaVersion = 1;
+
+    // Roughly what a 1080p window shows at the default zoom
+    constexpr int visibleColumns = 48;
+    constexpr int visibleRows = 24;
+
+    // Steady-state updates run until both limits are reached, so large grids don't take minutes
+    constexpr int minSteadyStateUpdates = 5;
+    constexpr double minSteadyStateMs = 500.0;
+    constexpr int stressActiveGroups = 48;
+    constexpr int lookupCount = 1 << 20;
+
+    using Clock = std::chrono::steady_clock;
+
+    struct BenchOptions
+    {
+        std::vector<int> sizes = {100, 250, 500, 1000, 2000};
+        std::vector<float> thresholds = {0.4f, 0.5f, 0.6f};
+        unsigned int seed = 1234;
+        std::string outputPath;
+    };
+
+    struct BenchResult
+    {
+        std::string benchmark;
+        int gridSize;
+        float badThreshold;
+        size_t badGroups;
+        long long iterations;
+        double totalMs;
+        long long rssDeltaBytes = 0;
+    };
+
+    const char* archName()
+    {
+#if defined(__aarch64__)
+        return "aarch64";
+#elif defined(__arm__)
+        return "arm";
+#elif defined(__x86_64__)
+        return "x86_64";
+#elif defined(__i386__)
+        return "x86";
+#else
+        return "unknown";
+#endif
+    }
+
+    std::string compilerName()
+    {
+        std::ostringstream ss;
+#if defined(__clang__)
+        ss << "clang " << __clang_major__ << "." << __clang_minor__;
+#elif defined(__GNUC__)
+        ss << "gcc " << __GNUC__ << "." << __GNUC_MINOR__;
+#else
+        ss << "unknown";
+#endif
+        return ss.str();
+    }
+
+    template <typename T>
+    std::vector<T> parseList(const std::string& arg)
+    {
+        std::vector<T> values;
+        std::stringstream ss(arg);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            std::stringstream itemStream(item);
+            T value;
+            if (itemStream >> value) {
+                values.push_back(value);
+            }
+        }
+        return values;
+    }
+
+    double timeMs(const std::function<void()>& fn)
+    {
+        auto start = Clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    // Keeps the optimiser from discarding lookup results
+    volatile long long sink = 0;
+
+    GridRect centerViewport(int gridSize)
+    {
+        int startX = std::max(0, gridSize/2 - visibleColumns/2);
+        int startY = std::max(0, gridSize/2 - visibleRows/2);
+        return GridRect{startX, startY, std::min(gridSize, startX + visibleColumns), std::min(gridSize, startY + visibleRows)};
+    }
+
+    // Resident set size from /proc, 0 where unavailable
+    long long residentBytes()
+    {
+        std::ifstream statm("/proc/self/statm");
+        long long totalPages = 0, residentPages = 0;
+        if (!(statm >> totalPages >> residentPages)) {
+            return 0;
+        }
+        return residentPages * sysconf(_SC_PAGESIZE);
+    }
+
+    void runCase(int gridSize, float badThreshold, unsigned int seed, std::vector<BenchResult>& results)
+    {
+        auto addResult = [&](const std::string& name, size_t badGroups, long long iterations, double totalMs, long long rssDeltaBytes = 0) {
+            results.push_back(BenchResult{name, gridSize, badThreshold, badGroups, iterations, totalMs, rssDeltaBytes});
+            std::cerr << "  " << name << ": " << totalMs << " ms (" << (totalMs * 1e6 / iterations) << " ns/op)" << std::endl;
+        };
+
+        std::cerr << "grid " << gridSize << "x" << gridSize << ", bad threshold " << badThreshold << std::endl;
+
+        std::shared_ptr<NumberGrid> grid;
+        long long rssBefore = residentBytes();
+        double generateMs = timeMs([&] { grid = createNumberGrid(gridSize, seed, badThreshold); });
+        long long rssDelta = residentBytes() - rssBefore;
+        size_t badGroupCount = grid->getBadGroups().size();
+        addResult("generate", badGroupCount, 1, generateMs, rssDelta);
+        std::cerr << "  grid memory: " << rssDelta / (1024 * 1024) << " MiB RSS, " << static_cast<double>(rssDelta) / (static_cast<double>(gridSize) * gridSize) << " bytes/cell" << std::endl;
+
+        // Steady state: a viewport's worth of cells is visible and groups cycle through activation
+        grid->setVisibleRange(centerViewport(gridSize));
+        long long updates = 0;
+        double updateMs = 0.0;
+        while (updates < minSteadyStateUpdates || updateMs < minSteadyStateMs) {
+            updateMs += timeMs([&] { grid->update(); });
+            updates++;
+        }
+        addResult("update_steady_state", badGroupCount, updates, updateMs);
+
+        // Stress scene: whole grid on screen with dozens of groups pulsing at once
+        grid->setVisibleRange(GridRect{0, 0, gridSize, gridSize});
+        grid->setMaxActiveGroups(stressActiveGroups);
+        long long stressUpdates = 0;
+        double stressMs = 0.0;
+        while (stressUpdates < minSteadyStateUpdates || stressMs < minSteadyStateMs) {
+            stressMs += timeMs([&] { grid->update(); });
+            stressUpdates++;
+        }
+        addResult("update_stress", badGroupCount, stressUpdates, stressMs);
+        grid->setMaxActiveGroups(1);
+        grid->setVisibleRange(centerViewport(gridSize));
+
+        std::mt19937 lookupGen(seed);
+        std::uniform_int_distribution<> coordDist(0, gridSize - 1);
+        std::uniform_int_distribution<> idDist(0, gridSize * gridSize - 1);
+        std::vector<std::pair<int, int>> coords(lookupCount);
+        std::vector<int> ids(lookupCount);
+        for (int i = 0; i < lookupCount; i++) {
+            coords[i] = {coordDist(lookupGen), coordDist(lookupGen)};
+            ids[i] = idDist(lookupGen);
+        }
+
+        double lookupXYMs = timeMs([&] {
+            long long sum = 0;
+            for (const auto &[x, y] : coords) {
+                sum += grid->getGridNumber(x, y)->num;
+            }
+            sink = sum;
+        });
+        addResult("lookup_xy", badGroupCount, lookupCount, lookupXYMs);
+
+        double lookupIdMs = timeMs([&] {
+            long long sum = 0;
+            for (int id : ids) {
+                sum += grid->getGridNumber(id)->num;
+            }
+            sink = sum;
+        });
+        addResult("lookup_id", badGroupCount, lookupCount, lookupIdMs);
+
+        long long badNumbers = 0;
+        double enumerateMs = timeMs([&] {
+            for (const auto &group : grid->getBadGroups()) {
+                forEachGroupNumber(*grid, group, [&](int, int, Number&) { badNumbers++; });
+            }
+            sink = badNumbers;
+        });
+        addResult("bad_group_enumeration", badGroupCount, std::max(1LL, badNumbers), enumerateMs);
+
+        // Refine every group and regenerate its numbers the way the panel does once they reach a bin
+        double regenerateMs = timeMs([&] {
+            for (auto &group : grid->getBadGroups()) {
+                grid->refineGroup(group.id);
+                forEachGroupNumber(*grid, group, [&](int x, int y, Number&) { grid->regenerateNumber(x, y); });
+            }
+            grid->update();
+        });
+        addResult("regenerate_after_refine", badGroupCount, std::max(1LL, badNumbers), regenerateMs);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--sizes") == 0 && hasValue) {
+            options.sizes = parseList<int>(argv[++i]);
+        } else if (strcmp(argv[i], "--thresholds") == 0 && hasValue) {
+            options.thresholds = parseList<float>(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && hasValue) {
+            options.seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--output") == 0 && hasValue) {
+            options.outputPath = argv[++i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--sizes 100,500] [--thresholds 0.4,0.5] [--seed n] [--output file.json]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<BenchResult> results;
+    for (int size : options.sizes) {
+        for (float threshold : options.thresholds) {
+            runCase(size, threshold, options.seed, results);
+        }
+    }
+
+    nlohmann::ordered_json json;
+    json["schema"] = schemaVersion;
+    json["git_sha"] = NUMBERS_BENCH_GIT_SHA;
+    json["arch"] = archName();
+    json["compiler"] = compilerName();
+    json["seed"] = options.seed;
+    json["results"] = nlohmann::ordered_json::array();
+    for (const auto &result : results) {
+        json["results"].push_back({
+            {"benchmark", result.benchmark},
+            {"grid_size", result.gridSize},
+            {"bad_threshold", result.badThreshold},
+            {"bad_groups", result.badGroups},
+            {"iterations", result.iterations},
+            {"total_ms", result.totalMs},
+            {"ns_per_op", result.totalMs * 1e6 / static_cast<double>(result.iterations)},
+            {"rss_delta_bytes", result.rssDeltaBytes}
+        });
+    }
+
+    if (options.outputPath.empty()) {
+        std::cout << json.dump(4) << std::endl;
+    } else {
+        std::ofstream file(options.outputPath);
+        if (!file.is_open()) {
+            std::cerr << "Error: Cannot open file for writing: " << options.outputPath << std::endl;
+            return 1;
+        }
+        file << json.dump(4) << std::endl;
+    }
+    return 0;
+}
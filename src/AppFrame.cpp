@@ -0,0 +1,70 @@
+#include "AppFrame.h"
+
+#include "Profiling/FrameProfiler.h"
+#include "Rendering/GpuTimer.h"
+#include "Rendering/StreamingRenderer.h"
+#include "Telemetry/MetricsRegistry.h"
+#include "UI/UIManager.h"
+
+#include "imgui.h"
+#include <imgui_impl_opengl3.h>
+
+void runAppFrame(UIManager& uiManager, FrameProfiler& frameProfiler, GpuTimer& gpuTimer, StreamingRenderer* streamingRenderer, MetricsRegistry* metrics)
+{
+    frameProfiler.beginFrame();
+    gpuTimer.beginFrame();
+    uiManager.newFrame();
+
+    // Draw
+    frameProfiler.beginStage(FrameStage::Draw);
+    uiManager.draw();
+    frameProfiler.endStage(FrameStage::Draw);
+
+    // Update
+    frameProfiler.beginStage(FrameStage::Update);
+    uiManager.update();
+    frameProfiler.endStage(FrameStage::Update);
+
+    // Render ImGui
+    frameProfiler.beginStage(FrameStage::Render);
+    ImGui::Render();
+    frameProfiler.endStage(FrameStage::Render);
+
+    frameProfiler.beginStage(FrameStage::Submit);
+    gpuTimer.begin(GpuSpan::Submit);
+    ImDrawData* drawData = ImGui::GetDrawData();
+    if (streamingRenderer) {
+        streamingRenderer->render(drawData);
+    } else {
+        ImGui_ImplOpenGL3_RenderDrawData(drawData);
+        frameProfiler.addCounter(FrameCounter::UploadBytes, static_cast<double>(drawData->TotalVtxCount * sizeof(ImDrawVert) + drawData->TotalIdxCount * sizeof(ImDrawIdx)));
+    }
+    gpuTimer.end(GpuSpan::Submit);
+    frameProfiler.endStage(FrameStage::Submit);
+    gpuTimer.endFrame();
+
+    int drawCalls = 0;
+    for (const ImDrawList* drawList : drawData->CmdLists) {
+        for (const ImDrawCmd& cmd : drawList->CmdBuffer) {
+            drawCalls += cmd.UserCallback == nullptr ? 1 : 0;
+        }
+    }
+    frameProfiler.addCounter(FrameCounter::DrawCalls, drawCalls);
+    frameProfiler.addCounter(FrameCounter::Vertices, drawData->TotalVtxCount);
+    uiManager.addMemoryCounters(frameProfiler);
+
+    // From the newest frame the GPU has finished, a few frames behind this one
+    for (auto [span, counter] : {std::pair{GpuSpan::Grid, FrameCounter::GpuGridTime}, std::pair{GpuSpan::Overlays, FrameCounter::GpuOverlaysTime},
+                                 std::pair{GpuSpan::Submit, FrameCounter::GpuSubmitTime}}) {
+        if (auto gpuTime = gpuTimer.getLastTime(span)) {
+            frameProfiler.addCounter(counter, *gpuTime);
+        }
+    }
+    frameProfiler.endFrame();
+
+    if (metrics) {
+        uiManager.publishMetrics(*metrics);
+        metrics->recordFrame(frameProfiler, ImGui::GetIO().DeltaTime);
+        metrics->recordGpuTimes(gpuTimer);
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+class FrameProfiler;
+class GpuTimer;
+class MetricsRegistry;
+class StreamingRenderer;
+class UIManager;
+
+// Builds, renders and submits one ImGui frame once the backends have started it.
+// Shared by the windowed and headless loops so both are profiled the same way.
+// With a metrics registry the finished frame is published to it.
+void runAppFrame(UIManager& uiManager, FrameProfiler& frameProfiler, GpuTimer& gpuTimer, StreamingRenderer* streamingRenderer, MetricsRegistry* metrics);
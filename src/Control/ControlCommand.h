@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+enum class ControlCommandType
+{
+    Pan,            // x, y: panel offset in grid units, as updateViewport stores it
+    Zoom,           // x: panel scale
+    FocusViewport,  // viewport: index of the split screen viewport later commands apply to
+    Hover,          // x, y: cursor position in screen pixels
+    ActivateGroup,  // groupId
+    RefineGroup,    // groupId
+    RefineVisible,
+    SetIdle,        // idle
+    ToggleIdle,
+    DumpState
+};
+
+// A parsed control request, applied by the render thread at a frame boundary
+struct ControlCommand
+{
+    ControlCommandType type = ControlCommandType::DumpState;
+    float x = 0.f;
+    float y = 0.f;
+    uint32_t groupId = 0;
+    int viewport = 0;
+    bool idle = false;
+};
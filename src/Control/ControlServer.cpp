@@ -0,0 +1,252 @@
+#include "ControlServer.h"
+
+#include "ControlCommand.h"
+#include "../Profiling/AllocationTracker.h"
+#include "../UI/UIManager.h"
+#include "Log.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <poll.h>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    std::optional<ControlCommand> parseCommand(const std::string& line, std::string& error)
+    {
+        std::istringstream stream(line);
+        std::string name;
+        stream >> name;
+
+        ControlCommand command;
+        auto readValues = [&](int count) {
+            bool ok = count < 1 || static_cast<bool>(stream >> command.x);
+            ok = ok && (count < 2 || static_cast<bool>(stream >> command.y));
+            if (!ok) {
+                error = "expected " + std::to_string(count) + " number(s) after " + name;
+            }
+            return ok;
+        };
+
+        if (name == "pan") {
+            command.type = ControlCommandType::Pan;
+            return readValues(2) ? std::optional(command) : std::nullopt;
+        } else if (name == "zoom") {
+            command.type = ControlCommandType::Zoom;
+            return readValues(1) ? std::optional(command) : std::nullopt;
+        } else if (name == "viewport") {
+            command.type = ControlCommandType::FocusViewport;
+            if (!(stream >> command.viewport)) {
+                error = "expected a viewport index after viewport";
+                return std::nullopt;
+            }
+            return command;
+        } else if (name == "hover") {
+            command.type = ControlCommandType::Hover;
+            return readValues(2) ? std::optional(command) : std::nullopt;
+        } else if (name == "activate" || name == "refine") {
+            std::string target;
+            stream >> target;
+            if (name == "refine" && target == "visible") {
+                command.type = ControlCommandType::RefineVisible;
+                return command;
+            }
+            char* end = nullptr;
+            unsigned long id = std::strtoul(target.c_str(), &end, 10);
+            if (target.empty() || *end != '\0') {
+                error = "expected a group id after " + name;
+                return std::nullopt;
+            }
+            command.type = name == "activate" ? ControlCommandType::ActivateGroup : ControlCommandType::RefineGroup;
+            command.groupId = static_cast<uint32_t>(id);
+            return command;
+        } else if (name == "idle") {
+            std::string mode;
+            stream >> mode;
+            if (mode.empty()) {
+                command.type = ControlCommandType::ToggleIdle;
+            } else if (mode == "on" || mode == "off") {
+                command.type = ControlCommandType::SetIdle;
+                command.idle = mode == "on";
+            } else {
+                error = "expected on or off after idle";
+                return std::nullopt;
+            }
+            return command;
+        } else if (name == "state") {
+            command.type = ControlCommandType::DumpState;
+            return command;
+        }
+        error = "unknown command '" + name + "'";
+        return std::nullopt;
+    }
+}
+
+class ControlServerImpl : public ControlServer
+{
+public:
+    ControlServerImpl(int listenFd, std::string socketPath) : listenFd(listenFd), socketPath(std::move(socketPath))
+    {
+        thread = std::thread([this] {
+            setThreadAllocationTracking(false);
+            serveLoop();
+        });
+    }
+
+    ~ControlServerImpl() override
+    {
+        stopping.store(true, std::memory_order_relaxed);
+        thread.join();
+        close(listenFd);
+        unlink(socketPath.c_str());
+    }
+
+    void applyPendingCommands(UIManager& uiManager) final
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queued.empty()) {
+                return;
+            }
+            applying.swap(queued);
+        }
+        for (auto &request : applying) {
+            request.reply.set_value(uiManager.handleCommand(request.command));
+        }
+        applying.clear();
+    }
+
+private:
+    struct PendingRequest
+    {
+        ControlCommand command;
+        std::promise<std::string> reply;
+    };
+
+    // One client at a time, later connections wait in the listen backlog
+    void serveLoop()
+    {
+        while (!stopping.load(std::memory_order_relaxed)) {
+            if (!waitReadable(listenFd)) {
+                continue;
+            }
+            int clientFd = accept(listenFd, nullptr, nullptr);
+            if (clientFd >= 0) {
+                serveClient(clientFd);
+                close(clientFd);
+            }
+        }
+    }
+
+    void serveClient(int clientFd)
+    {
+        std::string buffer;
+        char chunk[512];
+        while (!stopping.load(std::memory_order_relaxed)) {
+            if (!waitReadable(clientFd)) {
+                continue;
+            }
+            ssize_t received = recv(clientFd, chunk, sizeof(chunk), 0);
+            if (received <= 0) {
+                return;
+            }
+            buffer.append(chunk, static_cast<size_t>(received));
+
+            size_t lineEnd;
+            while ((lineEnd = buffer.find('\n')) != std::string::npos) {
+                std::string line = buffer.substr(0, lineEnd);
+                buffer.erase(0, lineEnd + 1);
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                if (line.empty()) {
+                    continue;
+                }
+                std::string reply = execute(line);
+                reply += "\n";
+                if (send(clientFd, reply.data(), reply.size(), MSG_NOSIGNAL) < 0) {
+                    return;
+                }
+            }
+        }
+    }
+
+    // Queues the command for the next frame boundary and waits for the render thread to answer
+    std::string execute(const std::string& line)
+    {
+        std::string error;
+        auto command = parseCommand(line, error);
+        if (!command) {
+            return "error: " + error;
+        }
+
+        std::future<std::string> reply;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queued.push_back(PendingRequest{*command, {}});
+            reply = queued.back().reply.get_future();
+        }
+        while (reply.wait_for(std::chrono::milliseconds(pollIntervalMs)) != std::future_status::ready) {
+            if (stopping.load(std::memory_order_relaxed)) {
+                return "error: shutting down";
+            }
+        }
+        return reply.get();
+    }
+
+    bool waitReadable(int fd)
+    {
+        // Wake up regularly to notice shutdown
+        pollfd readPoll{fd, POLLIN, 0};
+        return poll(&readPoll, 1, pollIntervalMs) > 0;
+    }
+
+    static constexpr int pollIntervalMs = 100;
+
+    int listenFd;
+    std::string socketPath;
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+
+    std::mutex mutex;
+    std::vector<PendingRequest> queued;
+    std::vector<PendingRequest> applying;
+};
+
+std::shared_ptr<ControlServer> createControlServer(const std::string& socketPath)
+{
+    sockaddr_un address{};
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        LOG_ERROR("Control socket path is too long: %s", socketPath.c_str());
+        return nullptr;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOG_ERROR("Failed to create control socket: %s", strerror(errno));
+        return nullptr;
+    }
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+    // A previous run that didn't shut down cleanly leaves the socket file behind
+    unlink(socketPath.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 4) < 0) {
+        LOG_ERROR("Failed to open control socket %s: %s", socketPath.c_str(), strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+
+    LOG_INFO("Accepting control commands on %s", socketPath.c_str());
+    return std::make_shared<ControlServerImpl>(fd, socketPath);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+class UIManager;
+
+// Line-based command protocol on a Unix socket, for driving the panel from test scripts.
+// Requests are parsed on the server's own thread and queued; each gets a one-line reply once the
+// render thread has applied it.
+//
+//   pan <x> <y>            set the panel offset (grid units)
+//   zoom <scale>           set the panel scale
+//   viewport <index>       direct later commands at one split screen viewport
+//   hover <x> <y>          move the cursor to a screen position
+//   activate <group>       force a bad group active
+//   refine <group>         refine a bad group
+//   refine visible         refine every unrefined group in view
+//   idle [on|off]          enter or leave the idle screen, toggles without an argument
+//   state                  reply with the panel state as JSON
+class ControlServer {
+public:
+    // Render thread, at a frame boundary after the platform backend's NewFrame and before ImGui::NewFrame
+    virtual void applyPendingCommands(UIManager& uiManager) = 0;
+
+    virtual ~ControlServer() = default;
+};
+
+// Returns nullptr if the socket can't be opened
+std::shared_ptr<ControlServer> createControlServer(const std::string& socketPath);
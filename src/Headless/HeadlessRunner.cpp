@@ -0,0 +1,420 @@
+#include "HeadlessRunner.h"
+
+#include "PngWriter.h"
+#include "../AppFrame.h"
+#include "../Control/ControlServer.h"
+#include "../LaunchOptions.h"
+#include "../Input/InputReplay.h"
+#include "../Profiling/AllocationTracker.h"
+#include "../Profiling/FrameProfiler.h"
+#include "../Profiling/PerfCounters.h"
+#include "../Rendering/GL.h"
+#include "../Rendering/GpuTimer.h"
+#include "../Rendering/StreamingRenderer.h"
+#include "../Telemetry/MetricsRegistry.h"
+#include "../Telemetry/MetricsServer.h"
+#include "../UI/UIManager.h"
+#include "Log.h"
+
+#include "imgui.h"
+#include <imgui_impl_opengl3.h>
+
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <iostream>
+#include <optional>
+
+#ifdef LUMON_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+namespace
+{
+    // Fixed step so every headless run of the same path renders the same frames
+    constexpr float headlessDeltaTime = 1.f / 60.f;
+
+    struct EglContext
+    {
+        EGLDisplay display = EGL_NO_DISPLAY;
+        EGLSurface surface = EGL_NO_SURFACE;
+        EGLContext context = EGL_NO_CONTEXT;
+    };
+
+    bool createContext(EglContext& egl)
+    {
+        // Mesa's surfaceless platform needs no display server at all, otherwise use the default display with a pbuffer
+        auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+        bool surfaceless = false;
+        if (getPlatformDisplay) {
+            egl.display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            surfaceless = egl.display != EGL_NO_DISPLAY && eglInitialize(egl.display, nullptr, nullptr);
+        }
+        if (!surfaceless) {
+            egl.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            if (egl.display == EGL_NO_DISPLAY || !eglInitialize(egl.display, nullptr, nullptr)) {
+                LOG_ERROR("Failed to initialise EGL");
+                return false;
+            }
+        }
+
+#ifdef LUMON_GLES
+        eglBindAPI(EGL_OPENGL_ES_API);
+        EGLint renderableType = EGL_OPENGL_ES2_BIT;
+#else
+        eglBindAPI(EGL_OPENGL_API);
+        EGLint renderableType = EGL_OPENGL_BIT;
+#endif
+        const EGLint configAttribs[] = {
+            EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, renderableType,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(egl.display, configAttribs, &config, 1, &configCount) || configCount == 0) {
+            LOG_ERROR("No suitable EGL config");
+            return false;
+        }
+
+#ifdef LUMON_GLES
+        // Same preference as the windowed build: GLES 3.0, then 2.0
+        for (EGLint version : {3, 2}) {
+            const EGLint contextAttribs[] = {EGL_CONTEXT_CLIENT_VERSION, version, EGL_NONE};
+            egl.context = eglCreateContext(egl.display, config, EGL_NO_CONTEXT, contextAttribs);
+            if (egl.context != EGL_NO_CONTEXT) {
+                break;
+            }
+        }
+#else
+        egl.context = eglCreateContext(egl.display, config, EGL_NO_CONTEXT, nullptr);
+#endif
+        if (egl.context == EGL_NO_CONTEXT) {
+            LOG_ERROR("Failed to create EGL context");
+            return false;
+        }
+
+        // Everything is drawn into our own framebuffer, the pbuffer only exists to make the context current
+        if (!surfaceless) {
+            const EGLint pbufferAttribs[] = {EGL_WIDTH, 16, EGL_HEIGHT, 16, EGL_NONE};
+            egl.surface = eglCreatePbufferSurface(egl.display, config, pbufferAttribs);
+        }
+        if (!eglMakeCurrent(egl.display, egl.surface, egl.surface, egl.context)) {
+            LOG_ERROR("Failed to make the EGL context current");
+            return false;
+        }
+        LOG_INFO("Headless %s context: %s (%s)", surfaceless ? "surfaceless" : "pbuffer",
+                 reinterpret_cast<const char*>(glGetString(GL_VERSION)), reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+#ifdef LUMON_GLES
+        if (!hasElementIndexUint()) {
+            LOG_ERROR("GLES 2.0 context without GL_OES_element_index_uint, the grid needs 32-bit indices");
+            return false;
+        }
+#endif
+        return true;
+    }
+
+    void destroyContext(EglContext& egl)
+    {
+        if (egl.display == EGL_NO_DISPLAY) {
+            return;
+        }
+        eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (egl.context != EGL_NO_CONTEXT) {
+            eglDestroyContext(egl.display, egl.context);
+        }
+        if (egl.surface != EGL_NO_SURFACE) {
+            eglDestroySurface(egl.display, egl.surface);
+        }
+        eglTerminate(egl.display);
+    }
+
+    // Scripted input standing in for an operator: the cursor wanders across the grid while the
+    // view scrolls, pans and zooms, so hover scaling and culling are exercised every frame
+    void injectSweepCamera(int frame, const ImVec2& displaySize)
+    {
+        ImGuiIO& io = ImGui::GetIO();
+        float t = static_cast<float>(frame);
+        io.AddMousePosEvent(displaySize.x * (0.5f + 0.4f*std::sin(t*0.013f)), displaySize.y * (0.5f + 0.3f*std::sin(t*0.021f)));
+        io.AddMouseWheelEvent(0.f, 0.5f*std::sin(t*0.01f));
+
+        auto tapKey = [&](ImGuiKey key, int period, int phase) {
+            if (frame % period == phase) {
+                io.AddKeyEvent(key, true);
+            } else if (frame % period == phase + 1) {
+                io.AddKeyEvent(key, false);
+            }
+        };
+        bool firstHalf = (frame / 240) % 2 == 0;
+        tapKey(firstHalf ? ImGuiKey_RightArrow : ImGuiKey_LeftArrow, 30, 0);
+        tapKey(firstHalf ? ImGuiKey_Period : ImGuiKey_Comma, 90, 45);
+    }
+
+    // Frame read back into a pixel buffer, mapped a frame later so the readback doesn't stall the GPU
+    struct PendingCapture
+    {
+        int frame;
+        GLuint buffer;
+    };
+
+    class FrameCapture
+    {
+    public:
+        FrameCapture(int width, int height, std::string directory)
+            : width(width), height(height), directory(std::move(directory)), usePixelBuffers(getGLVersion() >= 30) {}
+
+        ~FrameCapture()
+        {
+            flush();
+            for (GLuint buffer : freeBuffers) {
+                glDeleteBuffers(1, &buffer);
+            }
+        }
+
+        void capture(int frame)
+        {
+            if (!usePixelBuffers) {
+                // GLES 2.0 has no pixel buffers, read straight back
+                std::vector<unsigned char> pixels(byteSize());
+                glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+                save(frame, pixels.data());
+                return;
+            }
+
+            GLuint buffer = 0;
+            if (freeBuffers.empty()) {
+                glGenBuffers(1, &buffer);
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+                glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(byteSize()), nullptr, GL_STREAM_READ);
+            } else {
+                buffer = freeBuffers.back();
+                freeBuffers.pop_back();
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+            }
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            pending.push_back(PendingCapture{frame, buffer});
+        }
+
+        // Saves captures issued before the given frame
+        void resolve(int beforeFrame)
+        {
+            while (!pending.empty() && pending.front().frame < beforeFrame) {
+                auto capture = pending.front();
+                pending.pop_front();
+
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, capture.buffer);
+                auto pixels = static_cast<const unsigned char*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(byteSize()), GL_MAP_READ_BIT));
+                if (pixels) {
+                    save(capture.frame, pixels);
+                    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+                } else {
+                    LOG_ERROR("Failed to map capture of frame %d", capture.frame);
+                }
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                freeBuffers.push_back(capture.buffer);
+            }
+        }
+
+        void flush()
+        {
+            resolve(INT32_MAX);
+        }
+
+    private:
+        size_t byteSize() const
+        {
+            return static_cast<size_t>(width) * height * 4;
+        }
+
+        void save(int frame, const unsigned char* bottomUp)
+        {
+            // GL rows start at the bottom
+            size_t rowBytes = static_cast<size_t>(width) * 4;
+            flipped.resize(byteSize());
+            for (int y = 0; y < height; y++) {
+                std::copy_n(bottomUp + (height - 1 - y)*rowBytes, rowBytes, flipped.data() + y*rowBytes);
+            }
+            char name[32];
+            snprintf(name, sizeof(name), "frame_%05d.png", frame);
+            std::string path = directory + "/" + name;
+            if (writePng(path, width, height, flipped.data())) {
+                LOG_INFO("Captured frame %d to %s", frame, path.c_str());
+            }
+        }
+
+        int width, height;
+        std::string directory;
+        bool usePixelBuffers;
+        std::deque<PendingCapture> pending;
+        std::vector<GLuint> freeBuffers;
+        std::vector<unsigned char> flipped;
+    };
+}
+
+int runHeadless(const LaunchOptions& launchOptions)
+{
+    LaunchOptions options = launchOptions;
+
+    // Replays bring their own seed, resolution and input
+    std::shared_ptr<InputPlayer> inputPlayer;
+    if (options.replayPath) {
+        inputPlayer = createInputPlayer(*options.replayPath);
+        if (!inputPlayer) {
+            return -1;
+        }
+        options.seed = inputPlayer->getSeed();
+        options.headlessWidth = static_cast<int>(inputPlayer->getDisplaySize().x);
+        options.headlessHeight = static_cast<int>(inputPlayer->getDisplaySize().y);
+        options.headlessFrames = std::min(options.headlessFrames, inputPlayer->getFrameCount());
+    } else if (options.cameraPath != "sweep" && options.cameraPath != "static") {
+        LOG_ERROR("Unknown camera path '%s' (expected sweep or static)", options.cameraPath.c_str());
+        return -1;
+    }
+
+    EglContext egl;
+    if (!createContext(egl)) {
+        destroyContext(egl);
+        return -1;
+    }
+
+    int width = options.headlessWidth;
+    int height = options.headlessHeight;
+    GLuint colorTexture, framebuffer;
+    glGenTextures(1, &colorTexture);
+    glBindTexture(GL_TEXTURE_2D, colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        LOG_ERROR("Headless framebuffer is incomplete (%dx%d)", width, height);
+        destroyContext(egl);
+        return -1;
+    }
+
+    int exitCode = 0;
+    {
+        std::shared_ptr<GpuTimer> gpuTimer = createGpuTimer();
+        std::shared_ptr<FrameProfiler> frameProfiler = createFrameProfiler(static_cast<size_t>(options.headlessFrames),
+                                                                           options.perfCounters ? createPerfCounters() : nullptr);
+        std::shared_ptr<UIManager> uiManager = createUIManager(options, frameProfiler, gpuTimer);
+        if (!uiManager) {
+            // The GPU timer's queries go while the context is still current
+            gpuTimer.reset();
+            glDeleteFramebuffers(1, &framebuffer);
+            glDeleteTextures(1, &colorTexture);
+            destroyContext(egl);
+            return -1;
+        }
+        uiManager->init(nullptr);
+
+        std::shared_ptr<StreamingRenderer> streamingRenderer;
+        if (options.streamingRenderer) {
+            streamingRenderer = createStreamingRenderer(frameProfiler, options.framesInFlight);
+            if (!streamingRenderer) {
+                LOG_WARNING("Falling back to the default renderer");
+            }
+        }
+
+        // Published every frame, scraped from the server's own thread
+        std::shared_ptr<MetricsRegistry> metrics;
+        std::shared_ptr<MetricsServer> metricsServer;
+        if (options.metricsAddress) {
+            metrics = createMetricsRegistry();
+            metricsServer = createMetricsServer(*options.metricsAddress, metrics);
+            if (!metricsServer) {
+                metrics.reset();
+            }
+        }
+
+        std::shared_ptr<ControlServer> controlServer;
+        if (options.controlSocket) {
+            controlServer = createControlServer(*options.controlSocket);
+        }
+
+        std::optional<AllocationCheck> allocationCheck;
+        if (options.allocCheckWarmupFrames) {
+            allocationCheck.emplace(*options.allocCheckWarmupFrames);
+        }
+
+        FrameCapture frameCapture(width, height, options.captureDir);
+        auto isCaptureFrame = [&](int frame) {
+            return std::find(options.captureFrames.begin(), options.captureFrames.end(), frame) != options.captureFrames.end();
+        };
+
+        ImVec2 displaySize(static_cast<float>(width), static_cast<float>(height));
+        auto start = std::chrono::steady_clock::now();
+        int frame = 0;
+        for (; frame < options.headlessFrames; frame++) {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+            glViewport(0, 0, width, height);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            ImGui_ImplOpenGL3_NewFrame();
+            if (inputPlayer) {
+                if (!inputPlayer->injectFrame()) {
+                    break;
+                }
+            } else {
+                ImGuiIO& io = ImGui::GetIO();
+                io.DisplaySize = displaySize;
+                io.DeltaTime = headlessDeltaTime;
+                if (options.cameraPath == "sweep") {
+                    injectSweepCamera(frame, displaySize);
+                }
+            }
+
+            if (controlServer) {
+                controlServer->applyPendingCommands(*uiManager);
+            }
+
+            runAppFrame(*uiManager, *frameProfiler, *gpuTimer, streamingRenderer.get(), metrics.get());
+            if (allocationCheck) {
+                allocationCheck->checkFrame(*frameProfiler);
+            }
+
+            frameCapture.resolve(frame);
+            if (isCaptureFrame(frame)) {
+                frameCapture.capture(frame);
+            }
+        }
+        glFinish();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        frameCapture.flush();
+
+        getLogger().flush();
+        std::cout << "Rendered " << frame << " frames at " << width << "x" << height << " in " << seconds << " s ("
+                  << (seconds > 0.0 ? frame / seconds : 0.0) << " fps)" << std::endl;
+        frameProfiler->printSummary();
+        if (options.frameTimesPath) {
+            frameProfiler->writeFrameTimes(*options.frameTimesPath);
+        }
+
+        if (allocationCheck && !allocationCheck->passed()) {
+            LOG_ERROR("Allocation check failed: %d frame(s) allocated after warm-up", allocationCheck->getFailedFrames());
+            exitCode = 1;
+        }
+
+        controlServer.reset();
+        metricsServer.reset();
+        streamingRenderer.reset();
+        uiManager->cleanup();
+    }
+
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteTextures(1, &colorTexture);
+    destroyContext(egl);
+    return exitCode;
+}
+
+#else
+
+int runHeadless(const LaunchOptions&)
+{
+    LOG_ERROR("This build has no EGL, --headless is unavailable");
+    return -1;
+}
+
+#endif
@@ -0,0 +1,9 @@
+#pragma once
+
+struct LaunchOptions;
+
+// Renders options.headlessFrames frames into an offscreen framebuffer through EGL (no window or
+// X display), driving the camera with a synthetic path or a replay. Selected frames are read back
+// through pixel buffers and saved as PNGs, and throughput is printed at the end.
+// Returns the process exit code.
+int runHeadless(const LaunchOptions& options);
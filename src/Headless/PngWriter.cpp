@@ -0,0 +1,104 @@
+#include "PngWriter.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+    uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+    {
+        static const auto table = [] {
+            std::array<uint32_t, 256> t{};
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++) {
+                    c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                }
+                t[n] = c;
+            }
+            return t;
+        }();
+
+        crc = ~crc;
+        for (size_t i = 0; i < size; i++) {
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return ~crc;
+    }
+
+    void appendBigEndian(std::vector<unsigned char>& out, uint32_t value)
+    {
+        out.push_back(static_cast<unsigned char>(value >> 24));
+        out.push_back(static_cast<unsigned char>(value >> 16));
+        out.push_back(static_cast<unsigned char>(value >> 8));
+        out.push_back(static_cast<unsigned char>(value));
+    }
+
+    void appendChunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data)
+    {
+        appendBigEndian(out, static_cast<uint32_t>(data.size()));
+        size_t typeStart = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data.begin(), data.end());
+        appendBigEndian(out, crc32(&out[typeStart], data.size() + 4));
+    }
+}
+
+bool writePng(const std::string& path, int width, int height, const unsigned char* rgba)
+{
+    // Scanlines with filter type 0, wrapped in a zlib stream of stored (uncompressed) deflate blocks
+    size_t rowBytes = static_cast<size_t>(width) * 4;
+    std::vector<unsigned char> raw;
+    raw.reserve((rowBytes + 1) * height);
+    for (int y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba + y*rowBytes, rgba + (y + 1)*rowBytes);
+    }
+
+    constexpr size_t maxStoredBlock = 65535;
+    std::vector<unsigned char> zlib = {0x78, 0x01};
+    zlib.reserve(raw.size() + raw.size() / maxStoredBlock * 5 + 16);
+    for (size_t offset = 0; offset < raw.size() || offset == 0; offset += maxStoredBlock) {
+        size_t size = std::min(maxStoredBlock, raw.size() - offset);
+        bool last = offset + size >= raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(static_cast<unsigned char>(size));
+        zlib.push_back(static_cast<unsigned char>(size >> 8));
+        zlib.push_back(static_cast<unsigned char>(~size));
+        zlib.push_back(static_cast<unsigned char>(~size >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        if (last) {
+            break;
+        }
+    }
+
+    uint32_t a = 1, b = 0;
+    for (unsigned char byte : raw) {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    appendBigEndian(zlib, (b << 16) | a);
+
+    std::vector<unsigned char> header;
+    appendBigEndian(header, static_cast<uint32_t>(width));
+    appendBigEndian(header, static_cast<uint32_t>(height));
+    header.insert(header.end(), {8, 6, 0, 0, 0}); // 8-bit RGBA, no interlace
+
+    std::vector<unsigned char> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    appendChunk(png, "IHDR", header);
+    appendChunk(png, "IDAT", zlib);
+    appendChunk(png, "IEND", {});
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        LOG_ERROR("Cannot open capture for writing: %s", path.c_str());
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+    return file.good();
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+// Writes 8-bit RGBA pixels (rows top to bottom) as an uncompressed PNG. Captures are meant for
+// golden-image comparisons, so exact pixels matter more than file size.
+bool writePng(const std::string& path, int width, int height, const unsigned char* rgba);
@@ -0,0 +1,245 @@
+#include "InputReplay.h"
+
+#include "Log.h"
+
+#include <imgui_internal.h>
+#include <fstream>
+#include <vector>
+#include <json.hpp>
+
+namespace
+{
+    constexpr int recordingVersion = 1;
+
+    // Events are stored as compact arrays: [type, values...]
+    nlohmann::json eventToJson(const ImGuiInputEvent& event)
+    {
+        switch (event.Type) {
+            case ImGuiInputEventType_MousePos:
+                return {"p", event.MousePos.PosX, event.MousePos.PosY};
+            case ImGuiInputEventType_MouseWheel:
+                return {"w", event.MouseWheel.WheelX, event.MouseWheel.WheelY};
+            case ImGuiInputEventType_MouseButton:
+                return {"b", event.MouseButton.Button, event.MouseButton.Down};
+            case ImGuiInputEventType_Key:
+                return {"k", static_cast<int>(event.Key.Key), event.Key.Down, event.Key.AnalogValue};
+            case ImGuiInputEventType_Text:
+                return {"c", event.Text.Char};
+            case ImGuiInputEventType_Focus:
+                return {"f", event.AppFocused.Focused};
+            default:
+                return nullptr;
+        }
+    }
+
+    // injectEvent reads events unchecked, so a recording is validated whole before playback starts
+    bool isValidEvent(const nlohmann::json& event)
+    {
+        if (!event.is_array() || event.empty() || !event[0].is_string()) {
+            return false;
+        }
+        const auto &type = event[0].get_ref<const std::string&>();
+        auto numbers = [&](size_t first, size_t count) {
+            for (size_t i = first; i < first + count; i++) {
+                if (!event[i].is_number()) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        if (type == "p" || type == "w") {
+            return event.size() == 3 && numbers(1, 2);
+        } else if (type == "b") {
+            return event.size() == 3 && event[1].is_number_integer() && event[2].is_boolean();
+        } else if (type == "k") {
+            return event.size() == 4 && event[1].is_number_integer() && event[2].is_boolean() && numbers(3, 1);
+        } else if (type == "c") {
+            return event.size() == 2 && event[1].is_number_unsigned();
+        } else if (type == "f") {
+            return event.size() == 2 && event[1].is_boolean();
+        }
+        // Unknown types are skipped on playback
+        return true;
+    }
+
+    bool isValidFrame(const nlohmann::json& frame)
+    {
+        if (!frame.is_object() || !frame.contains("dt") || !frame["dt"].is_number() || !frame.contains("events") || !frame["events"].is_array()) {
+            return false;
+        }
+        for (const auto &event : frame["events"]) {
+            if (!isValidEvent(event)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void injectEvent(ImGuiIO& io, const nlohmann::json& event)
+    {
+        const auto &type = event.at(0).get_ref<const std::string&>();
+        if (type == "p") {
+            io.AddMousePosEvent(event.at(1).get<float>(), event.at(2).get<float>());
+        } else if (type == "w") {
+            io.AddMouseWheelEvent(event.at(1).get<float>(), event.at(2).get<float>());
+        } else if (type == "b") {
+            io.AddMouseButtonEvent(event.at(1).get<int>(), event.at(2).get<bool>());
+        } else if (type == "k") {
+            io.AddKeyAnalogEvent(static_cast<ImGuiKey>(event.at(1).get<int>()), event.at(2).get<bool>(), event.at(3).get<float>());
+        } else if (type == "c") {
+            io.AddInputCharacter(event.at(1).get<unsigned int>());
+        } else if (type == "f") {
+            io.AddFocusEvent(event.at(1).get<bool>());
+        }
+    }
+}
+
+class InputRecorderImpl : public InputRecorder
+{
+public:
+    InputRecorderImpl(std::string path, unsigned int seed, const ImVec2& displaySize) : path(std::move(path))
+    {
+        recording["version"] = recordingVersion;
+        recording["seed"] = seed;
+        recording["displaySize"] = {displaySize.x, displaySize.y};
+        recording["frames"] = nlohmann::json::array();
+    }
+
+    void captureFrame() final
+    {
+        ImGuiContext& g = *GImGui;
+
+        // Queue can still hold older events that ImGui is trickling over several frames, only take new ones
+        auto events = nlohmann::json::array();
+        for (const auto &event : g.InputEventsQueue) {
+            if (event.EventId < nextEventId) {
+                continue;
+            }
+            if (auto eventJson = eventToJson(event); !eventJson.is_null()) {
+                events.push_back(std::move(eventJson));
+            }
+        }
+        nextEventId = g.InputEventsNextEventId;
+
+        elapsedTime += g.IO.DeltaTime;
+        recording["frames"].push_back({{"t", elapsedTime}, {"dt", g.IO.DeltaTime}, {"events", std::move(events)}});
+    }
+
+    bool save() final
+    {
+        std::ofstream file(path);
+        if (!file.is_open()) {
+            LOG_ERROR("Cannot open recording for writing: %s", path.c_str());
+            return false;
+        }
+        file << recording.dump();
+        LOG_INFO("Saved input recording (%zu frames) to %s", recording["frames"].size(), path.c_str());
+        return true;
+    }
+
+private:
+    std::string path;
+    nlohmann::json recording;
+    ImU32 nextEventId = 0;
+    double elapsedTime = 0.0;
+};
+
+class InputPlayerImpl : public InputPlayer
+{
+public:
+    explicit InputPlayerImpl(nlohmann::json recording) : recording(std::move(recording))
+    {
+        seed = this->recording.at("seed").get<unsigned int>();
+        const auto &size = this->recording.at("displaySize");
+        displaySize = ImVec2(size.at(0).get<float>(), size.at(1).get<float>());
+    }
+
+    unsigned int getSeed() const final
+    {
+        return seed;
+    }
+
+    ImVec2 getDisplaySize() const final
+    {
+        return displaySize;
+    }
+
+    int getFrameCount() const final
+    {
+        return static_cast<int>(recording.at("frames").size());
+    }
+
+    bool injectFrame() final
+    {
+        const auto &frames = recording.at("frames");
+        if (frameIdx >= frames.size()) {
+            return false;
+        }
+
+        ImGuiContext& g = *GImGui;
+        ImGuiIO& io = g.IO;
+
+        // Drop everything the live backend queued since our last injection
+        for (int i = g.InputEventsQueue.Size - 1; i >= 0; i--) {
+            if (g.InputEventsQueue[i].EventId >= liveEventsStart) {
+                g.InputEventsQueue.erase(g.InputEventsQueue.Data + i);
+            }
+        }
+
+        const auto &frame = frames.at(frameIdx++);
+        for (const auto &event : frame.at("events")) {
+            injectEvent(io, event);
+        }
+        liveEventsStart = g.InputEventsNextEventId;
+
+        io.DeltaTime = frame.at("dt").get<float>();
+        io.DisplaySize = displaySize;
+        return true;
+    }
+
+private:
+    nlohmann::json recording;
+    unsigned int seed = 0;
+    ImVec2 displaySize;
+
+    size_t frameIdx = 0;
+    ImU32 liveEventsStart = 0;
+};
+
+std::shared_ptr<InputRecorder> createInputRecorder(const std::string& path, unsigned int seed, const ImVec2& displaySize)
+{
+    return std::make_shared<InputRecorderImpl>(path, seed, displaySize);
+}
+
+std::shared_ptr<InputPlayer> createInputPlayer(const std::string& path)
+{
+    try {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            LOG_ERROR("Cannot open recording: %s", path.c_str());
+            return nullptr;
+        }
+
+        nlohmann::json recording;
+        file >> recording;
+        if (recording.value("version", 0) != recordingVersion) {
+            LOG_ERROR("Unsupported recording version in %s", path.c_str());
+            return nullptr;
+        }
+        const auto &frames = recording.at("frames");
+        if (!frames.is_array()) {
+            LOG_ERROR("Recording %s has no frame list", path.c_str());
+            return nullptr;
+        }
+        for (size_t i = 0; i < frames.size(); i++) {
+            if (!isValidFrame(frames[i])) {
+                LOG_ERROR("Recording %s has a malformed frame %zu", path.c_str(), i);
+                return nullptr;
+            }
+        }
+        return std::make_shared<InputPlayerImpl>(std::move(recording));
+    } catch (const std::exception& e) {
+        LOG_ERROR("Error loading recording: %s", e.what());
+    }
+    return nullptr;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <imgui.h>
+#include <memory>
+#include <string>
+
+// Records the ImGui input event stream (with per-frame delta time) so a session can be replayed exactly
+class InputRecorder {
+public:
+    // Call after the platform backend's NewFrame and before ImGui::NewFrame
+    virtual void captureFrame() = 0;
+    virtual bool save() = 0;
+
+    virtual ~InputRecorder() = default;
+};
+
+std::shared_ptr<InputRecorder> createInputRecorder(const std::string& path, unsigned int seed, const ImVec2& displaySize);
+
+// Feeds a recording back through ImGui IO in place of live input
+class InputPlayer {
+public:
+    virtual unsigned int getSeed() const = 0;
+    virtual ImVec2 getDisplaySize() const = 0;
+    virtual int getFrameCount() const = 0;
+
+    // Call after the platform backend's NewFrame and before ImGui::NewFrame.
+    // Returns false once every recorded frame has been played.
+    virtual bool injectFrame() = 0;
+
+    virtual ~InputPlayer() = default;
+};
+
+std::shared_ptr<InputPlayer> createInputPlayer(const std::string& path);
@@ -0,0 +1,63 @@
+#include "LatencyProbe.h"
+
+#include "Profiling/FrameProfiler.h"
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <optional>
+
+class LatencyProbeImpl : public LatencyProbe
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit LatencyProbeImpl(GLFWwindow* window) : window(window)
+    {
+        glfwSetWindowUserPointer(window, this);
+        glfwSetCursorPosCallback(window, [](GLFWwindow* w, double, double) { inputArrived(w); });
+        glfwSetMouseButtonCallback(window, [](GLFWwindow* w, int, int, int) { inputArrived(w); });
+        glfwSetScrollCallback(window, [](GLFWwindow* w, double, double) { inputArrived(w); });
+        glfwSetKeyCallback(window, [](GLFWwindow* w, int, int, int, int) { inputArrived(w); });
+    }
+
+    ~LatencyProbeImpl() override
+    {
+        glfwSetWindowUserPointer(window, nullptr);
+    }
+
+    void latchFrame() final
+    {
+        latched = pending;
+        pending.reset();
+    }
+
+    void frameSwapped(FrameProfiler& frameProfiler) final
+    {
+        if (latched) {
+            frameProfiler.addInputLatency(std::chrono::duration<double, std::milli>(Clock::now() - *latched).count());
+            latched.reset();
+        }
+    }
+
+private:
+    // ImGui's backend keeps chaining to these callbacks, which may outlive the probe
+    static void inputArrived(GLFWwindow* window)
+    {
+        auto* probe = static_cast<LatencyProbeImpl*>(glfwGetWindowUserPointer(window));
+        if (probe && !probe->pending) {
+            probe->pending = Clock::now();
+        }
+    }
+
+    GLFWwindow* window;
+    // Oldest event not yet seen by a frame, and the oldest event of the frame waiting for its swap
+    std::optional<Clock::time_point> pending;
+    std::optional<Clock::time_point> latched;
+};
+
+std::shared_ptr<LatencyProbe> createLatencyProbe(GLFWwindow* window)
+{
+    return std::make_shared<LatencyProbeImpl>(window);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <memory>
+
+class FrameProfiler;
+struct GLFWwindow;
+
+// Input-to-swap latency: mouse, scroll and key events are timestamped as GLFW delivers them, and
+// the swap of the first frame built after them closes the sample. A frame's sample is taken from
+// its oldest event. GLFW only delivers events while the app polls or waits for them, and the time
+// before that isn't visible to it. The frame pacer waits for events rather than sleeping, so with
+// pacing an event is stamped as it arrives, unless it lands while a frame is being built or
+// swapped. Without pacing, events are only polled at the start of a frame, so the samples leave out
+// however long the event sat in the OS queue during the previous frame's build and swap.
+class LatencyProbe {
+public:
+    // Call after polling events, the frame about to be built is the first to reflect them
+    virtual void latchFrame() = 0;
+    // Call once the frame has been swapped, adds its sample (if it had input) to the profiler
+    virtual void frameSwapped(FrameProfiler& frameProfiler) = 0;
+
+    virtual ~LatencyProbe() = default;
+};
+
+// Installs GLFW input callbacks, so create it before ImGui's GLFW backend, which chains to them
+std::shared_ptr<LatencyProbe> createLatencyProbe(GLFWwindow* window);
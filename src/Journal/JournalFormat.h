@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// On-disk layout of the refinement journal, shared by the app and tools/JournalSummary.cpp.
+//
+// A journal is a series of files <prefix>.<index>.lmj, index counting up from 1 as files rotate.
+// Each file is a 32 byte header followed by 32 byte records, everything little-endian:
+//
+//   header   u32 magic "LMJ1", u16 version, u16 record size, u32 seed, u32 grid size,
+//            u64 creation time (microseconds since the epoch), u32 file index, u32 reserved
+//   record   u8 type, u8 bin (0-based), u8 flags, u8 viewport, u32 group id,
+//            u64 time (microseconds since the epoch), u32 numbers in the group,
+//            u32 bin counter after the event, u32 sequence, u32 FNV-1a of the first 28 bytes
+//
+// Sequence numbers run on across files, so a gap means records were dropped because the writer
+// fell behind. A file cut short by a crash ends in a partial or mismatching record, where
+// reading stops.
+namespace journal
+{
+    constexpr uint32_t magic = 0x314a4d4c;  // "LMJ1"
+    constexpr uint16_t version = 1;
+    constexpr size_t headerSize = 32;
+    constexpr size_t recordSize = 32;
+
+    enum class RecordType : uint8_t
+    {
+        // Numbers start flying to the bin, bin counter is the bin's refines started
+        RefineStarted = 1,
+        // The group's last number landed, bin counter is the bin's groups refined
+        GroupRefined = 2
+    };
+
+    // The refine came from another kiosk of a shared session and counts towards its bins
+    constexpr uint8_t remoteFlag = 0x1;
+    // GroupRefined records aren't tied to a viewport
+    constexpr uint8_t noViewport = 0xff;
+
+    struct Header
+    {
+        uint32_t seed = 0;
+        uint32_t gridSize = 0;
+        uint64_t createdMicros = 0;
+        uint32_t fileIndex = 0;
+    };
+
+    struct Record
+    {
+        RecordType type = RecordType::RefineStarted;
+        uint8_t bin = 0;
+        uint8_t flags = 0;
+        uint8_t viewport = noViewport;
+        uint32_t groupId = 0;
+        uint64_t timeMicros = 0;
+        uint32_t numberCount = 0;
+        uint32_t binCount = 0;
+        // Assigned by the writer
+        uint32_t sequence = 0;
+    };
+
+    inline void put(uint8_t* out, uint64_t value, size_t bytes)
+    {
+        for (size_t i = 0; i < bytes; i++) {
+            out[i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    inline uint64_t get(const uint8_t* in, size_t bytes)
+    {
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; i++) {
+            value |= static_cast<uint64_t>(in[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    inline uint32_t checksum(const uint8_t* data, size_t size)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ data[i]) * 16777619u;
+        }
+        return hash;
+    }
+
+    inline void encodeHeader(const Header& header, uint8_t* out)
+    {
+        put(out, magic, 4);
+        put(out + 4, version, 2);
+        put(out + 6, recordSize, 2);
+        put(out + 8, header.seed, 4);
+        put(out + 12, header.gridSize, 4);
+        put(out + 16, header.createdMicros, 8);
+        put(out + 24, header.fileIndex, 4);
+        put(out + 28, 0, 4);
+    }
+
+    // False if the header isn't a journal this version can read
+    inline bool decodeHeader(const uint8_t* in, Header& header)
+    {
+        if (get(in, 4) != magic || get(in + 4, 2) != version || get(in + 6, 2) != recordSize) {
+            return false;
+        }
+        header.seed = static_cast<uint32_t>(get(in + 8, 4));
+        header.gridSize = static_cast<uint32_t>(get(in + 12, 4));
+        header.createdMicros = get(in + 16, 8);
+        header.fileIndex = static_cast<uint32_t>(get(in + 24, 4));
+        return true;
+    }
+
+    inline void encodeRecord(const Record& record, uint8_t* out)
+    {
+        out[0] = static_cast<uint8_t>(record.type);
+        out[1] = record.bin;
+        out[2] = record.flags;
+        out[3] = record.viewport;
+        put(out + 4, record.groupId, 4);
+        put(out + 8, record.timeMicros, 8);
+        put(out + 16, record.numberCount, 4);
+        put(out + 20, record.binCount, 4);
+        put(out + 24, record.sequence, 4);
+        put(out + 28, checksum(out, 28), 4);
+    }
+
+    // False for a torn or corrupt record
+    inline bool decodeRecord(const uint8_t* in, Record& record)
+    {
+        if (get(in + 28, 4) != checksum(in, 28)) {
+            return false;
+        }
+        record.type = static_cast<RecordType>(in[0]);
+        record.bin = in[1];
+        record.flags = in[2];
+        record.viewport = in[3];
+        record.groupId = static_cast<uint32_t>(get(in + 4, 4));
+        record.timeMicros = get(in + 8, 8);
+        record.numberCount = static_cast<uint32_t>(get(in + 16, 4));
+        record.binCount = static_cast<uint32_t>(get(in + 20, 4));
+        record.sequence = static_cast<uint32_t>(get(in + 24, 4));
+        return true;
+    }
+}
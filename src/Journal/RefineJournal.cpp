@@ -0,0 +1,242 @@
+#include "RefineJournal.h"
+
+#include "Log.h"
+#include "../Profiling/AllocationTracker.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    constexpr size_t queueCapacity = 4096; // Power of two
+    constexpr auto commitInterval = std::chrono::milliseconds(20);
+
+    uint64_t wallClockMicros()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+
+    std::string journalFileName(const std::string& pathPrefix, uint32_t index)
+    {
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), ".%06u.lmj", index);
+        return pathPrefix + suffix;
+    }
+
+    // Creates the file with O_EXCL so an existing journal is never overwritten, and writes its header
+    int openJournalFile(const std::string& pathPrefix, uint32_t index, uint32_t seed, uint32_t gridSize)
+    {
+        auto path = journalFileName(pathPrefix, index);
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            LOG_ERROR("Failed to create journal file %s: %s", path.c_str(), strerror(errno));
+            return -1;
+        }
+        std::array<uint8_t, journal::headerSize> header{};
+        journal::encodeHeader(journal::Header{seed, gridSize, wallClockMicros(), index}, header.data());
+        if (write(fd, header.data(), header.size()) != static_cast<ssize_t>(header.size())) {
+            LOG_ERROR("Failed to write journal header to %s: %s", path.c_str(), strerror(errno));
+            close(fd);
+            return -1;
+        }
+        LOG_INFO("Journaling refines to %s", path.c_str());
+        return fd;
+    }
+}
+
+class RefineJournalImpl : public RefineJournal
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    RefineJournalImpl(std::string pathPrefix, int fsyncIntervalMs, size_t rotateBytes, uint32_t seed, int gridSize, uint32_t firstIndex, int fd)
+        : pathPrefix(std::move(pathPrefix)), fsyncInterval(std::chrono::milliseconds(std::max(0, fsyncIntervalMs))), rotateBytes(rotateBytes),
+          seed(seed), gridSize(static_cast<uint32_t>(gridSize)), firstFileIndex(firstIndex), fileIndex(firstIndex), fd(fd)
+    {
+        batch.resize(queueCapacity * journal::recordSize);
+        lastSync = Clock::now();
+        writerThread = std::thread([this] {
+            setThreadAllocationTracking(false);
+            run();
+        });
+    }
+
+    ~RefineJournalImpl() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopping = true;
+        }
+        wakeWriter.notify_one();
+        writerThread.join();
+        if (fd >= 0) {
+            fsync(fd);
+            close(fd);
+        }
+        LOG_INFO("Journal: %llu record(s) in %u file(s), %llu fsync(s), %llu dropped", static_cast<unsigned long long>(written),
+                 fileIndex - firstFileIndex + 1, static_cast<unsigned long long>(syncs), static_cast<unsigned long long>(droppedTotal));
+    }
+
+    void record(const journal::Record& record) final
+    {
+        // Single producer: only the render thread moves the tail
+        size_t tail = queueTail.load(std::memory_order_relaxed);
+        if (tail - queueHead.load(std::memory_order_acquire) == queueCapacity) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        auto &slot = queue[tail & (queueCapacity - 1)];
+        slot = record;
+        slot.timeMicros = wallClockMicros();
+        queueTail.store(tail + 1, std::memory_order_release);
+    }
+
+private:
+    void run()
+    {
+        for (;;) {
+            bool stop;
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wakeWriter.wait_for(lock, commitInterval);
+                stop = stopping;
+            }
+            commit();
+            if (stop) {
+                return;
+            }
+        }
+    }
+
+    // Everything queued since the last commit goes out in one write
+    void commit()
+    {
+        size_t head = queueHead.load(std::memory_order_relaxed);
+        size_t tail = queueTail.load(std::memory_order_acquire);
+        size_t count = tail - head;
+
+        for (size_t i = 0; i < count; i++) {
+            auto record = queue[(head + i) & (queueCapacity - 1)];
+            record.sequence = sequence++;
+            journal::encodeRecord(record, &batch[i * journal::recordSize]);
+        }
+        queueHead.store(tail, std::memory_order_release);
+
+        // Records are only dropped while the queue is full, so after the ones it held. They still use
+        // up sequence numbers, so readers see the gap.
+        if (uint64_t droppedCount = dropped.exchange(0, std::memory_order_relaxed)) {
+            sequence += static_cast<uint32_t>(droppedCount);
+            droppedTotal += droppedCount;
+            LOG_WARNING("Journal queue was full, %llu record(s) dropped", static_cast<unsigned long long>(droppedCount));
+        }
+
+        if (fd < 0) {
+            return;
+        }
+
+        if (count > 0) {
+            if (!writeAll(batch.data(), count * journal::recordSize)) {
+                return;
+            }
+            written += count;
+            fileBytes += count * journal::recordSize;
+            unsyncedBytes = true;
+        }
+
+        if (unsyncedBytes && Clock::now() - lastSync >= fsyncInterval) {
+            fsync(fd);
+            syncs++;
+            unsyncedBytes = false;
+            lastSync = Clock::now();
+        }
+        if (fileBytes >= rotateBytes) {
+            rotate();
+        }
+    }
+
+    bool writeAll(const uint8_t* data, size_t size)
+    {
+        while (size > 0) {
+            ssize_t result = write(fd, data, size);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                LOG_ERROR("Journal write failed, journaling stopped: %s", strerror(errno));
+                close(fd);
+                fd = -1;
+                return false;
+            }
+            data += result;
+            size -= static_cast<size_t>(result);
+        }
+        return true;
+    }
+
+    void rotate()
+    {
+        fsync(fd);
+        syncs++;
+        close(fd);
+        fileIndex++;
+        fd = openJournalFile(pathPrefix, fileIndex, seed, gridSize);
+        fileBytes = journal::headerSize;
+        unsyncedBytes = false;
+        lastSync = Clock::now();
+    }
+
+    std::string pathPrefix;
+    std::chrono::milliseconds fsyncInterval;
+    size_t rotateBytes;
+    uint32_t seed;
+    uint32_t gridSize;
+
+    std::array<journal::Record, queueCapacity> queue{};
+    std::atomic<size_t> queueHead{0};
+    std::atomic<size_t> queueTail{0};
+    std::atomic<uint64_t> dropped{0};
+
+    // Writer thread state
+    uint32_t firstFileIndex;
+    uint32_t fileIndex;
+    int fd;
+    std::vector<uint8_t> batch;
+    uint32_t sequence = 0;
+    size_t fileBytes = journal::headerSize;
+    bool unsyncedBytes = false;
+    Clock::time_point lastSync;
+    uint64_t written = 0;
+    uint64_t syncs = 0;
+    uint64_t droppedTotal = 0;
+
+    std::thread writerThread;
+    std::mutex wakeMutex;
+    std::condition_variable wakeWriter;
+    bool stopping = false;
+};
+
+std::shared_ptr<RefineJournal> createRefineJournal(const std::string& pathPrefix, int fsyncIntervalMs, size_t rotateBytes,
+                                                   uint32_t seed, int gridSize)
+{
+    // Carry on after the last file of an earlier run
+    uint32_t index = 1;
+    while (access(journalFileName(pathPrefix, index).c_str(), F_OK) == 0) {
+        index++;
+    }
+    int fd = openJournalFile(pathPrefix, index, seed, static_cast<uint32_t>(gridSize));
+    if (fd < 0) {
+        return nullptr;
+    }
+    return std::make_shared<RefineJournalImpl>(pathPrefix, fsyncIntervalMs, rotateBytes, seed, gridSize, index, fd);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "JournalFormat.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Append-only record of refinement activity for offline analysis (tools/JournalSummary.cpp).
+// The render thread only pushes fixed-size records into a bounded single-producer queue; a writer
+// thread drains it every commit interval into one write() per batch, fsyncs at most once per sync
+// interval, and starts a new file once the current one passes the rotation size.
+class RefineJournal {
+public:
+    // Render thread only, stamps the record with the wall clock. Never blocks or allocates: if the
+    // writer has fallen behind and the queue is full, the record is dropped and shows up as a gap in
+    // the sequence numbers.
+    virtual void record(const journal::Record& record) = 0;
+
+    virtual ~RefineJournal() = default;
+};
+
+// Files are named <pathPrefix>.<index>.lmj, continuing after the highest index already there.
+// An fsync interval of 0 syncs every batch. Returns nullptr if the first file can't be created.
+std::shared_ptr<RefineJournal> createRefineJournal(const std::string& pathPrefix, int fsyncIntervalMs, size_t rotateBytes,
+                                                   uint32_t seed, int gridSize);
@@ -0,0 +1,223 @@
+#pragma once
+
+#include "Log.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct LaunchOptions
+{
+    bool fullscreen = false;
+
+    // Seed for all gameplay randomness, replays override it with the recorded seed
+    unsigned int seed = std::random_device{}();
+    bool seedSet = false;
+
+    std::optional<std::string> recordPath;
+    std::optional<std::string> replayPath;
+    std::optional<std::string> frameTimesPath;
+
+    // Cells per side of the number grid. Replays only match when run with the size they were recorded at.
+    int gridSize = 100;
+
+    // Grid content from a dataset file made with lumon_dataset instead of the generator, its size replaces gridSize
+    std::optional<std::string> datasetPath;
+
+    // Split screen viewports onto the one grid, for several operators at one display (1-4)
+    int viewports = 1;
+
+    // Threads used to build the number grid each frame, including the main thread
+    int gridThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+    // Submit through the fenced ring of streaming buffers instead of the stock OpenGL3 backend
+    bool streamingRenderer = false;
+    int framesInFlight = 3;
+
+    // Offscreen rendering through EGL, without a window or X display
+    bool headless = false;
+    int headlessFrames = 600;
+    int headlessWidth = 1920;
+    int headlessHeight = 1080;
+    std::string cameraPath = "sweep";
+    std::vector<int> captureFrames;
+    std::string captureDir = ".";
+
+    // Prometheus metrics endpoint, "unix:/path/to.sock" or a localhost port ("9464" or "127.0.0.1:9464")
+    std::optional<std::string> metricsAddress;
+
+    // Unix socket accepting scripted pan/zoom/hover/refine commands
+    std::optional<std::string> controlSocket;
+
+    // Shared session with other kiosks: the UDP "[host:]port" to listen on, and the "host:port" of each
+    // peer (or a subnet broadcast address). Every kiosk needs the same --seed and --grid-size.
+    std::optional<std::string> syncAddress;
+    std::vector<std::string> syncPeers;
+
+    // Binary journal of refines, written as <prefix>.<index>.lmj and read back with lumon_journal
+    std::optional<std::string> journalPath;
+    int journalFsyncMs = 1000;
+    int journalRotateMb = 64;
+
+    // Fail the run if any frame after this many warm-up frames allocates on the heap
+    std::optional<int> allocCheckWarmupFrames;
+
+    // Starting size of the per-frame scratch arena, see scratch_bytes in the profiler output for sizing
+    size_t scratchArenaBytes = 256 * 1024;
+
+    // Sample cycles, instructions and cache/branch misses per frame stage with perf_event_open
+    bool perfCounters = false;
+
+    // Start frames just before the refresh deadline so input is read as late as possible
+    bool lowLatency = false;
+    // 0 turns vsync off and leaves pacing to the app, which implies lowLatency
+    int swapInterval = 1;
+    // Overrides the monitor's refresh rate for pacing
+    std::optional<double> refreshRate;
+};
+
+inline LaunchOptions parseLaunchOptions(int argc, char** argv)
+{
+    LaunchOptions options;
+
+    auto nextArg = [&](int &i) -> std::optional<std::string> {
+        if (i + 1 < argc) {
+            return std::string(argv[++i]);
+        }
+        LOG_WARNING("Missing value for argument: %s", argv[i]);
+        return std::nullopt;
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--full-screen") == 0) {
+            options.fullscreen = true;
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            if (auto value = nextArg(i)) {
+                options.seed = static_cast<unsigned int>(std::strtoul(value->c_str(), nullptr, 10));
+                options.seedSet = true;
+            }
+        } else if (strcmp(argv[i], "--record") == 0) {
+            options.recordPath = nextArg(i);
+        } else if (strcmp(argv[i], "--replay") == 0) {
+            options.replayPath = nextArg(i);
+        } else if (strcmp(argv[i], "--frame-times") == 0) {
+            options.frameTimesPath = nextArg(i);
+        } else if (strcmp(argv[i], "--grid-size") == 0) {
+            if (auto value = nextArg(i)) {
+                options.gridSize = std::max(10, std::atoi(value->c_str()));
+            }
+        } else if (strcmp(argv[i], "--dataset") == 0) {
+            options.datasetPath = nextArg(i);
+        } else if (strcmp(argv[i], "--viewports") == 0) {
+            if (auto value = nextArg(i)) {
+                options.viewports = std::clamp(std::atoi(value->c_str()), 1, 4);
+            }
+        } else if (strcmp(argv[i], "--grid-threads") == 0) {
+            if (auto value = nextArg(i)) {
+                options.gridThreads = std::max(1, std::atoi(value->c_str()));
+            }
+        } else if (strcmp(argv[i], "--streaming-renderer") == 0) {
+            options.streamingRenderer = true;
+        } else if (strcmp(argv[i], "--perf-counters") == 0) {
+            options.perfCounters = true;
+        } else if (strcmp(argv[i], "--low-latency") == 0) {
+            options.lowLatency = true;
+        } else if (strcmp(argv[i], "--swap-interval") == 0) {
+            if (auto value = nextArg(i)) {
+                options.swapInterval = std::clamp(std::atoi(value->c_str()), 0, 1);
+            }
+        } else if (strcmp(argv[i], "--refresh-rate") == 0) {
+            if (auto value = nextArg(i)) {
+                double rate = std::atof(value->c_str());
+                if (rate > 0.0) {
+                    options.refreshRate = rate;
+                } else {
+                    LOG_WARNING("Invalid refresh rate: %s", value->c_str());
+                }
+            }
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            options.headless = true;
+        } else if (strcmp(argv[i], "--frames") == 0) {
+            if (auto value = nextArg(i)) {
+                options.headlessFrames = std::max(1, std::atoi(value->c_str()));
+            }
+        } else if (strcmp(argv[i], "--resolution") == 0) {
+            if (auto value = nextArg(i)) {
+                if (sscanf(value->c_str(), "%dx%d", &options.headlessWidth, &options.headlessHeight) != 2 || options.headlessWidth <= 0 || options.headlessHeight <= 0) {
+                    LOG_WARNING("Invalid resolution, expected WIDTHxHEIGHT: %s", value->c_str());
+                    options.headlessWidth = 1920;
+                    options.headlessHeight = 1080;
+                }
+            }
+        } else if (strcmp(argv[i], "--camera") == 0) {
+            if (auto value = nextArg(i)) {
+                options.cameraPath = *value;
+            }
+        } else if (strcmp(argv[i], "--capture") == 0) {
+            if (auto value = nextArg(i)) {
+                // Comma separated frame indices
+                std::stringstream list(*value);
+                std::string item;
+                while (std::getline(list, item, ',')) {
+                    if (!item.empty()) {
+                        options.captureFrames.push_back(std::atoi(item.c_str()));
+                    }
+                }
+            }
+        } else if (strcmp(argv[i], "--capture-dir") == 0) {
+            if (auto value = nextArg(i)) {
+                options.captureDir = *value;
+            }
+        } else if (strcmp(argv[i], "--metrics") == 0) {
+            options.metricsAddress = nextArg(i);
+        } else if (strcmp(argv[i], "--control") == 0) {
+            options.controlSocket = nextArg(i);
+        } else if (strcmp(argv[i], "--sync") == 0) {
+            options.syncAddress = nextArg(i);
+        } else if (strcmp(argv[i], "--sync-peers") == 0) {
+            if (auto value = nextArg(i)) {
+                // Comma separated host:port list
+                std::stringstream list(*value);
+                std::string item;
+                while (std::getline(list, item, ',')) {
+                    if (!item.empty()) {
+                        options.syncPeers.push_back(item);
+                    }
+                }
+            }
+        } else if (strcmp(argv[i], "--journal") == 0) {
+            options.journalPath = nextArg(i);
+        } else if (strcmp(argv[i], "--journal-fsync-ms") == 0) {
+            if (auto value = nextArg(i)) {
+                options.journalFsyncMs = std::max(0, std::atoi(value->c_str()));
+            }
+        } else if (strcmp(argv[i], "--journal-rotate-mb") == 0) {
+            if (auto value = nextArg(i)) {
+                options.journalRotateMb = std::max(1, std::atoi(value->c_str()));
+            }
+        } else if (strcmp(argv[i], "--alloc-check") == 0) {
+            if (auto value = nextArg(i)) {
+                options.allocCheckWarmupFrames = std::max(0, std::atoi(value->c_str()));
+            }
+        } else if (strcmp(argv[i], "--scratch-kb") == 0) {
+            if (auto value = nextArg(i)) {
+                options.scratchArenaBytes = static_cast<size_t>(std::max(4, std::atoi(value->c_str()))) * 1024;
+            }
+        } else if (strcmp(argv[i], "--frames-in-flight") == 0) {
+            if (auto value = nextArg(i)) {
+                options.framesInFlight = std::clamp(std::atoi(value->c_str()), 1, 3);
+            }
+        } else {
+            LOG_WARNING("Unknown argument: %s", argv[i]);
+        }
+    }
+
+    return options;
+}
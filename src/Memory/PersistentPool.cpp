@@ -0,0 +1,135 @@
+#include "PersistentPool.h"
+
+#include "imgui.h"
+
+#include <array>
+#include <new>
+#include <vector>
+
+class PersistentPoolImpl : public PersistentPool
+{
+public:
+    ~PersistentPoolImpl() override
+    {
+        for (void* slab : slabs) {
+            ::operator delete(slab);
+        }
+    }
+
+    void* allocate(size_t size) final
+    {
+        size_t sizeClass = getSizeClass(size);
+        if (sizeClass == classCount) {
+            // Too big to be worth keeping around, straight from the heap
+            auto* header = static_cast<Header*>(::operator new(headerSize + size));
+            header->sizeClass = classCount;
+            header->size = size;
+            reservedBytes += headerSize + size;
+            liveBytes += size;
+            return reinterpret_cast<std::byte*>(header) + headerSize;
+        }
+
+        auto* header = freeLists[sizeClass];
+        if (header) {
+            freeLists[sizeClass] = header->next;
+        } else {
+            header = carve(sizeClass);
+        }
+        header->sizeClass = sizeClass;
+        liveBytes += classSize(sizeClass);
+        return reinterpret_cast<std::byte*>(header) + headerSize;
+    }
+
+    void free(void* ptr) final
+    {
+        if (!ptr) {
+            return;
+        }
+        auto* header = reinterpret_cast<Header*>(static_cast<std::byte*>(ptr) - headerSize);
+        if (header->sizeClass == classCount) {
+            reservedBytes -= headerSize + header->size;
+            liveBytes -= header->size;
+            ::operator delete(header);
+            return;
+        }
+
+        size_t sizeClass = header->sizeClass;
+        liveBytes -= classSize(sizeClass);
+        header->next = freeLists[sizeClass];
+        freeLists[sizeClass] = header;
+    }
+
+    size_t getReservedBytes() const final
+    {
+        return reservedBytes;
+    }
+
+    size_t getLiveBytes() const final
+    {
+        return liveBytes;
+    }
+
+private:
+    // Sits in front of every block, keeping the payload aligned like operator new would
+    struct alignas(alignof(std::max_align_t)) Header
+    {
+        size_t sizeClass;
+        union {
+            size_t size;   // large blocks
+            Header* next;  // pooled blocks on a free list
+        };
+    };
+
+    static constexpr size_t headerSize = sizeof(Header);
+    static constexpr size_t minClassSize = 16;
+    // 16 bytes up to 16 KB in powers of two, larger blocks bypass the pool
+    static constexpr size_t classCount = 11;
+    static constexpr size_t slabSize = 64 * 1024;
+
+    static size_t classSize(size_t sizeClass)
+    {
+        return minClassSize << sizeClass;
+    }
+
+    static size_t getSizeClass(size_t size)
+    {
+        size_t sizeClass = 0;
+        while (sizeClass < classCount && classSize(sizeClass) < size) {
+            sizeClass++;
+        }
+        return sizeClass;
+    }
+
+    // Blocks are cut from the current slab on demand, a new slab is taken when it runs out
+    Header* carve(size_t sizeClass)
+    {
+        size_t blockSize = headerSize + classSize(sizeClass);
+        if (slabOffset + blockSize > slabSize || slabs.empty()) {
+            slabs.push_back(::operator new(slabSize));
+            reservedBytes += slabSize;
+            slabOffset = 0;
+        }
+        auto* header = reinterpret_cast<Header*>(static_cast<std::byte*>(slabs.back()) + slabOffset);
+        slabOffset += blockSize;
+        return header;
+    }
+
+    std::array<Header*, classCount> freeLists{};
+    std::vector<void*> slabs;
+    size_t slabOffset = 0;
+    size_t reservedBytes = 0;
+    size_t liveBytes = 0;
+};
+
+std::shared_ptr<PersistentPool> createPersistentPool()
+{
+    return std::make_shared<PersistentPoolImpl>();
+}
+
+void installImGuiPool(PersistentPool& pool)
+{
+    ImGui::SetAllocatorFunctions(
+        [](size_t size, void* userData) { return static_cast<PersistentPool*>(userData)->allocate(size); },
+        [](void* ptr, void* userData) { static_cast<PersistentPool*>(userData)->free(ptr); },
+        &pool);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+// Size-class free lists for long-lived allocations that come and go in steady sizes, like ImGui's
+// window, draw list and font buffers. Freed blocks are kept for reuse rather than returned to the
+// heap, so ImGui reaches a steady state after the first frames of each screen. Render thread only.
+class PersistentPool {
+public:
+    virtual void* allocate(size_t size) = 0;
+    virtual void free(void* ptr) = 0;
+
+    // Heap memory held by the pool, in use or waiting on a free list
+    virtual size_t getReservedBytes() const = 0;
+    // Bytes currently handed out, rounded up to their size class
+    virtual size_t getLiveBytes() const = 0;
+
+    virtual ~PersistentPool() = default;
+};
+
+std::shared_ptr<PersistentPool> createPersistentPool();
+
+// Serves every ImGui allocation from the pool, must be called before ImGui::CreateContext and the
+// pool kept alive until after ImGui::DestroyContext
+void installImGuiPool(PersistentPool& pool);
@@ -0,0 +1,92 @@
+#include "ScratchArena.h"
+
+#include <algorithm>
+#include <vector>
+
+class ScratchArenaImpl : public ScratchArena
+{
+public:
+    explicit ScratchArenaImpl(size_t initialCapacity)
+    {
+        blocks.push_back(makeBlock(std::max(initialCapacity, minBlockSize)));
+    }
+
+    void* allocate(size_t size, size_t alignment) final
+    {
+        Block* block = &blocks.back();
+        size_t start = alignUp(block->offset, alignment);
+        if (start + size > block->size) {
+            // Spill into a new block, at least as big as everything so far so spills stay rare
+            blocks.push_back(makeBlock(std::max(size + alignment, getCapacityBytes())));
+            block = &blocks.back();
+            start = alignUp(block->offset, alignment);
+        }
+
+        usedBytes += start - block->offset + size;
+        block->offset = start + size;
+        return block->data.get() + start;
+    }
+
+    void reset() final
+    {
+        highWaterBytes = std::max(highWaterBytes, usedBytes);
+        usedBytes = 0;
+
+        if (blocks.size() > 1) {
+            size_t capacity = getCapacityBytes();
+            blocks.clear();
+            blocks.push_back(makeBlock(capacity));
+        }
+        blocks.back().offset = 0;
+    }
+
+    size_t getUsedBytes() const final
+    {
+        return usedBytes;
+    }
+
+    size_t getHighWaterBytes() const final
+    {
+        return std::max(highWaterBytes, usedBytes);
+    }
+
+    size_t getCapacityBytes() const final
+    {
+        size_t capacity = 0;
+        for (const auto &block : blocks) {
+            capacity += block.size;
+        }
+        return capacity;
+    }
+
+private:
+    struct Block
+    {
+        std::unique_ptr<std::byte[]> data;
+        size_t size = 0;
+        size_t offset = 0;
+    };
+
+    static Block makeBlock(size_t size)
+    {
+        // Aligned for anything operator new would hand out, offsets are aligned from there
+        return Block{std::unique_ptr<std::byte[]>(new std::byte[size]), size, 0};
+    }
+
+    // Offsets are relative to a max_align_t aligned block, so aligning the offset aligns the address
+    static size_t alignUp(size_t offset, size_t alignment)
+    {
+        return (offset + alignment - 1) & ~(alignment - 1);
+    }
+
+    static constexpr size_t minBlockSize = 4096;
+
+    std::vector<Block> blocks;
+    size_t usedBytes = 0;
+    size_t highWaterBytes = 0;
+};
+
+std::shared_ptr<ScratchArena> createScratchArena(size_t initialCapacity)
+{
+    return std::make_shared<ScratchArenaImpl>(initialCapacity);
+}
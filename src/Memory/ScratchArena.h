@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+// Bump allocator for temporaries that only live until the end of the frame. Reset right before
+// ImGui::NewFrame, so everything handed out is invalid once the next frame starts.
+// Allocation is render thread only, workers may fill memory handed out before they start.
+class ScratchArena {
+public:
+    virtual void* allocate(size_t size, size_t alignment) = 0;
+
+    // Uninitialised storage, so only for types that don't need destroying
+    template <typename T>
+    T* allocateArray(size_t count)
+    {
+        static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>, "Scratch memory is never destroyed");
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // Frees everything at once. A frame that spilled into extra blocks leaves one block big enough
+    // for all of it, so the next frame like it doesn't touch the heap.
+    virtual void reset() = 0;
+
+    // Bytes handed out since the last reset, including alignment padding
+    virtual size_t getUsedBytes() const = 0;
+    // Most bytes used by any frame so far
+    virtual size_t getHighWaterBytes() const = 0;
+    virtual size_t getCapacityBytes() const = 0;
+
+    virtual ~ScratchArena() = default;
+};
+
+std::shared_ptr<ScratchArena> createScratchArena(size_t initialCapacity);
@@ -0,0 +1,97 @@
+#include "AllocationTracker.h"
+
+#include "FrameProfiler.h"
+#include "Log.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    std::atomic<uint64_t> allocationCount{0};
+    std::atomic<uint64_t> allocationBytes{0};
+    thread_local bool threadTracked = true;
+
+    void recordAllocation(size_t size)
+    {
+        if (threadTracked) {
+            allocationCount.fetch_add(1, std::memory_order_relaxed);
+            allocationBytes.fetch_add(size, std::memory_order_relaxed);
+        }
+    }
+
+    void* allocate(size_t size)
+    {
+        recordAllocation(size);
+        if (void* p = std::malloc(size ? size : 1)) {
+            return p;
+        }
+        throw std::bad_alloc();
+    }
+
+    void* allocateAligned(size_t size, std::align_val_t alignment)
+    {
+        recordAllocation(size);
+        // aligned_alloc wants the size to be a multiple of the alignment
+        size_t align = static_cast<size_t>(alignment);
+        if (void* p = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+            return p;
+        }
+        throw std::bad_alloc();
+    }
+}
+
+// Every operator new form ends up in allocate(), so frames can be checked for heap traffic
+void* operator new(size_t size) { return allocate(size); }
+void* operator new[](size_t size) { return allocate(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+    try { return allocate(size); } catch (...) { return nullptr; }
+}
+void* operator new(size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment); }
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { std::free(ptr); }
+
+AllocationStats getAllocationStats()
+{
+    return AllocationStats{allocationCount.load(std::memory_order_relaxed), allocationBytes.load(std::memory_order_relaxed)};
+}
+
+void setThreadAllocationTracking(bool enabled)
+{
+    threadTracked = enabled;
+}
+
+
+void AllocationCheck::checkFrame(const FrameProfiler& frameProfiler)
+{
+    int currentFrame = frame++;
+    double allocations = frameProfiler.getLastCounter(FrameCounter::Allocations);
+    if (currentFrame < warmupFrames || allocations == 0.0) {
+        return;
+    }
+
+    failedFrames++;
+    LOG_ERROR("Frame %d allocated %.0f times (%.0f bytes) after warm-up", currentFrame, allocations, frameProfiler.getLastCounter(FrameCounter::AllocatedBytes));
+    for (size_t s = 0; s < static_cast<size_t>(FrameStage::Count); s++) {
+        auto stage = static_cast<FrameStage>(s);
+        if (double stageAllocations = frameProfiler.getLastStageAllocations(stage)) {
+            LOG_ERROR("  %s: %.0f allocations", frameStageName(stage), stageAllocations);
+        }
+    }
+}
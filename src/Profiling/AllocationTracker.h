@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+class FrameProfiler;
+
+// Heap allocations made through operator new (replaced globally, ImGui's pool takes its slabs from it too) since start
+struct AllocationStats
+{
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+};
+
+AllocationStats getAllocationStats();
+
+// Background service threads (metrics, control) opt out so they don't show up in frame counts
+void setThreadAllocationTracking(bool enabled);
+
+// Flags every frame that allocates once warm-up is over, so steady state stays allocation free
+class AllocationCheck
+{
+public:
+    explicit AllocationCheck(int warmupFrames) : warmupFrames(warmupFrames) {}
+
+    // Call after the profiler has ended the frame
+    void checkFrame(const FrameProfiler& frameProfiler);
+
+    bool passed() const { return failedFrames == 0; }
+    int getFailedFrames() const { return failedFrames; }
+
+private:
+    int warmupFrames;
+    int frame = 0;
+    int failedFrames = 0;
+};
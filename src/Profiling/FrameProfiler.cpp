@@ -0,0 +1,371 @@
+#include "FrameProfiler.h"
+
+#include "AllocationTracker.h"
+#include "PerfCounters.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+const char* frameStageName(FrameStage stage)
+{
+    switch (stage) {
+        case FrameStage::Update: return "update";
+        case FrameStage::Draw: return "draw";
+        case FrameStage::GridDraw: return "grid_draw";
+        case FrameStage::Overlays: return "overlays";
+        case FrameStage::Render: return "render";
+        case FrameStage::Submit: return "submit";
+        case FrameStage::BufferWait: return "buffer_wait";
+        default: return "unknown";
+    }
+}
+
+const char* frameCounterName(FrameCounter counter)
+{
+    switch (counter) {
+        case FrameCounter::UploadBytes: return "upload_bytes";
+        case FrameCounter::DrawCalls: return "draw_calls";
+        case FrameCounter::Vertices: return "vertices";
+        case FrameCounter::Allocations: return "allocations";
+        case FrameCounter::AllocatedBytes: return "allocated_bytes";
+        case FrameCounter::ScratchBytes: return "scratch_bytes";
+        case FrameCounter::ImGuiPoolBytes: return "imgui_pool_bytes";
+        case FrameCounter::VisibleCells: return "visible_cells";
+        case FrameCounter::GpuGridTime: return "gpu_grid_ms";
+        case FrameCounter::GpuOverlaysTime: return "gpu_overlays_ms";
+        case FrameCounter::GpuSubmitTime: return "gpu_submit_ms";
+        case FrameCounter::SyncBytesSent: return "sync_bytes_sent";
+        case FrameCounter::SyncBytesReceived: return "sync_bytes_received";
+        default: return "unknown";
+    }
+}
+
+class FrameProfilerImpl : public FrameProfiler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t stageCount = static_cast<size_t>(FrameStage::Count);
+    static constexpr size_t counterCount = static_cast<size_t>(FrameCounter::Count);
+
+    struct FrameTiming
+    {
+        double frameTime = 0.0;
+        std::array<double, stageCount> stageTimes{};
+        std::array<double, stageCount> stageAllocations{};
+        std::array<double, counterCount> counters{};
+        std::optional<double> inputLatency;
+    };
+
+    static constexpr size_t hardwareCounterCount = static_cast<size_t>(HardwareCounter::Count);
+
+    // Event deltas, kept apart from FrameTiming so runs without perf counters don't pay for them
+    struct FrameHardware
+    {
+        HardwareCounts frame;
+        std::array<HardwareCounts, stageCount> stages{};
+    };
+
+    FrameProfilerImpl(std::shared_ptr<PerfCounters> perfCounters, size_t historyFrames)
+        : keepHistory(historyFrames > 0), perfCounters(std::move(perfCounters))
+    {
+        frames.reserve(historyFrames);
+        if (this->perfCounters) {
+            hardwareFrames.reserve(historyFrames);
+        }
+    }
+
+    void beginFrame() final
+    {
+        // Grown before the frame's allocations are sampled so the allocation check sees it
+        if (keepHistory && frames.size() == frames.capacity()) {
+            frames.reserve(frames.capacity() * 2);
+            if (perfCounters) {
+                hardwareFrames.reserve(hardwareFrames.capacity() * 2);
+            }
+        }
+
+        frameStart = Clock::now();
+        frameStartAllocations = getAllocationStats();
+        current = FrameTiming{};
+        if (perfCounters) {
+            currentHardware = FrameHardware{};
+            perfCounters->read(frameStartHardware);
+        }
+    }
+
+    void endFrame() final
+    {
+        current.frameTime = millisecondsSince(frameStart);
+        auto allocations = getAllocationStats();
+        current.counters[static_cast<size_t>(FrameCounter::Allocations)] += static_cast<double>(allocations.count - frameStartAllocations.count);
+        current.counters[static_cast<size_t>(FrameCounter::AllocatedBytes)] += static_cast<double>(allocations.bytes - frameStartAllocations.bytes);
+        last = current;
+        if (keepHistory) {
+            frames.push_back(current);
+        }
+
+        if (perfCounters) {
+            addHardwareSince(frameStartHardware, currentHardware.frame);
+            if (keepHistory) {
+                hardwareFrames.push_back(currentHardware);
+            }
+        }
+    }
+
+    void beginStage(FrameStage stage) final
+    {
+        stageStarts[index(stage)] = Clock::now();
+        stageStartAllocations[index(stage)] = getAllocationStats().count;
+        if (perfCounters) {
+            perfCounters->read(stageStartHardware[index(stage)]);
+        }
+    }
+
+    void endStage(FrameStage stage) final
+    {
+        current.stageTimes[index(stage)] += millisecondsSince(stageStarts[index(stage)]);
+        current.stageAllocations[index(stage)] += static_cast<double>(getAllocationStats().count - stageStartAllocations[index(stage)]);
+        if (perfCounters) {
+            addHardwareSince(stageStartHardware[index(stage)], currentHardware.stages[index(stage)]);
+        }
+    }
+
+    void addCounter(FrameCounter counter, double value) final
+    {
+        current.counters[static_cast<size_t>(counter)] += value;
+    }
+
+    void addInputLatency(double milliseconds) final
+    {
+        last.inputLatency = milliseconds;
+        if (!frames.empty()) {
+            frames.back().inputLatency = milliseconds;
+        }
+    }
+
+    double getLastStageTime(FrameStage stage) const final
+    {
+        return last.stageTimes[index(stage)];
+    }
+
+    double getLastFrameTime() const final
+    {
+        return last.frameTime;
+    }
+
+    double getLastCounter(FrameCounter counter) const final
+    {
+        return last.counters[static_cast<size_t>(counter)];
+    }
+
+    double getLastStageAllocations(FrameStage stage) const final
+    {
+        return last.stageAllocations[index(stage)];
+    }
+
+    bool writeFrameTimes(const std::string& csvPath) const final
+    {
+        std::ofstream file(csvPath);
+        if (!file.is_open()) {
+            LOG_ERROR("Cannot open frame times file for writing: %s", csvPath.c_str());
+            return false;
+        }
+
+        file << "frame,frame_ms";
+        for (size_t s = 0; s < stageCount; s++) {
+            file << "," << frameStageName(static_cast<FrameStage>(s)) << "_ms";
+        }
+        for (size_t c = 0; c < counterCount; c++) {
+            file << "," << frameCounterName(static_cast<FrameCounter>(c));
+        }
+        for (size_t s = 0; s < stageCount; s++) {
+            file << "," << frameStageName(static_cast<FrameStage>(s)) << "_allocations";
+        }
+        file << ",input_latency_ms";
+        if (perfCounters) {
+            for (size_t h = 0; h < hardwareCounterCount; h++) {
+                file << ",frame_" << hardwareCounterName(static_cast<HardwareCounter>(h));
+            }
+            for (size_t s = 0; s < stageCount; s++) {
+                for (size_t h = 0; h < hardwareCounterCount; h++) {
+                    file << "," << frameStageName(static_cast<FrameStage>(s)) << "_" << hardwareCounterName(static_cast<HardwareCounter>(h));
+                }
+            }
+        }
+        file << "\n";
+
+        for (size_t i = 0; i < frames.size(); i++) {
+            file << i << "," << frames[i].frameTime;
+            for (double stageTime : frames[i].stageTimes) {
+                file << "," << stageTime;
+            }
+            for (double value : frames[i].counters) {
+                file << "," << value;
+            }
+            for (double allocations : frames[i].stageAllocations) {
+                file << "," << allocations;
+            }
+            // Left empty for frames without input
+            file << ",";
+            if (frames[i].inputLatency) {
+                file << *frames[i].inputLatency;
+            }
+            if (perfCounters) {
+                for (uint64_t value : hardwareFrames[i].frame.values) {
+                    file << "," << value;
+                }
+                for (const auto &stage : hardwareFrames[i].stages) {
+                    for (uint64_t value : stage.values) {
+                        file << "," << value;
+                    }
+                }
+            }
+            file << "\n";
+        }
+        return true;
+    }
+
+    void printSummary() const final
+    {
+        if (frames.empty()) {
+            return;
+        }
+
+        std::vector<double> sorted;
+        sorted.reserve(frames.size());
+        auto printSorted = [&](const char* name, const char* unit) {
+            std::sort(sorted.begin(), sorted.end());
+            double total = 0.0;
+            for (double t : sorted) {
+                total += t;
+            }
+            std::cout << "  " << name << ": avg " << total / sorted.size() << unit << ", p50 " << percentile(sorted, 0.5)
+                      << unit << ", p99 " << percentile(sorted, 0.99) << unit << ", max " << sorted.back() << unit << std::endl;
+        };
+        auto printLine = [&](const char* name, const char* unit, auto getTime) {
+            sorted.clear();
+            for (const auto &frame : frames) {
+                sorted.push_back(getTime(frame));
+            }
+            printSorted(name, unit);
+        };
+
+        std::cout << "Frame timings over " << frames.size() << " frames:" << std::endl;
+        printLine("frame", " ms", [](const FrameTiming &f) { return f.frameTime; });
+        for (size_t s = 0; s < stageCount; s++) {
+            printLine(frameStageName(static_cast<FrameStage>(s)), " ms", [s](const FrameTiming &f) { return f.stageTimes[s]; });
+        }
+        for (size_t c = 0; c < counterCount; c++) {
+            printLine(frameCounterName(static_cast<FrameCounter>(c)), "", [c](const FrameTiming &f) { return f.counters[c]; });
+        }
+
+        sorted.clear();
+        for (const auto &frame : frames) {
+            if (frame.inputLatency) {
+                sorted.push_back(*frame.inputLatency);
+            }
+        }
+        if (!sorted.empty()) {
+            std::cout << "Input to swap latency over " << sorted.size() << " frames with input:" << std::endl;
+            printSorted("input_latency", " ms");
+        }
+
+        if (perfCounters) {
+            printHardwareSummary();
+        }
+    }
+
+private:
+    void addHardwareSince(const HardwareCounts& start, HardwareCounts& total)
+    {
+        HardwareCounts now;
+        perfCounters->read(now);
+        for (size_t h = 0; h < hardwareCounterCount; h++) {
+            total.values[h] += now.values[h] - start.values[h];
+        }
+    }
+
+    // Ratios of totals over the whole run, so short frames don't skew the averages
+    void printHardwareSummary() const
+    {
+        double visibleCells = 0.0;
+        for (const auto &frame : frames) {
+            visibleCells += frame.counters[static_cast<size_t>(FrameCounter::VisibleCells)];
+        }
+
+        auto printLine = [&](const char* name, auto getCounts) {
+            HardwareCounts total;
+            for (const auto &frame : hardwareFrames) {
+                const HardwareCounts &counts = getCounts(frame);
+                for (size_t h = 0; h < hardwareCounterCount; h++) {
+                    total.values[h] += counts.values[h];
+                }
+            }
+            std::cout << "  " << name << ": ipc ";
+            printRatio(total[HardwareCounter::Instructions], static_cast<double>(total[HardwareCounter::Cycles]), HardwareCounter::Instructions);
+            for (auto counter : {HardwareCounter::L1DMisses, HardwareCounter::LLCMisses, HardwareCounter::BranchMisses}) {
+                std::cout << ", " << hardwareCounterName(counter) << "/cell ";
+                printRatio(total[counter], visibleCells, counter);
+            }
+            std::cout << std::endl;
+        };
+
+        std::cout << "Hardware counters over " << hardwareFrames.size() << " frames (render thread, user space):" << std::endl;
+        printLine("frame", [](const FrameHardware &f) -> const HardwareCounts& { return f.frame; });
+        for (size_t s = 0; s < stageCount; s++) {
+            printLine(frameStageName(static_cast<FrameStage>(s)), [s](const FrameHardware &f) -> const HardwareCounts& { return f.stages[s]; });
+        }
+    }
+
+    void printRatio(uint64_t value, double divisor, HardwareCounter counter) const
+    {
+        if (!perfCounters->isAvailable(counter) || divisor <= 0.0) {
+            std::cout << "n/a";
+        } else {
+            std::cout << static_cast<double>(value) / divisor;
+        }
+    }
+
+    static size_t index(FrameStage stage)
+    {
+        return static_cast<size_t>(stage);
+    }
+
+    static double millisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    static double percentile(const std::vector<double>& sorted, double p)
+    {
+        auto idx = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1));
+        return sorted[idx];
+    }
+
+    Clock::time_point frameStart;
+    std::array<Clock::time_point, stageCount> stageStarts{};
+    AllocationStats frameStartAllocations;
+    std::array<uint64_t, stageCount> stageStartAllocations{};
+    FrameTiming current;
+    FrameTiming last;
+    // Only runs that print a summary or write frame times keep every frame
+    bool keepHistory;
+    std::vector<FrameTiming> frames;
+
+    std::shared_ptr<PerfCounters> perfCounters;
+    HardwareCounts frameStartHardware;
+    std::array<HardwareCounts, stageCount> stageStartHardware{};
+    FrameHardware currentHardware;
+    std::vector<FrameHardware> hardwareFrames;
+};
+
+std::shared_ptr<FrameProfiler> createFrameProfiler(size_t historyFrames, std::shared_ptr<PerfCounters> perfCounters)
+{
+    return std::make_shared<FrameProfilerImpl>(std::move(perfCounters), historyFrames);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+class PerfCounters;
+
+enum class FrameStage
+{
+    Update,
+    Draw,
+    GridDraw,
+    Overlays,
+    Render,
+    Submit,
+    BufferWait,
+    Count
+};
+
+// Per-frame quantities that aren't times
+enum class FrameCounter
+{
+    UploadBytes,
+    DrawCalls,
+    Vertices,
+    Allocations,
+    AllocatedBytes,
+    ScratchBytes,
+    ImGuiPoolBytes,
+    VisibleCells,
+    // GPU milliseconds from timer queries, for the newest frame read back
+    GpuGridTime,
+    GpuOverlaysTime,
+    GpuSubmitTime,
+    // Shared session traffic of the frame's sync tick
+    SyncBytesSent,
+    SyncBytesReceived,
+    Count
+};
+
+const char* frameStageName(FrameStage stage);
+const char* frameCounterName(FrameCounter counter);
+
+class FrameProfiler {
+public:
+    virtual void beginFrame() = 0;
+    virtual void endFrame() = 0;
+
+    virtual void beginStage(FrameStage stage) = 0;
+    virtual void endStage(FrameStage stage) = 0;
+    virtual void addCounter(FrameCounter counter, double value) = 0;
+    // Milliseconds from the oldest input the last completed frame reflects to its swap, recorded
+    // once the swap has returned. Frames without input have no sample.
+    virtual void addInputLatency(double milliseconds) = 0;
+
+    // Milliseconds spent in the stage during the last completed frame
+    virtual double getLastStageTime(FrameStage stage) const = 0;
+    virtual double getLastFrameTime() const = 0;
+    virtual double getLastCounter(FrameCounter counter) const = 0;
+    // Heap allocations made while the stage was open during the last completed frame
+    virtual double getLastStageAllocations(FrameStage stage) const = 0;
+
+    virtual bool writeFrameTimes(const std::string& csvPath) const = 0;
+    virtual void printSummary() const = 0;
+
+    virtual ~FrameProfiler() = default;
+};
+
+class ProfileScope {
+public:
+    ProfileScope(FrameProfiler& profiler, FrameStage stage) : profiler(profiler), stage(stage) { profiler.beginStage(stage); }
+    ~ProfileScope() { profiler.endStage(stage); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    FrameProfiler& profiler;
+    FrameStage stage;
+};
+
+// Keeps every frame for printSummary and writeFrameTimes when historyFrames isn't 0, reserved up front
+// and doubled when a run outlasts it. Otherwise only the last frame is kept. With perf counters
+// (opened on the render thread) every stage also records hardware events.
+std::shared_ptr<FrameProfiler> createFrameProfiler(size_t historyFrames, std::shared_ptr<PerfCounters> perfCounters = nullptr);
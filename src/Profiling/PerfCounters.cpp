@@ -0,0 +1,150 @@
+#include "PerfCounters.h"
+
+#include "Log.h"
+
+#ifdef __linux__
+#include <cerrno>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char* hardwareCounterName(HardwareCounter counter)
+{
+    switch (counter) {
+        case HardwareCounter::Cycles: return "cycles";
+        case HardwareCounter::Instructions: return "instructions";
+        case HardwareCounter::L1DMisses: return "l1d_misses";
+        case HardwareCounter::LLCMisses: return "llc_misses";
+        case HardwareCounter::BranchMisses: return "branch_misses";
+        default: return "unknown";
+    }
+}
+
+#ifdef __linux__
+
+class PerfCountersImpl : public PerfCounters
+{
+public:
+    static constexpr size_t counterCount = static_cast<size_t>(HardwareCounter::Count);
+
+    PerfCountersImpl()
+    {
+        fds.fill(-1);
+    }
+
+    // Cycles lead the group, so every other event is scheduled on the PMU at the same time as it
+    bool open()
+    {
+        for (size_t c = 0; c < counterCount; c++) {
+            auto counter = static_cast<HardwareCounter>(c);
+            int fd = openEvent(counter, leaderFd);
+            if (fd < 0) {
+                if (counter == HardwareCounter::Cycles) {
+                    LOG_WARNING("Hardware counters unavailable: %s", strerror(errno));
+                    return false;
+                }
+                LOG_INFO("Hardware counter %s unavailable: %s", hardwareCounterName(counter), strerror(errno));
+                continue;
+            }
+            if (counter == HardwareCounter::Cycles) {
+                leaderFd = fd;
+            }
+            fds[c] = fd;
+            groupOrder[memberCount++] = c;
+        }
+        ioctl(leaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        return true;
+    }
+
+    ~PerfCountersImpl() override
+    {
+        for (int fd : fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+    }
+
+    void read(HardwareCounts& counts) final
+    {
+        // PERF_FORMAT_GROUP: the member count followed by one value per member, in the order they were opened
+        std::array<uint64_t, counterCount + 1> buffer{};
+        if (::read(leaderFd, buffer.data(), sizeof(buffer)) < static_cast<ssize_t>(sizeof(uint64_t) * (memberCount + 1))) {
+            return;
+        }
+        for (size_t m = 0; m < memberCount; m++) {
+            counts.values[groupOrder[m]] = buffer[m + 1];
+        }
+    }
+
+    bool isAvailable(HardwareCounter counter) const final
+    {
+        return fds[static_cast<size_t>(counter)] >= 0;
+    }
+
+private:
+    static int openEvent(HardwareCounter counter, int groupFd)
+    {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        switch (counter) {
+            case HardwareCounter::Cycles:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case HardwareCounter::Instructions:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case HardwareCounter::L1DMisses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            case HardwareCounter::LLCMisses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            case HardwareCounter::BranchMisses:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+            default:
+                return -1;
+        }
+        // User space only, which is all perf_event_paranoid 2 allows unprivileged processes anyway
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.disabled = groupFd < 0 ? 1 : 0;
+
+        // This thread only, on whichever CPU it runs
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, PERF_FLAG_FD_CLOEXEC));
+    }
+
+    std::array<int, counterCount> fds;
+    int leaderFd = -1;
+    std::array<size_t, counterCount> groupOrder{};
+    size_t memberCount = 0;
+};
+
+std::shared_ptr<PerfCounters> createPerfCounters()
+{
+    auto perfCounters = std::make_shared<PerfCountersImpl>();
+    if (!perfCounters->open()) {
+        return nullptr;
+    }
+    return perfCounters;
+}
+
+#else
+
+std::shared_ptr<PerfCounters> createPerfCounters()
+{
+    LOG_WARNING("Hardware counters are only supported on Linux");
+    return nullptr;
+}
+
+#endif
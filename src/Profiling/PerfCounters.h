@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+
+enum class HardwareCounter
+{
+    Cycles,
+    Instructions,
+    L1DMisses,
+    LLCMisses,
+    BranchMisses,
+    Count
+};
+
+const char* hardwareCounterName(HardwareCounter counter);
+
+// Running totals since the counters were opened. Counters the CPU doesn't provide stay at 0.
+struct HardwareCounts
+{
+    std::array<uint64_t, static_cast<size_t>(HardwareCounter::Count)> values{};
+
+    uint64_t operator[](HardwareCounter counter) const { return values[static_cast<size_t>(counter)]; }
+};
+
+// Linux perf_event_open counters for the thread that created them, read together in one syscall
+class PerfCounters {
+public:
+    virtual void read(HardwareCounts& counts) = 0;
+    virtual bool isAvailable(HardwareCounter counter) const = 0;
+
+    virtual ~PerfCounters() = default;
+};
+
+// Returns null when there are no usable counters, e.g. in containers or VMs without a PMU, with
+// perf_event_paranoid above 2, or on other platforms. Individual events (often the LLC on ARM) may
+// be missing while the rest work.
+std::shared_ptr<PerfCounters> createPerfCounters();
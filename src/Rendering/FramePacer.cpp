@@ -0,0 +1,108 @@
+#include "FramePacer.h"
+
+#include "GL.h"
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <thread>
+
+class FramePacerImpl : public FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Duration = std::chrono::duration<double>;
+
+    FramePacerImpl(double refreshRate, bool vsync)
+        : interval(std::chrono::duration_cast<Clock::duration>(Duration(1.0 / refreshRate))), vsync(vsync)
+    {
+        nextDeadline = Clock::now() + interval;
+    }
+
+    void waitForFrameStart() final
+    {
+        auto now = Clock::now();
+        if (!vsync) {
+            // Deadlines we've already fallen behind are dropped rather than rushed through
+            while (nextDeadline <= now) {
+                nextDeadline += interval;
+            }
+        }
+        auto start = nextDeadline - getWorkEstimate() - margin;
+        if (start > now) {
+            sleepUntil(start);
+        }
+        frameStart = Clock::now();
+    }
+
+    void frameBuilt() final
+    {
+        glFinish();
+        workTimes[nextWorkTime] = Clock::now() - frameStart;
+        nextWorkTime = (nextWorkTime + 1) % workTimes.size();
+    }
+
+    void frameSwapped() final
+    {
+        if (vsync) {
+            // Drivers often return from the swap straight away and only block on the next command
+            // that needs a buffer, so wait here for the flip to know where the refresh is
+            glFinish();
+        }
+        auto swapped = Clock::now();
+
+        bool missed = swapped > nextDeadline + interval / 2;
+        if (missed) {
+            margin = std::min(margin + marginStep, maxMargin());
+        } else {
+            margin = std::max(margin - marginDecay, minMargin);
+        }
+        nextDeadline = vsync ? swapped + interval : nextDeadline + interval;
+    }
+
+private:
+    // The slowest of the last few frames, one slow frame is enough to miss the deadline
+    Clock::duration getWorkEstimate() const
+    {
+        return *std::max_element(workTimes.begin(), workTimes.end());
+    }
+
+    Clock::duration maxMargin() const
+    {
+        return interval / 2;
+    }
+
+    // The scheduler can wake us a fair bit late, so wait to just short of the target and spin the rest.
+    // Events that arrive meanwhile are dispatched straight away rather than left in the OS queue until
+    // the frame polls, so anything timing them (the latency probe) sees when they really came in.
+    static void sleepUntil(Clock::time_point target)
+    {
+        for (auto now = Clock::now(); target - now > spinThreshold; now = Clock::now()) {
+            glfwWaitEventsTimeout(Duration(target - spinThreshold - now).count());
+        }
+        while (Clock::now() < target) {
+            std::this_thread::yield();
+        }
+    }
+
+    static constexpr Clock::duration spinThreshold = std::chrono::milliseconds(1);
+    static constexpr Clock::duration minMargin = std::chrono::microseconds(500);
+    static constexpr Clock::duration marginStep = std::chrono::microseconds(500);
+    static constexpr Clock::duration marginDecay = std::chrono::microseconds(10);
+
+    Clock::duration interval;
+    bool vsync;
+    Clock::time_point nextDeadline;
+    Clock::time_point frameStart;
+    Clock::duration margin = std::chrono::milliseconds(1);
+    std::array<Clock::duration, 32> workTimes{};
+    size_t nextWorkTime = 0;
+};
+
+std::shared_ptr<FramePacer> createFramePacer(double refreshRate, bool vsync)
+{
+    return std::make_shared<FramePacerImpl>(refreshRate, vsync);
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <memory>
+
+// Starts each frame as late as it can while still making the next refresh, so input is sampled
+// right before the frame that shows it is built rather than a whole refresh earlier. The deadline
+// is the next vsync (taken from when the previous swap completed) or, with swap interval 0, a
+// fixed clock at the refresh rate. The start is the deadline minus the slowest recent frame and a
+// safety margin that grows whenever a deadline is missed and slowly shrinks back.
+class FramePacer {
+public:
+    // Sleeps until the frame should start, dispatching events as they arrive, call right before
+    // polling events. Needs to be on the thread that created the window.
+    virtual void waitForFrameStart() = 0;
+    // Call once the frame has been submitted, before the swap. Waits for the GPU so no frames can
+    // queue up in the driver, and records how long the frame took.
+    virtual void frameBuilt() = 0;
+    // Call after the swap
+    virtual void frameSwapped() = 0;
+
+    virtual ~FramePacer() = default;
+};
+
+// Needs a current GL context. vsync should match the swap interval the context was given.
+std::shared_ptr<FramePacer> createFramePacer(double refreshRate, bool vsync);
@@ -0,0 +1,55 @@
+#pragma once
+
+// GL entry points for the app and renderer code, resolved straight from libGL/libGLESv2 rather than through GLEW
+#ifdef LUMON_GLES
+#include <GLES3/gl3.h>
+#else
+#define GL_GLEXT_PROTOTYPES
+#include <GL/gl.h>
+#include <GL/glext.h>
+#endif
+
+#include <cstring>
+
+#ifdef LUMON_GLES
+// The ImGui backend is built for ES 2.0 so it also runs on the 2.0 fallback context
+constexpr const char* imguiGlslVersion = "#version 100";
+constexpr const char* glslHeader = "#version 300 es\nprecision mediump float;\n";
+#else
+constexpr const char* imguiGlslVersion = "#version 130";
+constexpr const char* glslHeader = "#version 130\n";
+#endif
+
+// Context version as major*10 + minor, e.g. 33 for GL 3.3. ES 2.0 contexts report 0.
+inline int getGLVersion()
+{
+    GLint major = 0, minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    glGetError();
+    return major*10 + minor;
+}
+
+#ifdef LUMON_GLES
+// GLES builds use 32-bit ImDrawIdx, which ES 2.0 contexts only draw with OES_element_index_uint
+inline bool hasElementIndexUint()
+{
+    if (getGLVersion() >= 30) {
+        return true;
+    }
+    const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    return extensions && strstr(extensions, "GL_OES_element_index_uint");
+}
+#endif
+
+inline bool hasGLExtension(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        if (strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,282 @@
+#include "GpuTimer.h"
+
+#include "Log.h"
+
+#include "GL.h"
+#include "imgui.h"
+
+#include <array>
+
+const char* gpuSpanName(GpuSpan span)
+{
+    switch (span) {
+        case GpuSpan::Grid: return "grid";
+        case GpuSpan::Overlays: return "overlays";
+        case GpuSpan::Submit: return "submit";
+        default: return "unknown";
+    }
+}
+
+class GpuTimerImpl : public GpuTimer
+{
+public:
+    static constexpr size_t spanCount = static_cast<size_t>(GpuSpan::Count);
+
+    GpuTimerImpl()
+    {
+#ifndef LUMON_GLES
+        // GLES only has timer queries through an extension
+        supported = getGLVersion() >= 33 || hasGLExtension("GL_ARB_timer_query");
+#endif
+        if (!supported) {
+            LOG_INFO("GPU timer queries unavailable, GPU times won't be measured");
+            return;
+        }
+        for (auto &slot : slots) {
+            for (auto &span : slot.spans) {
+                for (auto &interval : span.intervals) {
+                    glGenQueries(1, &interval.begin.id);
+                    glGenQueries(1, &interval.end.id);
+                }
+            }
+        }
+    }
+
+    ~GpuTimerImpl() override
+    {
+        if (!supported) {
+            return;
+        }
+        for (auto &slot : slots) {
+            for (auto &span : slot.spans) {
+                for (auto &interval : span.intervals) {
+                    glDeleteQueries(1, &interval.begin.id);
+                    glDeleteQueries(1, &interval.end.id);
+                }
+            }
+        }
+    }
+
+    void beginFrame() final
+    {
+        recording = nullptr;
+        if (!supported || slots[nextSlot].pending) {
+            // The GPU is more than a ring behind, skip this frame rather than wait
+            return;
+        }
+        recording = &slots[nextSlot];
+        for (auto &span : recording->spans) {
+            span.used = 0;
+            span.open = false;
+        }
+    }
+
+    void endFrame() final
+    {
+        if (recording) {
+            recording->pending = true;
+            nextSlot = (nextSlot + 1) % slotCount;
+            recording = nullptr;
+        }
+        readBack();
+    }
+
+    void begin(GpuSpan span) final
+    {
+        if (auto* point = openInterval(span)) {
+            takeTimestamp(*point);
+        }
+    }
+
+    void end(GpuSpan span) final
+    {
+        if (auto* point = closeInterval(span)) {
+            takeTimestamp(*point);
+        }
+    }
+
+    void begin(GpuSpan span, ImDrawList* drawList) final
+    {
+        if (auto* point = openInterval(span)) {
+            drawList->AddCallback(&GpuTimerImpl::timestampCallback, point);
+        }
+    }
+
+    void end(GpuSpan span, ImDrawList* drawList) final
+    {
+        if (auto* point = closeInterval(span)) {
+            drawList->AddCallback(&GpuTimerImpl::timestampCallback, point);
+        }
+    }
+
+    std::optional<double> getLastTime(GpuSpan span) const final
+    {
+        return lastTimes[static_cast<size_t>(span)];
+    }
+
+    uint64_t getCompletedFrames() const final
+    {
+        return completedFrames;
+    }
+
+    bool isSupported() const final
+    {
+        return supported;
+    }
+
+private:
+    struct QueryPoint
+    {
+        GLuint id = 0;
+        // A draw list callback only runs if the draw list is rendered, which it isn't while the
+        // window is minimised, and a query that was never issued never becomes available
+        bool issued = false;
+    };
+
+    struct Interval
+    {
+        QueryPoint begin;
+        QueryPoint end;
+    };
+
+    // The overlays are drawn before and after the grid, so a span gets a few intervals per frame
+    static constexpr int maxIntervals = 4;
+
+    struct SpanQueries
+    {
+        std::array<Interval, maxIntervals> intervals;
+        int used = 0;
+        bool open = false;
+    };
+
+    struct FrameSlot
+    {
+        std::array<SpanQueries, spanCount> spans;
+        bool pending = false;
+    };
+
+    // Enough frames for the GPU to be a couple behind without dropping any
+    static constexpr int slotCount = 4;
+
+    QueryPoint* openInterval(GpuSpan span)
+    {
+        if (!recording) {
+            return nullptr;
+        }
+        auto &queries = recording->spans[static_cast<size_t>(span)];
+        if (queries.open || queries.used == maxIntervals) {
+            return nullptr;
+        }
+        queries.open = true;
+        auto &interval = queries.intervals[queries.used];
+        interval.begin.issued = false;
+        interval.end.issued = false;
+        return &interval.begin;
+    }
+
+    QueryPoint* closeInterval(GpuSpan span)
+    {
+        if (!recording) {
+            return nullptr;
+        }
+        auto &queries = recording->spans[static_cast<size_t>(span)];
+        if (!queries.open) {
+            return nullptr;
+        }
+        queries.open = false;
+        return &queries.intervals[queries.used++].end;
+    }
+
+    static void takeTimestamp(QueryPoint& point)
+    {
+#ifndef LUMON_GLES
+        glQueryCounter(point.id, GL_TIMESTAMP);
+#endif
+        point.issued = true;
+    }
+
+    static void timestampCallback(const ImDrawList*, const ImDrawCmd* cmd)
+    {
+        takeTimestamp(*static_cast<QueryPoint*>(cmd->UserCallbackData));
+    }
+
+    // Intervals whose timestamps didn't both run count as empty
+    static bool wasIssued(const Interval& interval)
+    {
+        return interval.begin.issued && interval.end.issued;
+    }
+
+    // Oldest first, stopping at the first frame the GPU hasn't finished
+    void readBack()
+    {
+        for (int i = 0; i < slotCount; i++) {
+            auto &slot = slots[(nextSlot + i) % slotCount];
+            if (!slot.pending) {
+                continue;
+            }
+            if (!isAvailable(slot)) {
+                return;
+            }
+            for (size_t s = 0; s < spanCount; s++) {
+                const auto &queries = slot.spans[s];
+                GLuint64 elapsed = 0;
+                bool ran = false;
+                for (int q = 0; q < queries.used; q++) {
+                    const auto &interval = queries.intervals[q];
+                    if (wasIssued(interval)) {
+                        elapsed += queryResult(interval.end.id) - queryResult(interval.begin.id);
+                        ran = true;
+                    }
+                }
+                if (ran) {
+                    lastTimes[s] = static_cast<double>(elapsed) / 1e6;
+                } else {
+                    lastTimes[s].reset();
+                }
+            }
+            slot.pending = false;
+            completedFrames++;
+        }
+    }
+
+    bool isAvailable(const FrameSlot& slot) const
+    {
+#ifndef LUMON_GLES
+        for (const auto &queries : slot.spans) {
+            for (int q = 0; q < queries.used; q++) {
+                if (!wasIssued(queries.intervals[q])) {
+                    continue;
+                }
+                GLint available = 0;
+                glGetQueryObjectiv(queries.intervals[q].end.id, GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available) {
+                    return false;
+                }
+            }
+        }
+#endif
+        return true;
+    }
+
+    static GLuint64 queryResult(GLuint id)
+    {
+        GLuint64 value = 0;
+#ifndef LUMON_GLES
+        glGetQueryObjectui64v(id, GL_QUERY_RESULT, &value);
+#endif
+        return value;
+    }
+
+    bool supported = false;
+    std::array<FrameSlot, slotCount> slots{};
+    int nextSlot = 0;
+    FrameSlot* recording = nullptr;
+
+    std::array<std::optional<double>, spanCount> lastTimes{};
+    uint64_t completedFrames = 0;
+};
+
+std::shared_ptr<GpuTimer> createGpuTimer()
+{
+    return std::make_shared<GpuTimerImpl>();
+}
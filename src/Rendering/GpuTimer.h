@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+struct ImDrawList;
+
+enum class GpuSpan
+{
+    Grid,
+    Overlays,
+    Submit,
+    Count
+};
+
+const char* gpuSpanName(GpuSpan span);
+
+// GPU time of render passes from GL_TIMESTAMP query pairs, which unlike GL_TIME_ELAPSED can nest
+// (the grid and overlays run inside the submit). Each frame uses its own slot in a small ring and
+// results are read back once the GPU has finished, a few frames later, so the CPU never waits.
+// Without timer query support (GL < 3.3 without ARB_timer_query, GLES) everything is a no-op.
+class GpuTimer {
+public:
+    virtual void beginFrame() = 0;
+    // Reads back every finished frame, call after the frame's submit
+    virtual void endFrame() = 0;
+
+    // Timestamps taken straight away, for spans around GL calls made on the CPU
+    virtual void begin(GpuSpan span) = 0;
+    virtual void end(GpuSpan span) = 0;
+
+    // Timestamps taken where the draw list's commands run. A span can be opened a few times a
+    // frame, the times are added up.
+    virtual void begin(GpuSpan span, ImDrawList* drawList) = 0;
+    virtual void end(GpuSpan span, ImDrawList* drawList) = 0;
+
+    // Milliseconds the span took in the newest frame read back, if it ran in that frame
+    virtual std::optional<double> getLastTime(GpuSpan span) const = 0;
+    // Frames read back so far, to tell when getLastTime() has a new result
+    virtual uint64_t getCompletedFrames() const = 0;
+
+    virtual bool isSupported() const = 0;
+
+    virtual ~GpuTimer() = default;
+};
+
+// Needs a current GL context
+std::shared_ptr<GpuTimer> createGpuTimer();
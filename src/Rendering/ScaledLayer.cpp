@@ -0,0 +1,148 @@
+#include "ScaledLayer.h"
+
+#include "Log.h"
+
+#include "GL.h"
+#include "imgui.h"
+
+#include <algorithm>
+
+class ScaledLayerImpl : public ScaledLayer
+{
+public:
+    ~ScaledLayerImpl() override
+    {
+        deleteTarget();
+    }
+
+    void begin(ImDrawList* drawList) final
+    {
+        const ImGuiIO& io = ImGui::GetIO();
+        frameWidth = static_cast<int>(io.DisplaySize.x * io.DisplayFramebufferScale.x);
+        frameHeight = static_cast<int>(io.DisplaySize.y * io.DisplayFramebufferScale.y);
+        displaySize = io.DisplaySize;
+
+        // Decided while building the frame so begin and end callbacks agree
+        redirecting = scale < 1.f && frameWidth > 0 && frameHeight > 0;
+        if (redirecting) {
+            ensureTarget(frameWidth, frameHeight);
+            scaledWidth = std::max(1, static_cast<int>(frameWidth * scale));
+            scaledHeight = std::max(1, static_cast<int>(frameHeight * scale));
+        }
+        drawList->AddCallback(&ScaledLayerImpl::beginCallback, this);
+    }
+
+    void end(ImDrawList* drawList) final
+    {
+        drawList->AddCallback(&ScaledLayerImpl::endCallback, this);
+        if (redirecting) {
+            // The layer holds premultiplied colour, so it's blended with ONE rather than SRC_ALPHA
+            drawList->AddCallback(&ScaledLayerImpl::premultipliedBlendCallback, this);
+            drawList->AddImage((ImTextureID)(intptr_t)texture, ImVec2(0, 0), displaySize,
+                               ImVec2(0, static_cast<float>(scaledHeight) / targetHeight), ImVec2(static_cast<float>(scaledWidth) / targetWidth, 0));
+        }
+        drawList->AddCallback(ImDrawCallback_ResetRenderState, nullptr);
+    }
+
+    void setScale(float newScale) final
+    {
+        scale = std::clamp(newScale, minScale, 1.f);
+    }
+
+    float getScale() const final
+    {
+        return scale;
+    }
+
+private:
+    static void beginCallback(const ImDrawList*, const ImDrawCmd* cmd)
+    {
+        auto &layer = *static_cast<ScaledLayerImpl*>(cmd->UserCallbackData);
+        if (!layer.redirecting) {
+            return;
+        }
+
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &layer.previousFramebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, layer.framebuffer);
+        glViewport(0, 0, layer.scaledWidth, layer.scaledHeight);
+
+        // Scissor rects are computed for the full-size framebuffer, the layer is clipped by the viewport instead
+        glDisable(GL_SCISSOR_TEST);
+        glClearColor(0.f, 0.f, 0.f, 0.f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    static void endCallback(const ImDrawList*, const ImDrawCmd* cmd)
+    {
+        auto &layer = *static_cast<ScaledLayerImpl*>(cmd->UserCallbackData);
+        if (layer.redirecting) {
+            glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(layer.previousFramebuffer));
+            glViewport(0, 0, layer.frameWidth, layer.frameHeight);
+            glEnable(GL_SCISSOR_TEST);
+        }
+    }
+
+    static void premultipliedBlendCallback(const ImDrawList*, const ImDrawCmd*)
+    {
+        glBlendFuncSeparate(GL_ONE, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    }
+
+    void ensureTarget(int width, int height)
+    {
+        if (framebuffer && targetWidth == width && targetHeight == height) {
+            return;
+        }
+        deleteTarget();
+
+        // Allocated at full size so changing the scale never reallocates
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+        GLint previousFramebuffer = 0;
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            LOG_ERROR("Scaled layer framebuffer is incomplete (%dx%d)", width, height);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previousFramebuffer));
+
+        targetWidth = width;
+        targetHeight = height;
+        LOG_DEBUG("Scaled layer target resized to %dx%d", width, height);
+    }
+
+    void deleteTarget()
+    {
+        if (framebuffer) {
+            glDeleteFramebuffers(1, &framebuffer);
+            glDeleteTextures(1, &texture);
+            framebuffer = 0;
+            texture = 0;
+        }
+    }
+
+    static constexpr float minScale = 0.25f;
+
+    float scale = 1.f;
+    bool redirecting = false;
+    ImVec2 displaySize;
+    int frameWidth = 0, frameHeight = 0;
+    int scaledWidth = 0, scaledHeight = 0;
+
+    GLuint framebuffer = 0;
+    GLuint texture = 0;
+    int targetWidth = 0, targetHeight = 0;
+    GLint previousFramebuffer = 0;
+};
+
+std::shared_ptr<ScaledLayer> createScaledLayer()
+{
+    return std::make_shared<ScaledLayerImpl>();
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <memory>
+
+struct ImDrawList;
+
+// Redirects a span of a draw list into an offscreen framebuffer rendered at a fraction of the
+// display resolution, then composites it back with linear upscaling. Everything outside
+// begin()/end() keeps drawing at native resolution.
+class ScaledLayer {
+public:
+    // Both are called while building the frame, the GL work happens in draw list callbacks
+    virtual void begin(ImDrawList* drawList) = 0;
+    virtual void end(ImDrawList* drawList) = 0;
+
+    // Fraction of the display resolution, 1 draws straight to the screen
+    virtual void setScale(float scale) = 0;
+    virtual float getScale() const = 0;
+
+    virtual ~ScaledLayer() = default;
+};
+
+std::shared_ptr<ScaledLayer> createScaledLayer();
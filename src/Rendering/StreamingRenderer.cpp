@@ -0,0 +1,383 @@
+#include "StreamingRenderer.h"
+
+#include "../Profiling/FrameProfiler.h"
+#include "Log.h"
+
+#include "GL.h"
+#include "imgui.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const char* vertexShaderSource = R"(uniform mat4 ProjMtx;
+in vec2 Position;
+in vec2 UV;
+in vec4 Color;
+out vec2 Frag_UV;
+out vec4 Frag_Color;
+void main()
+{
+    Frag_UV = UV;
+    Frag_Color = Color;
+    gl_Position = ProjMtx * vec4(Position.xy, 0, 1);
+}
+)";
+
+    const char* fragmentShaderSource = R"(uniform sampler2D Texture;
+in vec2 Frag_UV;
+in vec4 Frag_Color;
+out vec4 Out_Color;
+void main()
+{
+    Out_Color = Frag_Color * texture(Texture, Frag_UV.st);
+}
+)";
+
+    enum AttribLocation : GLuint
+    {
+        PositionAttrib = 0,
+        UVAttrib = 1,
+        ColorAttrib = 2
+    };
+
+    GLuint compileShader(GLenum type, const char* source)
+    {
+        GLuint shader = glCreateShader(type);
+        const char* sources[] = {glslHeader, source};
+        glShaderSource(shader, 2, sources, nullptr);
+        glCompileShader(shader);
+
+        GLint status = GL_FALSE;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+        if (status != GL_TRUE) {
+            char log[512] = {};
+            glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            LOG_ERROR("Failed to compile streaming renderer shader: %s", log);
+        }
+        return shader;
+    }
+}
+
+class StreamingRendererImpl : public StreamingRenderer
+{
+public:
+    StreamingRendererImpl(std::shared_ptr<FrameProfiler> frameProfiler, int framesInFlight, bool persistent)
+        : frameProfiler(std::move(frameProfiler)), segments(framesInFlight), persistent(persistent)
+    {
+        GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
+        GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+        program = glCreateProgram();
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+        glBindAttribLocation(program, PositionAttrib, "Position");
+        glBindAttribLocation(program, UVAttrib, "UV");
+        glBindAttribLocation(program, ColorAttrib, "Color");
+        glLinkProgram(program);
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+
+        projMtxLocation = glGetUniformLocation(program, "ProjMtx");
+        textureLocation = glGetUniformLocation(program, "Texture");
+
+        glGenVertexArrays(1, &vertexArray);
+        createBuffers(initialVertexCapacity, initialIndexCapacity);
+
+        LOG_INFO("Streaming renderer: %d frames in flight, %s buffers", framesInFlight, persistent ? "persistently mapped" : "unsynchronized mapped");
+    }
+
+    ~StreamingRendererImpl() override
+    {
+        waitForAllSegments();
+        deleteBuffers();
+        glDeleteVertexArrays(1, &vertexArray);
+        glDeleteProgram(program);
+    }
+
+    void render(ImDrawData* drawData) final
+    {
+        int fbWidth = static_cast<int>(drawData->DisplaySize.x * drawData->FramebufferScale.x);
+        int fbHeight = static_cast<int>(drawData->DisplaySize.y * drawData->FramebufferScale.y);
+        if (fbWidth <= 0 || fbHeight <= 0 || drawData->TotalVtxCount == 0) {
+            return;
+        }
+
+        // Segments are sized for the largest frame so far, growing means reallocating the whole ring
+        if (drawData->TotalVtxCount > vertexCapacity || drawData->TotalIdxCount > indexCapacity) {
+            waitForAllSegments();
+            deleteBuffers();
+            createBuffers(std::max(vertexCapacity*2, drawData->TotalVtxCount), std::max(indexCapacity*2, drawData->TotalIdxCount));
+        }
+
+        // The GPU may still be reading this segment from framesInFlight frames ago
+        auto &segment = segments[segmentIdx];
+        if (segment.fence) {
+            ProfileScope profileScope(*frameProfiler, FrameStage::BufferWait);
+            waitForFence(segment.fence);
+        }
+
+        uploadDrawData(drawData);
+        setupRenderState(drawData, fbWidth, fbHeight);
+
+        // Same clipping as the stock backend, but every list draws from its slice of the segment
+        ImVec2 clipOff = drawData->DisplayPos;
+        ImVec2 clipScale = drawData->FramebufferScale;
+        for (int n = 0; n < drawData->CmdListsCount; n++) {
+            const ImDrawList* drawList = drawData->CmdLists[n];
+            auto [listVertexStart, listIndexStart] = listOffsets[n];
+            for (const auto &cmd : drawList->CmdBuffer) {
+                if (cmd.UserCallback) {
+                    if (cmd.UserCallback == ImDrawCallback_ResetRenderState) {
+                        setupRenderState(drawData, fbWidth, fbHeight);
+                    } else {
+                        cmd.UserCallback(drawList, &cmd);
+                    }
+                    continue;
+                }
+
+                ImVec2 clipMin((cmd.ClipRect.x - clipOff.x) * clipScale.x, (cmd.ClipRect.y - clipOff.y) * clipScale.y);
+                ImVec2 clipMax((cmd.ClipRect.z - clipOff.x) * clipScale.x, (cmd.ClipRect.w - clipOff.y) * clipScale.y);
+                if (clipMax.x <= clipMin.x || clipMax.y <= clipMin.y) {
+                    continue;
+                }
+                glScissor(static_cast<GLint>(clipMin.x), static_cast<GLint>(fbHeight - clipMax.y),
+                          static_cast<GLsizei>(clipMax.x - clipMin.x), static_cast<GLsizei>(clipMax.y - clipMin.y));
+
+                // Re-pointing the attributes stands in for a base vertex, which GLES 3.0 doesn't have
+                size_t vertexStart = segmentIdx*static_cast<size_t>(vertexCapacity) + listVertexStart + cmd.VtxOffset;
+                if (vertexStart != boundVertexStart) {
+                    bindVertexAttributes(vertexStart);
+                }
+
+                glBindTexture(GL_TEXTURE_2D, static_cast<GLuint>(static_cast<intptr_t>(cmd.GetTexID())));
+                size_t indexOffset = (segmentIdx*static_cast<size_t>(indexCapacity) + listIndexStart + cmd.IdxOffset) * sizeof(ImDrawIdx);
+                glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(cmd.ElemCount), sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                               reinterpret_cast<void*>(indexOffset));
+            }
+        }
+
+        segment.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        segmentIdx = (segmentIdx + 1) % segments.size();
+
+        // Leave the state the rest of the frame expects (glClear is affected by the scissor test)
+        glDisable(GL_SCISSOR_TEST);
+        glBindVertexArray(0);
+        glUseProgram(0);
+    }
+
+private:
+    void uploadDrawData(ImDrawData* drawData)
+    {
+        size_t vertexOffset = segmentIdx*static_cast<size_t>(vertexCapacity);
+        size_t indexOffset = segmentIdx*static_cast<size_t>(indexCapacity);
+        size_t vertexBytes = static_cast<size_t>(drawData->TotalVtxCount) * sizeof(ImDrawVert);
+        size_t indexBytes = static_cast<size_t>(drawData->TotalIdxCount) * sizeof(ImDrawIdx);
+
+        ImDrawVert* vertexDst;
+        ImDrawIdx* indexDst;
+        if (persistent) {
+            vertexDst = mappedVertices + vertexOffset;
+            indexDst = mappedIndices + indexOffset;
+        } else {
+            // The fence already guarantees the GPU is done with this range, so skip the driver's own sync
+            GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            vertexDst = static_cast<ImDrawVert*>(glMapBufferRange(GL_ARRAY_BUFFER, vertexOffset * sizeof(ImDrawVert), vertexBytes, access));
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+            indexDst = static_cast<ImDrawIdx*>(glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, indexOffset * sizeof(ImDrawIdx), indexBytes, access));
+        }
+
+        listOffsets.clear();
+        int vertexStart = 0, indexStart = 0;
+        for (int n = 0; n < drawData->CmdListsCount; n++) {
+            const ImDrawList* drawList = drawData->CmdLists[n];
+            listOffsets.emplace_back(vertexStart, indexStart);
+            if (vertexDst && indexDst) {
+                memcpy(vertexDst + vertexStart, drawList->VtxBuffer.Data, drawList->VtxBuffer.Size * sizeof(ImDrawVert));
+                memcpy(indexDst + indexStart, drawList->IdxBuffer.Data, drawList->IdxBuffer.Size * sizeof(ImDrawIdx));
+            }
+            vertexStart += drawList->VtxBuffer.Size;
+            indexStart += drawList->IdxBuffer.Size;
+        }
+
+        if (!persistent) {
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+            glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+        }
+        frameProfiler->addCounter(FrameCounter::UploadBytes, static_cast<double>(vertexBytes + indexBytes));
+    }
+
+    void setupRenderState(ImDrawData* drawData, int fbWidth, int fbHeight)
+    {
+        glEnable(GL_BLEND);
+        glBlendEquation(GL_FUNC_ADD);
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+        glDisable(GL_CULL_FACE);
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_STENCIL_TEST);
+        glEnable(GL_SCISSOR_TEST);
+
+        glViewport(0, 0, fbWidth, fbHeight);
+        float L = drawData->DisplayPos.x;
+        float R = drawData->DisplayPos.x + drawData->DisplaySize.x;
+        float T = drawData->DisplayPos.y;
+        float B = drawData->DisplayPos.y + drawData->DisplaySize.y;
+        const float orthoProjection[4][4] =
+        {
+            { 2.0f/(R-L),   0.0f,         0.0f,   0.0f },
+            { 0.0f,         2.0f/(T-B),   0.0f,   0.0f },
+            { 0.0f,         0.0f,        -1.0f,   0.0f },
+            { (R+L)/(L-R),  (T+B)/(B-T),  0.0f,   1.0f },
+        };
+        glUseProgram(program);
+        glUniform1i(textureLocation, 0);
+        glUniformMatrix4fv(projMtxLocation, 1, GL_FALSE, &orthoProjection[0][0]);
+        glActiveTexture(GL_TEXTURE0);
+
+        glBindVertexArray(vertexArray);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+    }
+
+    void createBuffers(int vertexCount, int indexCount)
+    {
+        vertexCapacity = vertexCount;
+        indexCapacity = indexCount;
+        auto vertexBytes = static_cast<GLsizeiptr>(segments.size() * vertexCapacity * sizeof(ImDrawVert));
+        auto indexBytes = static_cast<GLsizeiptr>(segments.size() * indexCapacity * sizeof(ImDrawIdx));
+
+        glBindVertexArray(vertexArray);
+        glGenBuffers(1, &vertexBuffer);
+        glGenBuffers(1, &indexBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+#ifndef LUMON_GLES
+        if (persistent) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, vertexBytes, nullptr, flags);
+            glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, indexBytes, nullptr, flags);
+            mappedVertices = static_cast<ImDrawVert*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, vertexBytes, flags));
+            mappedIndices = static_cast<ImDrawIdx*>(glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, indexBytes, flags));
+            if (!mappedVertices || !mappedIndices) {
+                LOG_WARNING("Persistent mapping failed, using unsynchronized mapping instead");
+                glBindVertexArray(0);
+                deleteBuffers();
+                persistent = false;
+                createBuffers(vertexCount, indexCount);
+                return;
+            }
+        } else
+#endif
+        {
+            glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_STREAM_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, nullptr, GL_STREAM_DRAW);
+        }
+
+        glEnableVertexAttribArray(PositionAttrib);
+        glEnableVertexAttribArray(UVAttrib);
+        glEnableVertexAttribArray(ColorAttrib);
+        bindVertexAttributes(0);
+        glBindVertexArray(0);
+
+        LOG_DEBUG("Streaming renderer buffers: %d vertices, %d indices per frame", vertexCapacity, indexCapacity);
+    }
+
+    // Points the attributes at vertexStart within the ring, expects the vertex array to be bound
+    void bindVertexAttributes(size_t vertexStart)
+    {
+        size_t base = vertexStart * sizeof(ImDrawVert);
+        glVertexAttribPointer(PositionAttrib, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), reinterpret_cast<void*>(base + offsetof(ImDrawVert, pos)));
+        glVertexAttribPointer(UVAttrib, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), reinterpret_cast<void*>(base + offsetof(ImDrawVert, uv)));
+        glVertexAttribPointer(ColorAttrib, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), reinterpret_cast<void*>(base + offsetof(ImDrawVert, col)));
+        boundVertexStart = vertexStart;
+    }
+
+    void deleteBuffers()
+    {
+        if (persistent) {
+            glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, indexBuffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            mappedVertices = nullptr;
+            mappedIndices = nullptr;
+        }
+        glDeleteBuffers(1, &vertexBuffer);
+        glDeleteBuffers(1, &indexBuffer);
+    }
+
+    void waitForAllSegments()
+    {
+        for (auto &segment : segments) {
+            if (segment.fence) {
+                waitForFence(segment.fence);
+            }
+        }
+    }
+
+    static void waitForFence(GLsync &fence)
+    {
+        while (true) {
+            GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, fenceTimeoutNs);
+            if (result != GL_TIMEOUT_EXPIRED) {
+                break;
+            }
+        }
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+
+    struct Segment
+    {
+        GLsync fence = nullptr;
+    };
+
+    static constexpr int initialVertexCapacity = 1 << 16;
+    static constexpr int initialIndexCapacity = 3 << 15;
+    static constexpr GLuint64 fenceTimeoutNs = 100'000'000;
+
+    std::shared_ptr<FrameProfiler> frameProfiler;
+    std::vector<Segment> segments;
+    size_t segmentIdx = 0;
+    bool persistent;
+
+    GLuint program = 0;
+    GLint projMtxLocation = -1;
+    GLint textureLocation = -1;
+    GLuint vertexArray = 0;
+    GLuint vertexBuffer = 0;
+    GLuint indexBuffer = 0;
+    int vertexCapacity = 0;
+    size_t boundVertexStart = 0;
+    int indexCapacity = 0;
+    ImDrawVert* mappedVertices = nullptr;
+    ImDrawIdx* mappedIndices = nullptr;
+
+    // Start of each draw list within the current segment, in vertices and indices
+    std::vector<std::pair<int, int>> listOffsets;
+};
+
+std::shared_ptr<StreamingRenderer> createStreamingRenderer(const std::shared_ptr<FrameProfiler>& frameProfiler, int framesInFlight)
+{
+    int version = getGLVersion();
+
+#ifdef LUMON_GLES
+    bool hasSync = version >= 30;
+    bool persistent = false;
+#else
+    bool hasSync = version >= 32 || (version >= 30 && hasGLExtension("GL_ARB_sync"));
+    bool persistent = version >= 44 || hasGLExtension("GL_ARB_buffer_storage");
+#endif
+    if (!hasSync) {
+        LOG_WARNING("Streaming renderer needs sync objects (context is %d.%d)", version / 10, version % 10);
+        return nullptr;
+    }
+
+    return std::make_shared<StreamingRendererImpl>(frameProfiler, std::clamp(framesInFlight, 1, 3), persistent);
+}
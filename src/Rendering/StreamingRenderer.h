@@ -0,0 +1,20 @@
+#pragma once
+
+#include <memory>
+
+class FrameProfiler;
+struct ImDrawData;
+
+// Alternative to ImGui_ImplOpenGL3_RenderDrawData that streams vertices through a ring of buffer
+// segments guarded by fences, so the CPU can fill frame N+1 while the GPU is still drawing frame N.
+// Textures (including the font atlas) are still created by the ImGui OpenGL3 backend.
+class StreamingRenderer {
+public:
+    virtual void render(ImDrawData* drawData) = 0;
+
+    virtual ~StreamingRenderer() = default;
+};
+
+// Needs a current GL context with sync objects and glMapBufferRange, returns nullptr otherwise.
+// Buffers are persistently mapped when the context supports buffer storage.
+std::shared_ptr<StreamingRenderer> createStreamingRenderer(const std::shared_ptr<FrameProfiler>& frameProfiler, int framesInFlight);
@@ -0,0 +1,637 @@
+#include "SessionSync.h"
+
+#include "Log.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <optional>
+#include <random>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unordered_map>
+
+// Datagram layout, little-endian:
+//
+//   u16 magic "LS", u8 version, u32 session, u32 node, u32 sequence, u32 lamport clock,
+//   u64 send time (microseconds since the epoch), u16 delta count, then per delta a u8 type and
+//     GroupActivated    u32 group
+//     GroupRefined      u32 group
+//     DigitRegenerated  u16 x, u16 y, u8 digit
+//     BinCount          u8 bin, u32 groups refined
+//
+// Every delta in a packet was written at the packet's clock value.
+namespace
+{
+    constexpr uint16_t packetMagic = 0x534c;
+    constexpr uint8_t protocolVersion = 1;
+    constexpr size_t headerSize = 29;
+    // Under a typical Ethernet MTU once IP and UDP headers are added, so datagrams never fragment
+    constexpr size_t maxPacketSize = 1200;
+
+    size_t deltaSize(SyncDeltaType type)
+    {
+        switch (type) {
+            case SyncDeltaType::GroupActivated:
+            case SyncDeltaType::GroupRefined: return 1 + 4;
+            case SyncDeltaType::DigitRegenerated: return 1 + 2 + 2 + 1;
+            case SyncDeltaType::BinCount: return 1 + 1 + 4;
+            default: return 0;
+        }
+    }
+
+    class Writer
+    {
+    public:
+        explicit Writer(uint8_t* data) : data(data) {}
+
+        template<typename T>
+        void put(T value)
+        {
+            for (size_t i = 0; i < sizeof(T); i++) {
+                data[size++] = static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i));
+            }
+        }
+
+        uint8_t* data;
+        size_t size = 0;
+    };
+
+    class Reader
+    {
+    public:
+        Reader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+        // Leaves value alone and fails every later read once the data runs out
+        template<typename T>
+        bool get(T& value)
+        {
+            if (!ok || offset + sizeof(T) > size) {
+                ok = false;
+                return false;
+            }
+            uint64_t result = 0;
+            for (size_t i = 0; i < sizeof(T); i++) {
+                result |= static_cast<uint64_t>(data[offset++]) << (8 * i);
+            }
+            value = static_cast<T>(result);
+            return true;
+        }
+
+        bool ok = true;
+
+    private:
+        const uint8_t* data;
+        size_t size;
+        size_t offset = 0;
+    };
+
+    // Last-writer-wins order: the Lamport clock, then the node id to break ties. Clock 0 means never written.
+    struct Version
+    {
+        uint32_t clock = 0;
+        uint32_t node = 0;
+
+        bool operator>(const Version& other) const
+        {
+            return clock != other.clock ? clock > other.clock : node > other.node;
+        }
+
+        bool operator==(const Version& other) const
+        {
+            return clock == other.clock && node == other.node;
+        }
+    };
+
+    std::optional<sockaddr_in> parseAddress(const std::string& hostPort, const char* defaultHost)
+    {
+        std::string host = defaultHost;
+        std::string port = hostPort;
+        if (auto colon = hostPort.rfind(':'); colon != std::string::npos) {
+            host = hostPort.substr(0, colon);
+            port = hostPort.substr(colon + 1);
+        }
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        int portNumber = std::atoi(port.c_str());
+        if (portNumber <= 0 || portNumber > 65535 || inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+            return std::nullopt;
+        }
+        address.sin_port = htons(static_cast<uint16_t>(portNumber));
+        return address;
+    }
+
+    uint64_t wallClockMicros()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+}
+
+class SessionSyncImpl : public SessionSync
+{
+public:
+    SessionSyncImpl(int fd, std::vector<sockaddr_in> peerAddresses, uint32_t session, int gridSize, size_t groupCount)
+        : fd(fd), peerAddresses(std::move(peerAddresses)), session(session), gridSize(gridSize)
+    {
+        // Random rather than configured, so two kiosks can't end up sharing one by mistake
+        std::random_device random;
+        do {
+            node = random();
+        } while (node == 0);
+
+        groupVersions.resize(groupCount);
+        pending.reserve(pendingReserve);
+        recentDeltas.reserve(pendingReserve);
+        recentTicks.reserve(resendAges.back());
+        stats.tickApplyLatencies.reserve(latenciesReserve);
+        peers.reserve(peersReserve);
+        LOG_INFO("Sync node %08x, session %08x, %zu peer address(es)", node, session, this->peerAddresses.size());
+    }
+
+    ~SessionSyncImpl() override
+    {
+        close(fd);
+        LOG_INFO("Sync: sent %llu packets (%llu bytes, %llu deltas), received %llu packets (%llu bytes), applied %llu deltas, "
+                 "%llu superseded, %llu lost, %llu stale",
+                 ull(stats.packetsSent), ull(stats.bytesSent), ull(stats.deltasSent), ull(stats.packetsReceived), ull(stats.bytesReceived),
+                 ull(stats.deltasApplied), ull(stats.deltasSuperseded), ull(stats.packetsLost), ull(stats.packetsStale));
+    }
+
+    void publish(const std::vector<GridEvent>& events, NumberGrid& numberGrid) final
+    {
+        for (const auto &event : events) {
+            switch (event.type) {
+                case GridEventType::GroupActivated: {
+                    SyncDelta delta;
+                    delta.type = SyncDeltaType::GroupActivated;
+                    delta.groupId = event.groupId;
+                    pending.push_back(delta);
+                    break;
+                }
+                case GridEventType::GroupRefined: {
+                    if (event.groupId >= groupVersions.size()) {
+                        break;
+                    }
+                    groupVersions[event.groupId] = Version{tickClock(), node};
+                    SyncDelta delta;
+                    delta.type = SyncDeltaType::GroupRefined;
+                    delta.groupId = event.groupId;
+                    pending.push_back(delta);
+                    break;
+                }
+                case GridEventType::NumberRegenerated: {
+                    // Every kiosk regenerates the numbers of a refined group as they land, but only the
+                    // kiosk whose refine won sends its digits, so they aren't overwritten once per kiosk
+                    if (isRemoteRefine(event.groupId)) {
+                        break;
+                    }
+                    cellVersions[cellIndex(event.x, event.y)] = Version{tickClock(), node};
+                    SyncDelta delta;
+                    delta.type = SyncDeltaType::DigitRegenerated;
+                    delta.x = static_cast<uint16_t>(event.x);
+                    delta.y = static_cast<uint16_t>(event.y);
+                    delta.digit = numberGrid.getGridNumber(event.x, event.y)->num;
+                    pending.push_back(delta);
+                    break;
+                }
+                default:
+                    // Deactivation follows from each kiosk's own pulse timers
+                    break;
+            }
+        }
+    }
+
+    void setBinCount(int binIdx, int groupsRefined) final
+    {
+        if (binIdx >= 0 && binIdx < binCount) {
+            localBinCounts[binIdx] = static_cast<uint32_t>(groupsRefined);
+        }
+    }
+
+    void flush() final
+    {
+        stats.tickBytesSent = 0;
+
+        // Changed bin counts, or all of them every so often for kiosks that missed a packet
+        bool resendBins = ++ticks % binResendTicks == 0;
+        for (int b = 0; b < binCount; b++) {
+            if (resendBins || localBinCounts[b] != sentBinCounts[b]) {
+                SyncDelta delta;
+                delta.type = SyncDeltaType::BinCount;
+                delta.bin = static_cast<uint8_t>(b);
+                delta.count = localBinCounts[b];
+                pending.push_back(delta);
+                sentBinCounts[b] = localBinCounts[b];
+            }
+        }
+        if (!pending.empty()) {
+            // Deltas written this tick carry its clock, a tick of bin counts alone reuses the last one
+            sendDeltas(pending, 0, pending.size(), clock);
+            keepForResending();
+            pending.clear();
+        }
+        resendRecent();
+        tickHasWrites = false;
+    }
+
+    void receive(std::vector<SyncDelta>& applied) final
+    {
+        stats.tickBytesReceived = 0;
+        stats.tickApplyLatencies.clear();
+        expirePeers();
+
+        while (true) {
+            ssize_t size = recv(fd, packet.data(), packet.size(), MSG_DONTWAIT);
+            if (size < 0) {
+                // A peer that isn't up yet bounces an ICMP error back to the next read, which can be skipped
+                if (errno == ECONNREFUSED) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    LOG_RATE_LIMITED(LogLevel::Warning, 5, "Sync receive failed: %s", strerror(errno));
+                }
+                break;
+            }
+            readPacket(packet.data(), static_cast<size_t>(size), applied);
+        }
+    }
+
+    int getRemoteBinCount(int binIdx) const final
+    {
+        int total = 0;
+        for (const auto &peer : peers) {
+            total += static_cast<int>(peer.binCounts[binIdx]);
+        }
+        return total;
+    }
+
+    const SyncStats& getStats() const final
+    {
+        return stats;
+    }
+
+private:
+    // A tick's refines and digits in recentDeltas
+    struct SentTick
+    {
+        uint64_t tick;
+        uint32_t clock;
+        size_t deltaCount;
+    };
+
+    struct Peer
+    {
+        uint32_t node;
+        uint32_t lastSequence;
+        uint64_t lastHeardTick;
+        std::array<uint32_t, binCount> binCounts{};
+    };
+
+    static unsigned long long ull(uint64_t value)
+    {
+        return static_cast<unsigned long long>(value);
+    }
+
+    size_t cellIndex(int x, int y) const
+    {
+        return static_cast<size_t>(x) * gridSize + y;
+    }
+
+    bool isRemoteRefine(uint32_t groupId) const
+    {
+        return groupId < groupVersions.size() && groupVersions[groupId].clock != 0 && groupVersions[groupId].node != node;
+    }
+
+    // The Lamport clock moves once per tick that writes anything
+    uint32_t tickClock()
+    {
+        if (!tickHasWrites) {
+            clock++;
+            tickHasWrites = true;
+        }
+        return clock;
+    }
+
+    // Sends deltas[first, last) in as few datagrams as fit, all of them written at packetClock
+    void sendDeltas(const std::vector<SyncDelta>& deltas, size_t first, size_t last, uint32_t packetClock)
+    {
+        size_t next = first;
+        while (next < last) {
+            Writer writer(packet.data());
+            writer.put(packetMagic);
+            writer.put(protocolVersion);
+            writer.put(session);
+            writer.put(node);
+            writer.put(++sequence);
+            writer.put(packetClock);
+            writer.put(wallClockMicros());
+            size_t countOffset = writer.size;
+            writer.put(uint16_t(0));
+
+            uint16_t count = 0;
+            while (next < last && writer.size + deltaSize(deltas[next].type) <= maxPacketSize) {
+                writeDelta(writer, deltas[next++]);
+                count++;
+            }
+            Writer countWriter(packet.data() + countOffset);
+            countWriter.put(count);
+
+            for (const auto &peer : peerAddresses) {
+                if (sendto(fd, packet.data(), writer.size, MSG_DONTWAIT, reinterpret_cast<const sockaddr*>(&peer), sizeof(peer)) < 0) {
+                    LOG_RATE_LIMITED(LogLevel::Warning, 5, "Sync send failed: %s", strerror(errno));
+                    continue;
+                }
+                stats.packetsSent++;
+                stats.bytesSent += writer.size;
+                stats.tickBytesSent += writer.size;
+            }
+            stats.deltasSent += count;
+        }
+    }
+
+    // Refines and digits are only sent when they change, so one lost packet would leave the kiosks
+    // disagreeing for good. They go out a few more times, at the clock they were written at.
+    void keepForResending()
+    {
+        size_t first = recentDeltas.size();
+        for (const auto &delta : pending) {
+            if (delta.type == SyncDeltaType::GroupRefined || delta.type == SyncDeltaType::DigitRegenerated) {
+                recentDeltas.push_back(delta);
+            }
+        }
+        if (recentDeltas.size() > first) {
+            recentTicks.push_back(SentTick{ticks, clock, recentDeltas.size() - first});
+        }
+    }
+
+    void resendRecent()
+    {
+        size_t first = 0;
+        for (const auto &sent : recentTicks) {
+            if (std::find(resendAges.begin(), resendAges.end(), ticks - sent.tick) != resendAges.end()) {
+                sendDeltas(recentDeltas, first, first + sent.deltaCount, sent.clock);
+            }
+            first += sent.deltaCount;
+        }
+
+        // Ticks that have had their last resend come off the front
+        size_t expiredTicks = 0;
+        size_t expiredDeltas = 0;
+        while (expiredTicks < recentTicks.size() && ticks - recentTicks[expiredTicks].tick >= resendAges.back()) {
+            expiredDeltas += recentTicks[expiredTicks++].deltaCount;
+        }
+        recentTicks.erase(recentTicks.begin(), recentTicks.begin() + static_cast<ptrdiff_t>(expiredTicks));
+        recentDeltas.erase(recentDeltas.begin(), recentDeltas.begin() + static_cast<ptrdiff_t>(expiredDeltas));
+    }
+
+    static void writeDelta(Writer& writer, const SyncDelta& delta)
+    {
+        writer.put(static_cast<uint8_t>(delta.type));
+        switch (delta.type) {
+            case SyncDeltaType::GroupActivated:
+            case SyncDeltaType::GroupRefined:
+                writer.put(delta.groupId);
+                break;
+            case SyncDeltaType::DigitRegenerated:
+                writer.put(delta.x);
+                writer.put(delta.y);
+                writer.put(delta.digit);
+                break;
+            case SyncDeltaType::BinCount:
+                writer.put(delta.bin);
+                writer.put(delta.count);
+                break;
+        }
+    }
+
+    void readPacket(const uint8_t* data, size_t size, std::vector<SyncDelta>& applied)
+    {
+        Reader reader(data, size);
+        uint16_t magic = 0;
+        uint8_t version = 0;
+        uint32_t packetSession = 0, sender = 0, packetSequence = 0, packetClock = 0;
+        uint64_t sentMicros = 0;
+        uint16_t count = 0;
+        reader.get(magic);
+        reader.get(version);
+        reader.get(packetSession);
+        reader.get(sender);
+        reader.get(packetSequence);
+        reader.get(packetClock);
+        reader.get(sentMicros);
+        reader.get(count);
+        // Other programs, other grids and our own broadcasts coming back are all dropped quietly
+        if (!reader.ok || magic != packetMagic || version != protocolVersion || packetSession != session || sender == node) {
+            return;
+        }
+
+        stats.packetsReceived++;
+        stats.bytesReceived += size;
+        stats.tickBytesReceived += size;
+
+        Peer* found = findPeer(sender, packetSequence);
+        if (!found) {
+            return;
+        }
+        Peer& peer = *found;
+        peer.lastHeardTick = ticks;
+        if (packetSequence <= peer.lastSequence) {
+            stats.packetsStale++;
+            return;
+        }
+        stats.packetsLost += packetSequence - peer.lastSequence - 1;
+        peer.lastSequence = packetSequence;
+        clock = std::max(clock, packetClock);
+
+        Version written{packetClock, sender};
+        for (uint16_t d = 0; d < count; d++) {
+            uint8_t type = 0;
+            if (!reader.get(type)) {
+                break;
+            }
+            SyncDelta delta;
+            delta.type = static_cast<SyncDeltaType>(type);
+            switch (delta.type) {
+                case SyncDeltaType::GroupActivated:
+                    if (reader.get(delta.groupId) && delta.groupId < groupVersions.size()) {
+                        apply(delta, applied);
+                    }
+                    break;
+                case SyncDeltaType::GroupRefined:
+                    if (reader.get(delta.groupId) && delta.groupId < groupVersions.size()) {
+                        applyRefine(delta, written, applied);
+                    }
+                    break;
+                case SyncDeltaType::DigitRegenerated:
+                    // Digits index the ten digit images, anything else is a corrupt or hostile packet
+                    if (reader.get(delta.x) && reader.get(delta.y) && reader.get(delta.digit) && delta.x < gridSize && delta.y < gridSize &&
+                        delta.digit <= 9) {
+                        auto &current = cellVersions[cellIndex(delta.x, delta.y)];
+                        if (written > current) {
+                            current = written;
+                            apply(delta, applied);
+                        } else if (!(written == current)) {
+                            stats.deltasSuperseded++;
+                        }
+                    }
+                    break;
+                case SyncDeltaType::BinCount:
+                    if (reader.get(delta.bin) && reader.get(delta.count) && delta.bin < binCount) {
+                        peer.binCounts[delta.bin] = delta.count;
+                        stats.deltasApplied++;
+                    }
+                    break;
+                default:
+                    // A newer protocol's delta, the rest of the packet can't be parsed
+                    d = count;
+                    break;
+            }
+        }
+
+        uint64_t now = wallClockMicros();
+        if (stats.tickApplyLatencies.size() < stats.tickApplyLatencies.capacity()) {
+            stats.tickApplyLatencies.push_back(now > sentMicros ? static_cast<double>(now - sentMicros) / 1e6 : 0.0);
+        }
+    }
+
+    // A refine only needs applying the first time a group is refined, or when the refine this kiosk
+    // made itself loses to the remote one and the group's bin count moves to the other kiosk
+    void applyRefine(SyncDelta& delta, const Version& written, std::vector<SyncDelta>& applied)
+    {
+        auto &current = groupVersions[delta.groupId];
+        if (written == current) {
+            // A resend of the refine that was already applied
+            return;
+        }
+        if (!(written > current)) {
+            stats.deltasSuperseded++;
+            return;
+        }
+        bool wasRefined = current.clock != 0;
+        delta.supersedesLocal = wasRefined && current.node == node;
+        current = written;
+        if (!wasRefined || delta.supersedesLocal) {
+            apply(delta, applied);
+        }
+    }
+
+    void apply(const SyncDelta& delta, std::vector<SyncDelta>& applied)
+    {
+        applied.push_back(delta);
+        stats.deltasApplied++;
+    }
+
+    // nullptr once maxPeers kiosks are being heard from
+    Peer* findPeer(uint32_t sender, uint32_t packetSequence)
+    {
+        for (auto &peer : peers) {
+            if (peer.node == sender) {
+                return &peer;
+            }
+        }
+        if (peers.size() >= maxPeers) {
+            LOG_RATE_LIMITED(LogLevel::Warning, 1, "Sync ignoring node %08x, already %zu peers", sender, peers.size());
+            return nullptr;
+        }
+        // A kiosk we haven't heard from starts wherever its sequence is, rather than counting its past as lost
+        LOG_INFO("Sync peer %08x joined", sender);
+        peers.push_back(Peer{sender, packetSequence - 1, ticks});
+        return &peers.back();
+    }
+
+    // Every kiosk sends its bin counts each binResendTicks, so one that has been silent for several of
+    // those has stopped. A restarted kiosk comes back under a new node id, and its old bin counts
+    // mustn't be added in alongside the new ones.
+    void expirePeers()
+    {
+        auto silent = [this](const Peer& peer) {
+            if (ticks - peer.lastHeardTick < peerTimeoutTicks) {
+                return false;
+            }
+            LOG_INFO("Sync peer %08x left", peer.node);
+            return true;
+        };
+        peers.erase(std::remove_if(peers.begin(), peers.end(), silent), peers.end());
+    }
+
+    static constexpr size_t pendingReserve = 1024;
+    static constexpr size_t latenciesReserve = 256;
+    static constexpr size_t peersReserve = 16;
+    static constexpr size_t maxPeers = 64;
+    // About a second at 60 Hz
+    static constexpr uint64_t binResendTicks = 60;
+    static constexpr uint64_t peerTimeoutTicks = 5 * binResendTicks;
+    // Ticks after the first send that refines and digits are sent again, up to two seconds at 60 Hz
+    static constexpr std::array<uint64_t, 3> resendAges{5, 30, 120};
+
+    int fd;
+    std::vector<sockaddr_in> peerAddresses;
+    uint32_t session;
+    uint32_t node = 0;
+    int gridSize;
+
+    uint32_t clock = 0;
+    bool tickHasWrites = false;
+    uint32_t sequence = 0;
+    uint64_t ticks = 0;
+
+    // Only cells whose digit has changed have a version. One for every cell would take as much memory
+    // as the grid, and more than a dataset grid ever keeps resident.
+    std::unordered_map<size_t, Version> cellVersions;
+    std::vector<Version> groupVersions;
+    std::vector<SyncDelta> pending;
+    // Sent in the last resendAges.back() ticks, oldest first
+    std::vector<SyncDelta> recentDeltas;
+    std::vector<SentTick> recentTicks;
+    std::array<uint32_t, binCount> localBinCounts{};
+    std::array<uint32_t, binCount> sentBinCounts{};
+    std::vector<Peer> peers;
+
+    std::array<uint8_t, 2048> packet{};
+    SyncStats stats;
+};
+
+std::shared_ptr<SessionSync> createSessionSync(const std::string& bindAddress, const std::vector<std::string>& peers, uint32_t session,
+                                               int gridSize, size_t groupCount)
+{
+    auto bindTo = parseAddress(bindAddress, "0.0.0.0");
+    if (!bindTo) {
+        LOG_ERROR("Invalid sync address, expected [host:]port: %s", bindAddress.c_str());
+        return nullptr;
+    }
+    std::vector<sockaddr_in> peerAddresses;
+    for (const auto &peer : peers) {
+        auto address = parseAddress(peer, "");
+        if (!address) {
+            LOG_ERROR("Invalid sync peer, expected host:port: %s", peer.c_str());
+            return nullptr;
+        }
+        peerAddresses.push_back(*address);
+    }
+    if (gridSize > 65536) {
+        LOG_ERROR("Sync only supports grids up to 65536 cells wide");
+        return nullptr;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOG_ERROR("Failed to create sync socket: %s", strerror(errno));
+        return nullptr;
+    }
+    // Peers may be a subnet broadcast address
+    int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&*bindTo), sizeof(*bindTo)) < 0) {
+        LOG_ERROR("Failed to bind sync socket to %s: %s", bindAddress.c_str(), strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+
+    LOG_INFO("Syncing on %s", bindAddress.c_str());
+    return std::make_shared<SessionSyncImpl>(fd, std::move(peerAddresses), session, gridSize, groupCount);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Numbers/NumberGrid.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum class SyncDeltaType : uint8_t
+{
+    GroupActivated = 1,  // groupId
+    GroupRefined,        // groupId
+    DigitRegenerated,    // x, y, digit
+    BinCount             // bin, count: groups the sender has refined into the bin
+};
+
+struct SyncDelta
+{
+    SyncDeltaType type = SyncDeltaType::GroupActivated;
+    uint32_t groupId = 0;
+    uint16_t x = 0, y = 0;
+    // 0-9, a received digit delta with anything else is dropped
+    uint8_t digit = 0;
+    uint8_t bin = 0;
+    uint32_t count = 0;
+
+    // GroupRefined: this kiosk had refined the group as well, and the remote refine won
+    bool supersedesLocal = false;
+};
+
+// Cumulative since start, apart from the tick fields which cover the last flush and receive
+struct SyncStats
+{
+    uint64_t packetsSent = 0;
+    uint64_t bytesSent = 0;
+    // Resends included
+    uint64_t deltasSent = 0;
+    uint64_t packetsReceived = 0;
+    uint64_t bytesReceived = 0;
+    uint64_t deltasApplied = 0;
+    // Older than what this kiosk already had, by last-writer-wins. Resends of what it already had
+    // aren't counted.
+    uint64_t deltasSuperseded = 0;
+    // Gaps in a peer's sequence numbers, and packets arriving after a newer one
+    uint64_t packetsLost = 0;
+    uint64_t packetsStale = 0;
+
+    size_t tickBytesSent = 0;
+    size_t tickBytesReceived = 0;
+    // Seconds from a packet being sent to its deltas being applied, by wall clock so kiosks need NTP
+    std::vector<double> tickApplyLatencies;
+};
+
+// Keeps several kiosks on one shared grid. Every kiosk builds the same grid from the shared seed,
+// after which only changes travel, as compact binary deltas over UDP. A tick's deltas are batched
+// into as few datagrams as fit, each carrying the sender's sequence number (to spot loss and
+// reordering) and Lamport clock. Digits and refines are reconciled last-writer-wins on
+// (clock, node id) and sent again a few times over the next two seconds, and bin counts are per
+// kiosk and absolute, resent every second, so a lost packet only delays them. Everything runs on the
+// render thread with non-blocking sockets.
+class SessionSync {
+public:
+    // Queues the grid's changes from this tick, reading regenerated digits back from the grid. Digits
+    // of groups another kiosk refined aren't sent, that kiosk's digits are applied instead.
+    virtual void publish(const std::vector<GridEvent>& events, NumberGrid& numberGrid) = 0;
+    // Groups this kiosk has refined into the bin, sent when it changes
+    virtual void setBinCount(int binIdx, int groupsRefined) = 0;
+    // Sends the tick's deltas
+    virtual void flush() = 0;
+    // Reads every waiting datagram and appends the deltas that win to applied. Bin counts are kept here.
+    virtual void receive(std::vector<SyncDelta>& applied) = 0;
+
+    // Groups the other kiosks have refined into the bin. Kiosks silent for five seconds no longer count.
+    virtual int getRemoteBinCount(int binIdx) const = 0;
+    virtual const SyncStats& getStats() const = 0;
+
+    virtual ~SessionSync() = default;
+};
+
+// Returns nullptr if the socket can't be opened or a peer address is invalid. session identifies
+// the shared grid (seed, size and dataset), so kiosks on a different grid ignore each other.
+std::shared_ptr<SessionSync> createSessionSync(const std::string& bindAddress, const std::vector<std::string>& peers, uint32_t session,
+                                               int gridSize, size_t groupCount);
@@ -0,0 +1,333 @@
+#include "MetricsRegistry.h"
+
+#include "../Profiling/FrameProfiler.h"
+#include "../Rendering/GpuTimer.h"
+#include "../Sync/SessionSync.h"
+#include "Numbers/Number.h"
+
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <dirent.h>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <unistd.h>
+
+namespace
+{
+    // Upper bounds in seconds, picked around the 60 Hz (16.7 ms) and 30 Hz (33.3 ms) budgets
+    constexpr std::array<double, 10> histogramBounds = {0.0005, 0.001, 0.002, 0.004, 0.008, 0.0167, 0.0333, 0.05, 0.1, 0.25};
+
+    // Only the render thread writes, so load + store is enough where there's no atomic add
+    template<typename T>
+    void atomicAdd(std::atomic<T>& value, T amount)
+    {
+        value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    struct Histogram
+    {
+        // Non-cumulative, summed when written out
+        std::array<std::atomic<uint64_t>, histogramBounds.size() + 1> buckets{};
+        std::atomic<double> sum{0.0};
+        std::atomic<uint64_t> count{0};
+
+        void observe(double value)
+        {
+            size_t bucket = 0;
+            while (bucket < histogramBounds.size() && value > histogramBounds[bucket]) {
+                bucket++;
+            }
+            atomicAdd(buckets[bucket], uint64_t(1));
+            atomicAdd(sum, value);
+            atomicAdd(count, uint64_t(1));
+        }
+
+        void write(std::string& out, const char* name, const char* labels) const
+        {
+            // labels may be empty, in which case only the bucket bound is set
+            std::string bucketLabels = *labels ? std::string(labels) + "," : std::string();
+            const char* braceLabels = *labels ? "{" : "";
+            const char* braceEnd = *labels ? "}" : "";
+            char line[256];
+            uint64_t cumulative = 0;
+            for (size_t b = 0; b < buckets.size(); b++) {
+                cumulative += buckets[b].load(std::memory_order_relaxed);
+                if (b < histogramBounds.size()) {
+                    snprintf(line, sizeof(line), "%s_bucket{%sle=\"%g\"} %llu\n", name, bucketLabels.c_str(), histogramBounds[b], static_cast<unsigned long long>(cumulative));
+                } else {
+                    snprintf(line, sizeof(line), "%s_bucket{%sle=\"+Inf\"} %llu\n", name, bucketLabels.c_str(), static_cast<unsigned long long>(cumulative));
+                }
+                out += line;
+            }
+            snprintf(line, sizeof(line), "%s_sum%s%s%s %.9g\n%s_count%s%s%s %llu\n", name, braceLabels, labels, braceEnd, sum.load(std::memory_order_relaxed),
+                     name, braceLabels, labels, braceEnd, static_cast<unsigned long long>(count.load(std::memory_order_relaxed)));
+            out += line;
+        }
+    };
+
+    void writeHeader(std::string& out, const char* name, const char* type, const char* help)
+    {
+        out += "# HELP ";
+        out += name;
+        out += " ";
+        out += help;
+        out += "\n# TYPE ";
+        out += name;
+        out += " ";
+        out += type;
+        out += "\n";
+    }
+
+    void writeValue(std::string& out, const char* name, const char* labels, double value)
+    {
+        char line[256];
+        if (labels) {
+            snprintf(line, sizeof(line), "%s{%s} %.9g\n", name, labels, value);
+        } else {
+            snprintf(line, sizeof(line), "%s %.9g\n", name, value);
+        }
+        out += line;
+    }
+
+    std::optional<double> readResidentBytes()
+    {
+        // statm: total and resident sizes in pages
+        std::ifstream statm("/proc/self/statm");
+        unsigned long long totalPages = 0, residentPages = 0;
+        if (!(statm >> totalPages >> residentPages)) {
+            return std::nullopt;
+        }
+        return static_cast<double>(residentPages) * static_cast<double>(sysconf(_SC_PAGESIZE));
+    }
+
+    // Thermal zones report millidegrees, labelled with the zone's type (e.g. "cpu-thermal" on the Pi)
+    void writeThermalZones(std::string& out)
+    {
+        const char* thermalDir = "/sys/class/thermal";
+        DIR* dir = opendir(thermalDir);
+        if (!dir) {
+            return;
+        }
+        bool headerWritten = false;
+        while (dirent* entry = readdir(dir)) {
+            std::string zone = entry->d_name;
+            if (zone.rfind("thermal_zone", 0) != 0) {
+                continue;
+            }
+            std::string zoneDir = std::string(thermalDir) + "/" + zone;
+            std::ifstream tempFile(zoneDir + "/temp");
+            long milliDegrees = 0;
+            if (!(tempFile >> milliDegrees)) {
+                continue;
+            }
+            std::string type;
+            std::ifstream typeFile(zoneDir + "/type");
+            std::getline(typeFile, type);
+
+            if (!headerWritten) {
+                writeHeader(out, "lumon_thermal_zone_celsius", "gauge", "Temperature reported by each sysfs thermal zone.");
+                headerWritten = true;
+            }
+            std::string labels = "zone=\"" + zone + "\",type=\"" + type + "\"";
+            writeValue(out, "lumon_thermal_zone_celsius", labels.c_str(), milliDegrees / 1000.0);
+        }
+        closedir(dir);
+    }
+}
+
+class MetricsRegistryImpl : public MetricsRegistry
+{
+public:
+    static constexpr size_t stageCount = static_cast<size_t>(FrameStage::Count);
+    static constexpr size_t counterCount = static_cast<size_t>(FrameCounter::Count);
+    static constexpr size_t gpuSpanCount = static_cast<size_t>(GpuSpan::Count);
+
+    void recordFrame(const FrameProfiler& frameProfiler, double deltaSeconds) final
+    {
+        frameHistogram.observe(frameProfiler.getLastFrameTime() / 1000.0);
+        for (size_t s = 0; s < stageCount; s++) {
+            stageHistograms[s].observe(frameProfiler.getLastStageTime(static_cast<FrameStage>(s)) / 1000.0);
+        }
+        for (size_t c = 0; c < counterCount; c++) {
+            lastCounters[c].store(frameProfiler.getLastCounter(static_cast<FrameCounter>(c)), std::memory_order_relaxed);
+        }
+        atomicAdd(frames, uint64_t(1));
+
+        // Smoothed over roughly a second of frames at 60 Hz
+        if (deltaSeconds > 0.0) {
+            smoothedDelta = smoothedDelta > 0.0 ? smoothedDelta + (deltaSeconds - smoothedDelta) * 0.016 : deltaSeconds;
+            fps.store(1.0 / smoothedDelta, std::memory_order_relaxed);
+            atomicAdd(idle.load(std::memory_order_relaxed) ? idleSeconds : activeSeconds, deltaSeconds);
+        }
+    }
+
+    void recordGpuTimes(const GpuTimer& gpuTimer) final
+    {
+        if (gpuTimer.getCompletedFrames() == lastGpuFrame) {
+            return;
+        }
+        lastGpuFrame = gpuTimer.getCompletedFrames();
+        for (size_t s = 0; s < gpuSpanCount; s++) {
+            if (auto gpuTime = gpuTimer.getLastTime(static_cast<GpuSpan>(s))) {
+                gpuHistograms[s].observe(*gpuTime / 1000.0);
+            }
+        }
+    }
+
+    void setIdle(bool isIdle) final
+    {
+        idle.store(isIdle, std::memory_order_relaxed);
+    }
+
+    void setTextureMemory(size_t imageCacheBytes, size_t atlasBytes) final
+    {
+        imageCacheTextureBytes.store(imageCacheBytes, std::memory_order_relaxed);
+        atlasTextureBytes.store(atlasBytes, std::memory_order_relaxed);
+    }
+
+    void setBinMetrics(int binIdx, const BinMetrics& metrics) final
+    {
+        if (binIdx < 0 || binIdx >= binCount) {
+            return;
+        }
+        auto &bin = bins[binIdx];
+        bin.groups.store(metrics.groups, std::memory_order_relaxed);
+        bin.groupsRefined.store(metrics.groupsRefined, std::memory_order_relaxed);
+        bin.refinesStarted.store(metrics.refinesStarted, std::memory_order_relaxed);
+        bin.numbersRefined.store(metrics.numbersRefined, std::memory_order_relaxed);
+    }
+
+    void recordSync(const SyncStats& stats) final
+    {
+        syncEnabled.store(true, std::memory_order_relaxed);
+        syncBytesSent.store(stats.bytesSent, std::memory_order_relaxed);
+        syncBytesReceived.store(stats.bytesReceived, std::memory_order_relaxed);
+        syncPacketsSent.store(stats.packetsSent, std::memory_order_relaxed);
+        syncPacketsReceived.store(stats.packetsReceived, std::memory_order_relaxed);
+        syncPacketsLost.store(stats.packetsLost, std::memory_order_relaxed);
+        syncDeltasApplied.store(stats.deltasApplied, std::memory_order_relaxed);
+        syncDeltasSuperseded.store(stats.deltasSuperseded, std::memory_order_relaxed);
+        for (double latency : stats.tickApplyLatencies) {
+            syncApplyHistogram.observe(latency);
+        }
+    }
+
+    void writePrometheus(std::string& out) const final
+    {
+        char labels[64];
+
+        writeHeader(out, "lumon_frame_seconds", "histogram", "CPU time spent building and submitting each frame.");
+        frameHistogram.write(out, "lumon_frame_seconds", "");
+        writeHeader(out, "lumon_frame_stage_seconds", "histogram", "CPU time spent in each frame stage.");
+        for (size_t s = 0; s < stageCount; s++) {
+            snprintf(labels, sizeof(labels), "stage=\"%s\"", frameStageName(static_cast<FrameStage>(s)));
+            stageHistograms[s].write(out, "lumon_frame_stage_seconds", labels);
+        }
+
+        writeHeader(out, "lumon_gpu_seconds", "histogram", "GPU time of each render pass, from timer queries (empty without timer query support).");
+        for (size_t s = 0; s < gpuSpanCount; s++) {
+            snprintf(labels, sizeof(labels), "span=\"%s\"", gpuSpanName(static_cast<GpuSpan>(s)));
+            gpuHistograms[s].write(out, "lumon_gpu_seconds", labels);
+        }
+
+        writeHeader(out, "lumon_frames_total", "counter", "Frames rendered since start.");
+        writeValue(out, "lumon_frames_total", nullptr, static_cast<double>(frames.load(std::memory_order_relaxed)));
+        writeHeader(out, "lumon_fps", "gauge", "Smoothed frames per second.");
+        writeValue(out, "lumon_fps", nullptr, fps.load(std::memory_order_relaxed));
+
+        writeHeader(out, "lumon_frame_counter", "gauge", "Per-frame counters of the last completed frame.");
+        for (size_t c = 0; c < counterCount; c++) {
+            snprintf(labels, sizeof(labels), "counter=\"%s\"", frameCounterName(static_cast<FrameCounter>(c)));
+            writeValue(out, "lumon_frame_counter", labels, lastCounters[c].load(std::memory_order_relaxed));
+        }
+
+        writeHeader(out, "lumon_texture_bytes", "gauge", "Texture memory held by the image display.");
+        writeValue(out, "lumon_texture_bytes", "pool=\"image_cache\"", static_cast<double>(imageCacheTextureBytes.load(std::memory_order_relaxed)));
+        writeValue(out, "lumon_texture_bytes", "pool=\"atlas\"", static_cast<double>(atlasTextureBytes.load(std::memory_order_relaxed)));
+
+        writeHeader(out, "lumon_idle", "gauge", "1 while the idle screen is shown.");
+        writeValue(out, "lumon_idle", nullptr, idle.load(std::memory_order_relaxed) ? 1.0 : 0.0);
+        writeHeader(out, "lumon_mode_seconds_total", "counter", "Time spent on the idle screen and on the number grid.");
+        writeValue(out, "lumon_mode_seconds_total", "mode=\"idle\"", idleSeconds.load(std::memory_order_relaxed));
+        writeValue(out, "lumon_mode_seconds_total", "mode=\"active\"", activeSeconds.load(std::memory_order_relaxed));
+
+        auto writeBins = [&](const char* name, const char* type, const char* help, auto getValue) {
+            writeHeader(out, name, type, help);
+            for (int b = 0; b < binCount; b++) {
+                snprintf(labels, sizeof(labels), "bin=\"%d\"", b + 1);
+                writeValue(out, name, labels, getValue(bins[b]));
+            }
+        };
+        writeBins("lumon_bin_groups", "gauge", "Bad groups assigned to each bin.", [](const AtomicBin& b) { return b.groups.load(std::memory_order_relaxed); });
+        writeBins("lumon_bin_groups_refined", "gauge", "Bad groups this kiosk has fully refined into each bin, less any another kiosk refined first.", [](const AtomicBin& b) { return b.groupsRefined.load(std::memory_order_relaxed); });
+        writeBins("lumon_bin_refines_started_total", "counter", "Refinements started towards each bin.", [](const AtomicBin& b) { return b.refinesStarted.load(std::memory_order_relaxed); });
+        writeBins("lumon_bin_numbers_refined_total", "counter", "Numbers that have landed in each bin.", [](const AtomicBin& b) { return b.numbersRefined.load(std::memory_order_relaxed); });
+
+        if (syncEnabled.load(std::memory_order_relaxed)) {
+            auto load = [](const std::atomic<uint64_t>& value) { return static_cast<double>(value.load(std::memory_order_relaxed)); };
+            writeHeader(out, "lumon_sync_bytes_total", "counter", "UDP payload bytes exchanged with the other kiosks of a shared session.");
+            writeValue(out, "lumon_sync_bytes_total", "direction=\"sent\"", load(syncBytesSent));
+            writeValue(out, "lumon_sync_bytes_total", "direction=\"received\"", load(syncBytesReceived));
+            writeHeader(out, "lumon_sync_packets_total", "counter", "Sync datagrams sent, received, and missing from peers' sequence numbers.");
+            writeValue(out, "lumon_sync_packets_total", "direction=\"sent\"", load(syncPacketsSent));
+            writeValue(out, "lumon_sync_packets_total", "direction=\"received\"", load(syncPacketsReceived));
+            writeValue(out, "lumon_sync_packets_total", "direction=\"lost\"", load(syncPacketsLost));
+            writeHeader(out, "lumon_sync_deltas_total", "counter", "Remote deltas applied, and dropped as older than local state.");
+            writeValue(out, "lumon_sync_deltas_total", "result=\"applied\"", load(syncDeltasApplied));
+            writeValue(out, "lumon_sync_deltas_total", "result=\"superseded\"", load(syncDeltasSuperseded));
+            writeHeader(out, "lumon_sync_apply_latency_seconds", "histogram", "Time from a peer sending a packet to its deltas being applied here.");
+            syncApplyHistogram.write(out, "lumon_sync_apply_latency_seconds", "");
+        }
+
+        // Sampled at scrape time, off the render thread
+        if (auto residentBytes = readResidentBytes()) {
+            writeHeader(out, "lumon_process_resident_bytes", "gauge", "Resident set size of the process.");
+            writeValue(out, "lumon_process_resident_bytes", nullptr, *residentBytes);
+        }
+        writeThermalZones(out);
+    }
+
+private:
+    struct AtomicBin
+    {
+        std::atomic<int> groups{0};
+        std::atomic<int> groupsRefined{0};
+        std::atomic<int> refinesStarted{0};
+        std::atomic<int> numbersRefined{0};
+    };
+
+    Histogram frameHistogram;
+    std::array<Histogram, stageCount> stageHistograms;
+    std::array<Histogram, gpuSpanCount> gpuHistograms;
+    uint64_t lastGpuFrame = 0;
+    std::array<std::atomic<double>, counterCount> lastCounters{};
+    std::atomic<uint64_t> frames{0};
+    std::atomic<double> fps{0.0};
+    double smoothedDelta = 0.0;
+
+    std::atomic<bool> idle{false};
+    std::atomic<double> idleSeconds{0.0};
+    std::atomic<double> activeSeconds{0.0};
+
+    std::atomic<size_t> imageCacheTextureBytes{0};
+    std::atomic<size_t> atlasTextureBytes{0};
+
+    std::array<AtomicBin, binCount> bins;
+
+    std::atomic<bool> syncEnabled{false};
+    std::atomic<uint64_t> syncBytesSent{0};
+    std::atomic<uint64_t> syncBytesReceived{0};
+    std::atomic<uint64_t> syncPacketsSent{0};
+    std::atomic<uint64_t> syncPacketsReceived{0};
+    std::atomic<uint64_t> syncPacketsLost{0};
+    std::atomic<uint64_t> syncDeltasApplied{0};
+    std::atomic<uint64_t> syncDeltasSuperseded{0};
+    Histogram syncApplyHistogram;
+};
+
+std::shared_ptr<MetricsRegistry> createMetricsRegistry()
+{
+    return std::make_shared<MetricsRegistryImpl>();
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+class FrameProfiler;
+class GpuTimer;
+struct SyncStats;
+
+// Refinement progress of one bin
+struct BinMetrics
+{
+    int groups = 0;
+    // Drops again when a refine made here loses to another kiosk's refine of the same group
+    int groupsRefined = 0;
+    int refinesStarted = 0;
+    int numbersRefined = 0;
+};
+
+// Telemetry published by the render thread and scraped by the metrics server thread.
+// Values are held in relaxed atomics with the render thread as the only writer, so publishing
+// never takes a lock; a scrape may see one frame's update half applied, which Prometheus tolerates.
+class MetricsRegistry {
+public:
+    // Render thread, after the frame has ended in the profiler
+    virtual void recordFrame(const FrameProfiler& frameProfiler, double deltaSeconds) = 0;
+    // Observes each GPU span once per frame read back from the timer queries
+    virtual void recordGpuTimes(const GpuTimer& gpuTimer) = 0;
+    virtual void setIdle(bool idle) = 0;
+    virtual void setTextureMemory(size_t imageCacheBytes, size_t atlasBytes) = 0;
+    virtual void setBinMetrics(int binIdx, const BinMetrics& metrics) = 0;
+    // Copies the shared session's totals and observes the tick's apply latencies
+    virtual void recordSync(const SyncStats& stats) = 0;
+
+    // Any thread, appends the Prometheus text exposition of everything recorded so far
+    virtual void writePrometheus(std::string& out) const = 0;
+
+    virtual ~MetricsRegistry() = default;
+};
+
+std::shared_ptr<MetricsRegistry> createMetricsRegistry();
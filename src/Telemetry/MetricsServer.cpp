@@ -0,0 +1,177 @@
+#include "MetricsServer.h"
+
+#include "MetricsRegistry.h"
+#include "../Profiling/AllocationTracker.h"
+#include "Log.h"
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+class MetricsServerImpl : public MetricsServer
+{
+public:
+    MetricsServerImpl(int listenFd, std::string socketPath, std::shared_ptr<const MetricsRegistry> registry)
+        : listenFd(listenFd), socketPath(std::move(socketPath)), registry(std::move(registry))
+    {
+        thread = std::thread([this] {
+            setThreadAllocationTracking(false);
+            serveLoop();
+        });
+    }
+
+    ~MetricsServerImpl() override
+    {
+        stopping.store(true, std::memory_order_relaxed);
+        thread.join();
+        close(listenFd);
+        if (!socketPath.empty()) {
+            unlink(socketPath.c_str());
+        }
+    }
+
+private:
+    void serveLoop()
+    {
+        std::string body;
+        std::string response;
+        while (!stopping.load(std::memory_order_relaxed)) {
+            // Wake up regularly to notice shutdown
+            pollfd listenPoll{listenFd, POLLIN, 0};
+            if (poll(&listenPoll, 1, pollIntervalMs) <= 0) {
+                continue;
+            }
+            int clientFd = accept(listenFd, nullptr, nullptr);
+            if (clientFd < 0) {
+                continue;
+            }
+
+            // Every path gets the metrics, so only wait for the request line to arrive before answering
+            char request[1024];
+            pollfd clientPoll{clientFd, POLLIN, 0};
+            bool isHttp = false;
+            if (poll(&clientPoll, 1, clientTimeoutMs) > 0) {
+                ssize_t received = recv(clientFd, request, sizeof(request) - 1, 0);
+                isHttp = received > 0 && strncmp(request, "GET ", 4) == 0;
+            }
+
+            body.clear();
+            registry->writePrometheus(body);
+            response.clear();
+            if (isHttp) {
+                response += "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nConnection: close\r\nContent-Length: ";
+                response += std::to_string(body.size());
+                response += "\r\n\r\n";
+            }
+            response += body;
+            sendAll(clientFd, response);
+            close(clientFd);
+        }
+    }
+
+    static void sendAll(int fd, const std::string& data)
+    {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return;
+            }
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    static constexpr int pollIntervalMs = 200;
+    static constexpr int clientTimeoutMs = 500;
+
+    int listenFd;
+    std::string socketPath;
+    std::shared_ptr<const MetricsRegistry> registry;
+    std::atomic<bool> stopping{false};
+    std::thread thread;
+};
+
+namespace
+{
+    int openUnixSocket(const std::string& path)
+    {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path)) {
+            LOG_ERROR("Metrics socket path is too long: %s", path.c_str());
+            return -1;
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+        // A previous run that didn't shut down cleanly leaves the socket file behind
+        unlink(path.c_str());
+        if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 4) < 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    int openLoopbackSocket(const std::string& hostPort)
+    {
+        // Only the loopback interface, the endpoint is for a local scraper or an SSH tunnel
+        std::string host = "127.0.0.1";
+        std::string port = hostPort;
+        if (auto colon = hostPort.rfind(':'); colon != std::string::npos) {
+            host = hostPort.substr(0, colon);
+            port = hostPort.substr(colon + 1);
+        }
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(std::atoi(port.c_str())));
+        if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1 || address.sin_addr.s_addr != htonl(INADDR_LOOPBACK)) {
+            LOG_ERROR("Metrics endpoint must be on 127.0.0.1: %s", hostPort.c_str());
+            return -1;
+        }
+
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            return -1;
+        }
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, 4) < 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+}
+
+std::shared_ptr<MetricsServer> createMetricsServer(const std::string& address, std::shared_ptr<const MetricsRegistry> registry)
+{
+    const std::string unixPrefix = "unix:";
+    std::string socketPath;
+    int fd;
+    if (address.rfind(unixPrefix, 0) == 0) {
+        socketPath = address.substr(unixPrefix.size());
+        fd = openUnixSocket(socketPath);
+    } else {
+        fd = openLoopbackSocket(address);
+    }
+    if (fd < 0) {
+        LOG_ERROR("Failed to open metrics endpoint %s: %s", address.c_str(), strerror(errno));
+        return nullptr;
+    }
+
+    LOG_INFO("Serving metrics on %s", address.c_str());
+    return std::make_shared<MetricsServerImpl>(fd, std::move(socketPath), std::move(registry));
+}
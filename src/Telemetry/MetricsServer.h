@@ -0,0 +1,17 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+class MetricsRegistry;
+
+// Serves the registry in Prometheus text format over HTTP from its own thread.
+// Stops and closes the socket on destruction.
+class MetricsServer {
+public:
+    virtual ~MetricsServer() = default;
+};
+
+// address is "unix:/path/to.sock" or a port on the loopback interface ("9464" or "127.0.0.1:9464").
+// Returns nullptr if the socket can't be opened.
+std::shared_ptr<MetricsServer> createMetricsServer(const std::string& address, std::shared_ptr<const MetricsRegistry> registry);
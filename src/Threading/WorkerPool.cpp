@@ -0,0 +1,131 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkerPoolImpl : public WorkerPool
+{
+public:
+    explicit WorkerPoolImpl(int threadCount)
+    {
+        for (int i = 1; i < threadCount; i++) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~WorkerPoolImpl() override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeWorkers.notify_all();
+        for (auto &worker : workers) {
+            worker.join();
+        }
+    }
+
+    void run(int taskCount, TaskFn task, void* context) final
+    {
+        if (taskCount <= 0) {
+            return;
+        }
+        if (workers.empty() || taskCount == 1) {
+            for (int i = 0; i < taskCount; i++) {
+                task(context, i);
+            }
+            return;
+        }
+
+        uint64_t round;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            currentTask = task;
+            currentContext = context;
+            totalTasks = taskCount;
+            round = ++generation;
+            nextClaim.store(round << 32, std::memory_order_relaxed);
+            remainingTasks.store(taskCount, std::memory_order_relaxed);
+        }
+        wakeWorkers.notify_all();
+
+        runTasks(round, task, context, taskCount);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        allDone.wait(lock, [this] { return remainingTasks.load(std::memory_order_acquire) == 0; });
+    }
+
+    int getThreadCount() const final
+    {
+        return static_cast<int>(workers.size()) + 1;
+    }
+
+private:
+    void workerLoop()
+    {
+        uint64_t seenGeneration = 0;
+        for (;;) {
+            TaskFn task;
+            void* context;
+            int taskCount;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeWorkers.wait(lock, [&] { return stopping || generation != seenGeneration; });
+                if (stopping) {
+                    return;
+                }
+                seenGeneration = generation;
+                task = currentTask;
+                context = currentContext;
+                taskCount = totalTasks;
+            }
+            runTasks(seenGeneration, task, context, taskCount);
+        }
+    }
+
+    // A worker can wake after its round has already finished and the next one started, so tasks are
+    // claimed together with the round they belong to and a stale worker finds nothing left to claim
+    void runTasks(uint64_t round, TaskFn task, void* context, int taskCount)
+    {
+        for (;;) {
+            uint64_t claim = nextClaim.load(std::memory_order_relaxed);
+            int i;
+            do {
+                i = static_cast<int>(claim & 0xffffffffu);
+                if ((claim >> 32) != (round & 0xffffffffu) || i >= taskCount) {
+                    return;
+                }
+            } while (!nextClaim.compare_exchange_weak(claim, claim + 1, std::memory_order_relaxed));
+
+            task(context, i);
+            if (remainingTasks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(mutex);
+                allDone.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable allDone;
+    bool stopping = false;
+    uint64_t generation = 0;
+
+    TaskFn currentTask = nullptr;
+    void* currentContext = nullptr;
+    int totalTasks = 0;
+    // Low 32 bits of the round's generation, then the next task index
+    std::atomic<uint64_t> nextClaim{0};
+    std::atomic<int> remainingTasks{0};
+};
+
+std::shared_ptr<WorkerPool> createWorkerPool(int threadCount)
+{
+    return std::make_shared<WorkerPoolImpl>(std::max(threadCount, 1));
+}
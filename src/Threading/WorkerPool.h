@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+
+// Fixed set of worker threads for splitting per-frame work into independent tasks
+class WorkerPool {
+public:
+    using TaskFn = void (*)(void* context, int taskIdx);
+
+    // Runs task(context, i) for every i in [0, taskCount) and returns once all have finished.
+    // The calling thread takes tasks too.
+    virtual void run(int taskCount, TaskFn task, void* context) = 0;
+
+    // Worker threads plus the calling thread
+    virtual int getThreadCount() const = 0;
+
+    virtual ~WorkerPool() = default;
+};
+
+// Parallel for over [0, taskCount) without wrapping the callable in a std::function
+template <typename Fn>
+void parallelFor(WorkerPool& pool, int taskCount, Fn&& fn)
+{
+    pool.run(taskCount, [](void* context, int taskIdx) { (*static_cast<std::remove_reference_t<Fn>*>(context))(taskIdx); }, &fn);
+}
+
+// A thread count of 1 runs everything on the calling thread
+std::shared_ptr<WorkerPool> createWorkerPool(int threadCount);
@@ -0,0 +1,108 @@
+#include "RefineAnimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+class RefineAnimatorImpl : public RefineAnimator
+{
+public:
+    void add(int x, int y, uint32_t groupId, int binIdx, const ImVec2& startPos, float scale) final
+    {
+        tweens.posX.push_back(startPos.x);
+        tweens.posY.push_back(startPos.y);
+        tweens.binIdx.push_back(static_cast<uint8_t>(std::clamp(binIdx, 0, binCount - 1)));
+        tweens.numberX.push_back(x);
+        tweens.numberY.push_back(y);
+        tweens.groupId.push_back(groupId);
+        tweens.scale.push_back(scale);
+        arrived.push_back(0);
+    }
+
+    const std::vector<RefineCompletion>& advance(const std::array<ImVec2, binCount>& binPositions, float speed) final
+    {
+        completions.clear();
+        size_t count = tweens.size();
+
+        std::array<float, binCount> binX{}, binY{};
+        for (int b = 0; b < binCount; b++) {
+            binX[b] = binPositions[b].x;
+            binY[b] = binPositions[b].y;
+        }
+
+        // Branch-free step towards the bin; numbers within one step of it are flagged as arrived
+        float* posX = tweens.posX.data();
+        float* posY = tweens.posY.data();
+        const uint8_t* bins = tweens.binIdx.data();
+        uint8_t* done = arrived.data();
+        for (size_t i = 0; i < count; i++) {
+            float distX = binX[bins[i]] - posX[i];
+            float distY = binY[bins[i]] - posY[i];
+            float distance = std::sqrt(distX * distX + distY * distY);
+            float step = distance > speed ? speed / distance : 0.f;
+            posX[i] += distX * step;
+            posY[i] += distY * step;
+            done[i] = distance <= speed;
+        }
+
+        // Swap-remove arrivals and report them
+        receivingBins = 0;
+        for (size_t i = 0; i < count; ) {
+            if (!arrived[i]) {
+                receivingBins |= 1u << tweens.binIdx[i];
+                i++;
+                continue;
+            }
+            completions.push_back(RefineCompletion{tweens.numberX[i], tweens.numberY[i], tweens.groupId[i], tweens.binIdx[i]});
+            count--;
+            moveTween(count, i);
+        }
+        resize(count);
+
+        return completions;
+    }
+
+    const RefineTweens& getTweens() const final
+    {
+        return tweens;
+    }
+
+    uint32_t getReceivingBins() const final
+    {
+        return receivingBins;
+    }
+
+private:
+    void moveTween(size_t from, size_t to)
+    {
+        tweens.posX[to] = tweens.posX[from];
+        tweens.posY[to] = tweens.posY[from];
+        tweens.binIdx[to] = tweens.binIdx[from];
+        tweens.numberX[to] = tweens.numberX[from];
+        tweens.numberY[to] = tweens.numberY[from];
+        tweens.groupId[to] = tweens.groupId[from];
+        tweens.scale[to] = tweens.scale[from];
+        arrived[to] = arrived[from];
+    }
+
+    void resize(size_t count)
+    {
+        tweens.posX.resize(count);
+        tweens.posY.resize(count);
+        tweens.binIdx.resize(count);
+        tweens.numberX.resize(count);
+        tweens.numberY.resize(count);
+        tweens.groupId.resize(count);
+        tweens.scale.resize(count);
+        arrived.resize(count);
+    }
+
+    RefineTweens tweens;
+    std::vector<uint8_t> arrived;
+    std::vector<RefineCompletion> completions;
+    uint32_t receivingBins = 0;
+};
+
+std::shared_ptr<RefineAnimator> createRefineAnimator()
+{
+    return std::make_shared<RefineAnimatorImpl>();
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Numbers/Number.h"
+
+#include <imgui.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// A refined number that has reached its bin
+struct RefineCompletion
+{
+    int x, y;
+    uint32_t groupId;
+    int binIdx;
+};
+
+// In-flight refined numbers, stored as parallel arrays so they advance in one tight pass
+struct RefineTweens
+{
+    std::vector<float> posX, posY;
+    std::vector<uint8_t> binIdx;
+    std::vector<int> numberX, numberY;
+    std::vector<uint32_t> groupId;
+    // Panel scale of the view the number was refined from, so it keeps its size on the way
+    std::vector<float> scale;
+
+    size_t size() const { return posX.size(); }
+};
+
+// Moves refined numbers towards their bins independently of the grid draw, cost scales with numbers in flight
+class RefineAnimator {
+public:
+    virtual void add(int x, int y, uint32_t groupId, int binIdx, const ImVec2& startPos, float scale) = 0;
+
+    // Steps every in-flight number and returns those that arrived this step
+    virtual const std::vector<RefineCompletion>& advance(const std::array<ImVec2, binCount>& binPositions, float speed) = 0;
+
+    virtual const RefineTweens& getTweens() const = 0;
+
+    // Bit per bin that still has numbers heading into it
+    virtual uint32_t getReceivingBins() const = 0;
+
+    virtual ~RefineAnimator() = default;
+};
+
+std::shared_ptr<RefineAnimator> createRefineAnimator();
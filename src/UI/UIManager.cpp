@@ -3,10 +3,18 @@
 #include "Image/ImageDisplay.h"
 #include "Widgets/IdleScreen.h"
 #include "Widgets/NumbersPanel.h"
+#include "../LaunchOptions.h"
+#include "../Control/ControlCommand.h"
+#include "../Memory/PersistentPool.h"
+#include "../Memory/ScratchArena.h"
+#include "../Profiling/FrameProfiler.h"
+#include "../Telemetry/MetricsRegistry.h"
 
 #include "imgui.h"
 #include "backends/imgui_impl_glfw.h"
 #include "backends/imgui_impl_opengl3.h"
+#include "../Rendering/GL.h"
+#define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
 namespace ColorValues
@@ -17,11 +25,10 @@ namespace ColorValues
 class UIManagerImpl : public UIManager
 {
 public:
-    UIManagerImpl()
+    UIManagerImpl(std::shared_ptr<ImageDisplay> imageDisplay, std::shared_ptr<ScratchArena> scratchArena, std::shared_ptr<NumbersPanel> numbersPanel)
+        : scratchArena(std::move(scratchArena)), imageDisplay(std::move(imageDisplay)), numbersPanel(std::move(numbersPanel))
     {
-        imageDisplay = createImageDisplay("./assets/");
-        numbersPanel = createNumbersPanel(imageDisplay);
-        idleScreen = createIdleScreen(imageDisplay);
+        idleScreen = createIdleScreen(this->imageDisplay);
         idleTimeoutEnabled = true;
         idleTimeoutSeconds = 120.0f;
         timeSinceLastActivity = 0.0f;
@@ -30,15 +37,23 @@ public:
         lastIdleMousePos = ImVec2(0, 0);
     }
 
-    void init() final {
+    void init(GLFWwindow* window) final {
         // Initialize ImGui
         IMGUI_CHECKVERSION();
+        installImGuiPool(*imguiPool);
         ImGui::CreateContext();
         ImGui::StyleColorsDark();
 
+        // Every window is placed each frame, so there's no layout worth keeping in imgui.ini
+        // (and saving it allocates in the middle of an otherwise steady frame)
+        ImGui::GetIO().IniFilename = nullptr;
+
         // Initialize ImGui backends
-        ImGui_ImplGlfw_InitForOpenGL(glfwGetCurrentContext(), true);
-        ImGui_ImplOpenGL3_Init("#version 130");
+        platformBackend = window != nullptr;
+        if (platformBackend) {
+            ImGui_ImplGlfw_InitForOpenGL(window, true);
+        }
+        ImGui_ImplOpenGL3_Init(imguiGlslVersion);
 
         // Now that ImGui is initialized, we can safely get the mouse position
         lastMousePos = ImGui::GetMousePos();
@@ -47,6 +62,12 @@ public:
         numbersPanel->init();
     }
 
+    void newFrame() final
+    {
+        scratchArena->reset();
+        ImGui::NewFrame();
+    }
+
     void update() final
     {
         // Toggle settings mode with 'TAB'
@@ -139,19 +160,74 @@ public:
     void cleanup() final {
         // Cleanup ImGui
         ImGui_ImplOpenGL3_Shutdown();
-        ImGui_ImplGlfw_Shutdown();
+        if (platformBackend) {
+            ImGui_ImplGlfw_Shutdown();
+        }
         ImGui::DestroyContext();
     }
 
+    std::string handleCommand(const ControlCommand& command) final
+    {
+        switch (command.type) {
+            case ControlCommandType::Hover:
+                // Picked up by this frame's NewFrame like a real mouse move
+                ImGui::GetIO().AddMousePosEvent(command.x, command.y);
+                return "ok";
+            case ControlCommandType::SetIdle:
+            case ControlCommandType::ToggleIdle:
+                setIdleMode(command.type == ControlCommandType::ToggleIdle ? !idleMode : command.idle);
+                return "ok";
+            case ControlCommandType::DumpState:
+                return std::string("{\"idle\":") + (idleMode ? "true" : "false") + ",\"settings\":" + (settingsMode ? "true" : "false")
+                       + ",\"panel\":" + numbersPanel->handleCommand(command) + "}";
+            default:
+                return numbersPanel->handleCommand(command);
+        }
+    }
+
+    void publishMetrics(MetricsRegistry& metrics) const final
+    {
+        metrics.setIdle(idleMode);
+        auto [imageCacheBytes, atlasBytes] = imageDisplay->getTextureBytes();
+        metrics.setTextureMemory(imageCacheBytes, atlasBytes);
+        numbersPanel->publishMetrics(metrics);
+    }
+
+    void addMemoryCounters(FrameProfiler& frameProfiler) const final
+    {
+        frameProfiler.addCounter(FrameCounter::ScratchBytes, static_cast<double>(scratchArena->getUsedBytes()));
+        frameProfiler.addCounter(FrameCounter::ImGuiPoolBytes, static_cast<double>(imguiPool->getReservedBytes()));
+    }
+
 private:
+    // Same transitions as the right click toggle and the mouse wake-up in update()
+    void setIdleMode(bool idle)
+    {
+        if (idle == idleMode) {
+            return;
+        }
+        idleMode = idle;
+        resetIdleTimer();
+        if (idleMode) {
+            lastIdleMousePos = ImGui::GetMousePos();
+        } else {
+            numbersPanel->triggerLoadAnimation();
+        }
+    }
+
     void resetIdleTimer() {
         timeSinceLastActivity = 0.0f;
     }
 
+    // Declared first so it outlives everything that might still hand memory back to ImGui
+    std::shared_ptr<PersistentPool> imguiPool = createPersistentPool();
+    std::shared_ptr<ScratchArena> scratchArena;
+
     std::shared_ptr<ImageDisplay> imageDisplay;
     std::shared_ptr<NumbersPanel> numbersPanel;
     std::shared_ptr<IdleScreen> idleScreen;
 
+    bool platformBackend = false;
     bool settingsMode = false;
     bool idleMode = false;
     
@@ -163,7 +239,13 @@ private:
     ImVec2 lastIdleMousePos;     // Used for detecting movement in idle mode
 };
 
-std::shared_ptr<UIManager> createUIManager()
+std::shared_ptr<UIManager> createUIManager(const LaunchOptions& options, const std::shared_ptr<FrameProfiler>& frameProfiler, const std::shared_ptr<GpuTimer>& gpuTimer)
 {
-    return std::make_shared<UIManagerImpl>();
+    auto imageDisplay = createImageDisplay("./assets/");
+    auto scratchArena = createScratchArena(options.scratchArenaBytes);
+    auto numbersPanel = createNumbersPanel(imageDisplay, frameProfiler, gpuTimer, scratchArena, options);
+    if (!numbersPanel) {
+        return nullptr;
+    }
+    return std::make_shared<UIManagerImpl>(std::move(imageDisplay), std::move(scratchArena), std::move(numbersPanel));
 }
\ No newline at end of file
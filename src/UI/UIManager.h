@@ -1,6 +1,14 @@
 #pragma once
 #include <imgui.h>
 #include <memory>
+#include <string>
+
+class FrameProfiler;
+class GpuTimer;
+struct ControlCommand;
+class MetricsRegistry;
+struct GLFWwindow;
+struct LaunchOptions;
 
 #ifndef GLOBALS_H
 #define GLOBALS_H
@@ -12,12 +20,26 @@ namespace ColorValues
 
 class UIManager {
 public:
-    virtual void init() = 0;
+    // Without a window (headless) the caller feeds display size, timing and input to ImGui itself
+    virtual void init(GLFWwindow* window) = 0;
+    // Frees the last frame's scratch memory, then starts the ImGui frame
+    virtual void newFrame() = 0;
     virtual void draw() = 0;
     virtual void update() = 0;
     virtual void cleanup() = 0;
 
+    // Applies a control request between frames and returns its one-line reply
+    virtual std::string handleCommand(const ControlCommand& command) = 0;
+
+    // Copies idle state, texture memory and bin progress into the registry, once per frame
+    virtual void publishMetrics(MetricsRegistry& metrics) const = 0;
+
+    // Scratch arena and ImGui pool usage for the frame being profiled
+    virtual void addMemoryCounters(FrameProfiler& frameProfiler) const = 0;
+
     virtual ~UIManager() = default;
 };
 
-std::shared_ptr<UIManager> createUIManager();
\ No newline at end of file
+// Needs a current GL context for the GPU timer's queries. Returns nullptr if the number grid can't be
+// loaded.
+std::shared_ptr<UIManager> createUIManager(const LaunchOptions& options, const std::shared_ptr<FrameProfiler>& frameProfiler, const std::shared_ptr<GpuTimer>& gpuTimer);
\ No newline at end of file
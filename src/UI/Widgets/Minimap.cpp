@@ -0,0 +1,220 @@
+#include "Minimap.h"
+
+#include "Log.h"
+#include "../UIManager.h"
+#include "../../Rendering/GL.h"
+
+#include <algorithm>
+#include <cstdint>
+
+class MinimapImpl : public Minimap
+{
+public:
+    MinimapImpl(std::shared_ptr<NumberGrid> numberGrid, int maxTexels) : numberGrid(std::move(numberGrid))
+    {
+        gridSize = this->numberGrid->getGridSize();
+        // Chunks line up with the grid's count blocks, so a dataset grid can give their counts
+        // without paging in its cells
+        int countBlock = this->numberGrid->getBadCellCountBlock();
+        chunkSize = std::max(1, (gridSize + maxTexels - 1) / maxTexels);
+        chunkSize = (chunkSize + countBlock - 1) / countBlock * countBlock;
+        texelsPerSide = (gridSize + chunkSize - 1) / chunkSize;
+        chunks.resize(static_cast<size_t>(texelsPerSide) * texelsPerSide);
+        texels.resize(chunks.size());
+        dirtyRows.resize(texelsPerSide, DirtySpan{texelsPerSide, -1});
+
+        // The only full count, from here on chunks follow the grid's events
+        std::vector<int> badCells;
+        this->numberGrid->countBadCells(chunkSize, badCells);
+        for (int tx = 0; tx < texelsPerSide; tx++) {
+            for (int ty = 0; ty < texelsPerSide; ty++) {
+                chunks[texelIndex(tx, ty)].badCells = badCells[static_cast<size_t>(tx) * texelsPerSide + ty];
+            }
+        }
+        for (int ty = 0; ty < texelsPerSide; ty++) {
+            for (int tx = 0; tx < texelsPerSide; tx++) {
+                texels[texelIndex(tx, ty)] = texelColour(tx, ty);
+            }
+        }
+        activeGroups.reserve(16);
+        for (const auto &group : this->numberGrid->getBadGroups()) {
+            if (group.isActive) {
+                activeGroups.push_back(group.id);
+            }
+        }
+
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texelsPerSide, texelsPerSide, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+        LOG_DEBUG("Minimap texture %dx%d, %d cell(s) per texel side", texelsPerSide, texelsPerSide, chunkSize);
+    }
+
+    ~MinimapImpl() override
+    {
+        glDeleteTextures(1, &texture);
+    }
+
+    void applyEvents(const std::vector<GridEvent>& events) final
+    {
+        for (const auto &event : events) {
+            switch (event.type) {
+                case GridEventType::GroupActivated:
+                    activeGroups.push_back(event.groupId);
+                    break;
+                case GridEventType::GroupDeactivated:
+                case GridEventType::GroupRefined:
+                    activeGroups.erase(std::remove(activeGroups.begin(), activeGroups.end(), event.groupId), activeGroups.end());
+                    break;
+                case GridEventType::NumberRegenerated: {
+                    // Refined numbers count as bad until they land in their bin and regenerate
+                    auto &chunk = chunkAt(event.x, event.y);
+                    if (event.groupId != NoBadGroup) {
+                        chunk.badCells--;
+                        chunk.refinedCells++;
+                    }
+                    markDirty(event.x / chunkSize, event.y / chunkSize);
+                    break;
+                }
+            }
+        }
+    }
+
+    void draw(ImDrawList* drawList, const ImVec2& min, const ImVec2& max, const std::vector<GridRect>& viewports, size_t focused) final
+    {
+        uploadDirtyTexels();
+        drawMin = min;
+        drawMax = max;
+
+        drawList->AddImage((ImTextureID)(intptr_t)texture, min, max);
+        for (uint32_t id : activeGroups) {
+            if (auto group = numberGrid->getBadGroup(id)) {
+                drawList->AddRect(toScreen(group->bounds.minX, group->bounds.minY), toScreen(group->bounds.maxX, group->bounds.maxY), activeColour);
+            }
+        }
+        for (size_t v = 0; v < viewports.size(); v++) {
+            const auto &viewport = viewports[v];
+            if (!viewport.empty()) {
+                drawList->AddRect(toScreen(viewport.minX, viewport.minY), toScreen(viewport.maxX, viewport.maxY), v == focused ? viewportColour : otherViewportColour, 0.f, 0, 2.f);
+            }
+        }
+        drawList->AddRect(min, max, ColorValues::lumonBlue);
+    }
+
+    ImVec2 toGridPosition(const ImVec2& screenPos) const final
+    {
+        float cellsPerPixelX = static_cast<float>(gridSize) / std::max(drawMax.x - drawMin.x, 1.f);
+        float cellsPerPixelY = static_cast<float>(gridSize) / std::max(drawMax.y - drawMin.y, 1.f);
+        return ImVec2((screenPos.x - drawMin.x) * cellsPerPixelX, (screenPos.y - drawMin.y) * cellsPerPixelY);
+    }
+
+private:
+    struct Chunk
+    {
+        int badCells = 0;
+        int refinedCells = 0;
+    };
+
+    // Columns of a texel row changed since the last upload
+    struct DirtySpan
+    {
+        int minX;
+        int maxX;
+    };
+
+    Chunk& chunkAt(int x, int y)
+    {
+        return chunks[texelIndex(x / chunkSize, y / chunkSize)];
+    }
+
+    size_t texelIndex(int tx, int ty) const
+    {
+        return static_cast<size_t>(ty) * texelsPerSide + tx;
+    }
+
+    ImVec2 toScreen(int x, int y) const
+    {
+        return ImVec2(drawMin.x + (drawMax.x - drawMin.x) * x / gridSize, drawMin.y + (drawMax.y - drawMin.y) * y / gridSize);
+    }
+
+    void markDirty(int tx, int ty)
+    {
+        auto &span = dirtyRows[ty];
+        span.minX = std::min(span.minX, tx);
+        span.maxX = std::max(span.maxX, tx);
+        texels[texelIndex(tx, ty)] = texelColour(tx, ty);
+        anyDirty = true;
+    }
+
+    // One glTexSubImage2D per changed row, covering just the changed columns
+    void uploadDirtyTexels()
+    {
+        if (!anyDirty) {
+            return;
+        }
+        glBindTexture(GL_TEXTURE_2D, texture);
+        for (int ty = 0; ty < texelsPerSide; ty++) {
+            auto &span = dirtyRows[ty];
+            if (span.maxX < span.minX) {
+                continue;
+            }
+            glTexSubImage2D(GL_TEXTURE_2D, 0, span.minX, ty, span.maxX - span.minX + 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &texels[texelIndex(span.minX, ty)]);
+            span = DirtySpan{texelsPerSide, -1};
+        }
+        anyDirty = false;
+    }
+
+    // Dark where the chunk is clear, tinted as its numbers get refined, bright blue for what's left to find
+    uint32_t texelColour(int tx, int ty) const
+    {
+        const auto &chunk = chunks[texelIndex(tx, ty)];
+        int width = std::min(chunkSize, gridSize - tx * chunkSize);
+        int height = std::min(chunkSize, gridSize - ty * chunkSize);
+        float cells = static_cast<float>(width * height);
+
+        ImVec4 colour = backgroundColour;
+        auto blend = [&](const ImVec4& target, float amount) {
+            colour.x += (target.x - colour.x) * amount;
+            colour.y += (target.y - colour.y) * amount;
+            colour.z += (target.z - colour.z) * amount;
+            colour.w += (target.w - colour.w) * amount;
+        };
+        blend(refinedColour, std::min(chunk.refinedCells / cells, 1.f));
+        if (chunk.badCells > 0) {
+            blend(ColorValues::lumonBlue.Value, 0.3f + 0.7f * std::min(chunk.badCells / cells, 1.f));
+        }
+        // RGBA in memory order, the same packing as ImU32
+        return ImGui::ColorConvertFloat4ToU32(colour);
+    }
+
+    static constexpr ImVec4 backgroundColour = ImVec4(0.f, 0.08f, 0.12f, 0.8f);
+    static constexpr ImVec4 refinedColour = ImVec4(0.15f, 0.35f, 0.4f, 0.9f);
+    static constexpr ImU32 activeColour = IM_COL32(255, 255, 0, 255);
+    static constexpr ImU32 viewportColour = IM_COL32(255, 255, 255, 220);
+    static constexpr ImU32 otherViewportColour = IM_COL32(255, 255, 255, 90);
+
+    std::shared_ptr<NumberGrid> numberGrid;
+    int gridSize = 0;
+    int chunkSize = 1;
+    int texelsPerSide = 0;
+
+    std::vector<Chunk> chunks;
+    std::vector<uint32_t> texels;
+    std::vector<DirtySpan> dirtyRows;
+    bool anyDirty = false;
+    GLuint texture = 0;
+
+    // Only a handful of groups pulse at once
+    std::vector<uint32_t> activeGroups;
+
+    ImVec2 drawMin = ImVec2(0, 0);
+    ImVec2 drawMax = ImVec2(0, 0);
+};
+
+std::shared_ptr<Minimap> createMinimap(std::shared_ptr<NumberGrid> numberGrid, int maxTexels)
+{
+    return std::make_shared<MinimapImpl>(std::move(numberGrid), maxTexels);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Numbers/NumberGrid.h"
+
+#include <imgui.h>
+#include <memory>
+#include <vector>
+
+// Overview of the whole grid from a small texture, one texel per chunk of cells, showing how many
+// bad numbers are left and how many have been refined in each chunk. The grid is scanned once up
+// front; after that only grid events change chunks, and only the texels they touch are uploaded.
+class Minimap {
+public:
+    virtual void applyEvents(const std::vector<GridEvent>& events) = 0;
+
+    // Uploads changed texels, then draws the map over [min, max] with the active groups marked and
+    // each viewport's cells outlined, the focused one brightest
+    virtual void draw(ImDrawList* drawList, const ImVec2& min, const ImVec2& max, const std::vector<GridRect>& viewports, size_t focused) = 0;
+
+    // Grid position, in cells, under a screen position inside the rectangle last drawn
+    virtual ImVec2 toGridPosition(const ImVec2& screenPos) const = 0;
+
+    virtual ~Minimap() = default;
+};
+
+// Needs a current GL context. Grids wider than maxTexels are grouped into square chunks.
+std::shared_ptr<Minimap> createMinimap(std::shared_ptr<NumberGrid> numberGrid, int maxTexels = 128);
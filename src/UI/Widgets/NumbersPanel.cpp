@@ -1,15 +1,31 @@
 #include "NumbersPanel.h"
 
 #include "Numbers/NumberGrid.h"
+#include "ImageBatch.h"
 #include "ImageDisplay.h"
+#include "Log.h"
+#include "Minimap.h"
 #include "Settings.h"
 #include "../UIManager.h"
-
+#include "../Animation/RefineAnimator.h"
+#include "../../LaunchOptions.h"
+#include "../../Memory/ScratchArena.h"
+#include "../../Control/ControlCommand.h"
+#include "../../Journal/RefineJournal.h"
+#include "../../Profiling/FrameProfiler.h"
+#include "../../Rendering/GpuTimer.h"
+#include "../../Rendering/ScaledLayer.h"
+#include "../../Sync/SessionSync.h"
+#include "../../Telemetry/MetricsRegistry.h"
+#include "../../Threading/WorkerPool.h"
+
+#include <cfloat>
 #include <cmath>
+#include <cstdio>
 #include <imgui.h>
 #include <imgui_internal.h>
-#include <iostream>
 #include <random>
+#include <unordered_map>
 #include <utility>
 #include <json.hpp>
 #include "PerlinNoise.hpp"
@@ -17,21 +33,47 @@
 class NumbersPanelImpl : public NumbersPanel
 {
 public:
-    explicit NumbersPanelImpl(std::shared_ptr<ImageDisplay> imageDisplay) : imageDisplay(std::move(imageDisplay))
+    NumbersPanelImpl(std::shared_ptr<NumberGrid> grid, std::shared_ptr<ImageDisplay> imageDisplay, std::shared_ptr<FrameProfiler> frameProfiler, std::shared_ptr<GpuTimer> gpuTimer,
+                     std::shared_ptr<ScratchArena> scratchArena, const LaunchOptions& options)
+        : gridSize(options.gridSize), imageDisplay(std::move(imageDisplay)), seed(options.seed), workerPool(createWorkerPool(options.gridThreads)), scratchArena(std::move(scratchArena)),
+          frameProfiler(std::move(frameProfiler)), gpuTimer(std::move(gpuTimer))
     {
-        numberGrid = createNumberGrid(gridSize);
+        numberGrid = std::move(grid);
+        gridSize = numberGrid->getGridSize();
+        numberGrid->setEventsEnabled(true);
+        gridEvents.reserve(gridEventsReserve);
+        viewports.resize(std::clamp(options.viewports, 1, maxViewports));
+        visibleRanges.resize(viewports.size());
+        LOG_INFO("Building the number grid on %d thread(s)", workerPool->getThreadCount());
 
         // Update max bad groups for each bin
-        auto badGroups = numberGrid->getBadGroups();
-        for (auto &[id, group] : badGroups) {
-            bins[group->binIdx].maxBadGroups++;
+        for (const auto &group : numberGrid->getBadGroups()) {
+            bins[group.binIdx].maxBadGroups++;
+        }
+
+        if (options.syncAddress) {
+            if (!options.seedSet) {
+                LOG_WARNING("--sync without --seed, this kiosk's grid won't match any other");
+            }
+            size_t groupCount = numberGrid->getBadGroups().size();
+            // Kiosks on another seed, grid size or dataset can share the port without mixing up their grids
+            uint64_t contentId = numberGrid->getContentId();
+            uint32_t session = seed * 0x9e3779b9u ^ static_cast<uint32_t>(gridSize) ^ static_cast<uint32_t>(contentId ^ (contentId >> 32));
+            sessionSync = createSessionSync(*options.syncAddress, options.syncPeers, session, gridSize, groupCount);
+            remoteRefinedGroups.resize(groupCount, false);
+            syncDeltas.reserve(gridEventsReserve);
+        }
+
+        if (options.journalPath) {
+            refineJournal = createRefineJournal(*options.journalPath, options.journalFsyncMs, static_cast<size_t>(options.journalRotateMb) * 1024 * 1024,
+                                                seed, gridSize);
         }
 
         // Load settings
         if (auto loadedSettings = loadSettings(settingsSavePath)) {
             displaySettings = loadedSettings->displaySettings;
             controlSettings = loadedSettings->controlSettings;
-            std::cout << "Successfully loaded settings from disk." << std::endl;
+            LOG_INFO("Successfully loaded settings from disk.");
         }
         
         // Initialize shutdown menu as closed
@@ -46,13 +88,28 @@ public:
         io.Fonts->Build();
         if (font == nullptr) {
             font = ImGui::GetDefaultFont();
-            std::cerr << "Failed to load 'Montserrat-Bold' font." << std::endl;
+            LOG_ERROR("Failed to load 'Montserrat-Bold' font.");
         }
+
+        gridLayer = createScaledLayer();
+        minimap = createMinimap(numberGrid);
+
+        // Grid and bin images are drawn in batches, one atlas texture each
+        digitAtlas = imageDisplay->createImageAtlas({"numbers/0.png", "numbers/1.png", "numbers/2.png", "numbers/3.png", "numbers/4.png",
+                                                     "numbers/5.png", "numbers/6.png", "numbers/7.png", "numbers/8.png", "numbers/9.png"});
+        binAtlas = imageDisplay->createImageAtlas({"bins/bin01.png", "bins/bin02.png", "bins/bin03.png", "bins/bin04.png", "bins/bin05.png",
+                                                   "bins/bin-percent.png", "bins/bin-open.png"});
     }
 
     void update() final
     {
+        if (displaySettings.maxActiveBadGroups != numberGrid->getMaxActiveGroups()) {
+            numberGrid->setMaxActiveGroups(displaySettings.maxActiveBadGroups);
+        }
         numberGrid->update();
+
+        // Refined numbers keep moving whether or not they're on screen
+        advanceRefineAnimations();
         
         // We can't directly control idleMode from here as it's managed by UIManager
         // The idle mode tracking will remain in UIManagerImpl instead
@@ -60,7 +117,7 @@ public:
 
     void drawNumbersPanel() final
     {
-        bool displaySizeChanged = updateDisplaySettings(displayPresets, displaySettings.globalScale);
+        updateDisplaySettings(displayPresets, displaySettings.globalScale);
 
         ImVec2 mousePos = ImGui::GetIO().MousePos;
         ImVec2 windowSize = ImGui::GetWindowSize();
@@ -68,189 +125,735 @@ public:
 
         ImDrawList* draw_list = ImGui::GetWindowDrawList();
 
-        // Update viewport
-        bool viewportChanged = updateViewport(windowSize);
+        // The grid under the minimap neither magnifies nor refines
+        auto [minimapMin, minimapMax] = getMinimapRect(windowPos, windowSize);
+        bool minimapShown = displaySettings.minimapMinGridSize <= gridSize;
+        bool minimapHovered = minimapShown && ImGui::IsMouseHoveringRect(minimapMin, minimapMax, false);
+        if (minimapHovered) {
+            mousePos = ImVec2(-FLT_MAX, -FLT_MAX);
+        }
+
+        // Keys, the wheel, the minimap and control commands go to the viewport last under the mouse.
+        // Each viewport only sees the cursor while it's over that viewport.
+        layoutViewports(windowPos, windowSize);
+        for (size_t v = 0; v < viewports.size(); v++) {
+            if (viewports[v].contains(mousePos)) {
+                focusedViewport = v;
+            }
+        }
+        for (size_t v = 0; v < viewports.size(); v++) {
+            auto &viewport = viewports[v];
+            updateViewport(viewport, v == focusedViewport);
+            viewport.mousePos = viewport.contains(mousePos) ? mousePos : ImVec2(-FLT_MAX, -FLT_MAX);
+        }
+        applyPendingRefines(viewports[focusedViewport]);
 
         // Draw Overlays
-        drawGraphicOverlays(windowPos, windowSize, draw_list);
+        {
+            ProfileScope profileScope(*frameProfiler, FrameStage::Overlays);
+            gpuTimer->begin(GpuSpan::Overlays, draw_list);
+            drawGraphicOverlays(windowPos, windowSize, draw_list);
+            gpuTimer->end(GpuSpan::Overlays, draw_list);
+        }
 
-        // Draw Grid
-        auto numberRefiningToBin = drawNumbersGrid(windowPos, windowSize, mousePos, viewportChanged || displaySizeChanged);
+        // Draw Grid, possibly below native resolution
+        updateGridRenderScale();
+        gpuTimer->begin(GpuSpan::Grid, draw_list);
+        gridLayer->begin(draw_list);
+        drawNumbersGrid();
+        drawRefiningNumbers();
+        gridLayer->end(draw_list);
+        gpuTimer->end(GpuSpan::Grid, draw_list);
 
         // Draw Bins
-        drawBins(windowPos, windowSize, draw_list, numberRefiningToBin);
+        {
+            ProfileScope profileScope(*frameProfiler, FrameStage::Overlays);
+            gpuTimer->begin(GpuSpan::Overlays, draw_list);
+            drawBins(windowPos, windowSize, draw_list, refineAnimator->getReceivingBins());
+
+            // Events are taken every frame so the queue stays short while the minimap is hidden
+            numberGrid->takeEvents(gridEvents);
+            minimap->applyEvents(gridEvents);
+            if (sessionSync) {
+                syncSession(viewports[focusedViewport]);
+            }
+            if (minimapShown) {
+                minimap->draw(draw_list, minimapMin, minimapMax, visibleRanges, focusedViewport);
+            }
+            gpuTimer->end(GpuSpan::Overlays, draw_list);
+        }
 
+        // Clicking or dragging on the minimap moves the view there
+        if (minimapHovered && ImGui::IsMouseDown(ImGuiMouseButton_Left)) {
+            centerViewportOn(viewports[focusedViewport], minimap->toGridPosition(ImGui::GetIO().MousePos));
+        }
     }
 
     void triggerLoadAnimation() final
     {
         // Reset 'regenerate scale' on all numbers
-        for (auto &[x, gridY] : numberGrid->getGrid()) {
-            for (auto &[y, gridNumber] : gridY) {
-                gridNumber->regenerateScale = 0.f;
+        numberGrid->resetRegenerateScales();
+    }
+
+    std::string handleCommand(const ControlCommand& command) final
+    {
+        switch (command.type) {
+            case ControlCommandType::Pan:
+                // Clamped to the grid by updateViewport this frame
+                viewports[focusedViewport].panelOffset = ImVec2(command.x, command.y);
+                viewports[focusedViewport].dirty = true;
+                return "ok";
+            case ControlCommandType::Zoom:
+                viewports[focusedViewport].panelScale = command.x;
+                viewports[focusedViewport].dirty = true;
+                return "ok";
+            case ControlCommandType::FocusViewport:
+                if (command.viewport < 0 || command.viewport >= static_cast<int>(viewports.size())) {
+                    return "error: viewport " + std::to_string(command.viewport) + " does not exist, there are " + std::to_string(viewports.size());
+                }
+                focusedViewport = static_cast<size_t>(command.viewport);
+                return "ok";
+            case ControlCommandType::ActivateGroup:
+                if (!numberGrid->activateGroup(command.groupId)) {
+                    return "error: group " + std::to_string(command.groupId) + " is not an inactive, unrefined group in view";
+                }
+                return "ok";
+            case ControlCommandType::RefineGroup: {
+                auto badGroup = numberGrid->getBadGroup(command.groupId);
+                if (!badGroup || badGroup->refined) {
+                    return "error: group " + std::to_string(command.groupId) + " does not exist or is already refined";
+                }
+                pendingRefines.push_back(command.groupId);
+                return "ok";
             }
+            case ControlCommandType::RefineVisible: {
+                int count = 0;
+                for (const auto &badGroup : numberGrid->getBadGroups()) {
+                    if (!badGroup.refined && badGroup.numberCount > 0 && isInAnyViewport(badGroup.bounds)) {
+                        pendingRefines.push_back(badGroup.id);
+                        count++;
+                    }
+                }
+                return "ok " + std::to_string(count);
+            }
+            case ControlCommandType::DumpState:
+                return dumpState();
+            default:
+                return "error: unsupported command";
+        }
+    }
+
+    void publishMetrics(MetricsRegistry& metrics) const final
+    {
+        for (int b = 0; b < binCount; b++) {
+            metrics.setBinMetrics(b, BinMetrics{bins[b].maxBadGroups, bins[b].badGroupsRefined, bins[b].refinesStarted, bins[b].numbersRefined});
+        }
+        if (sessionSync) {
+            metrics.recordSync(sessionSync->getStats());
         }
     }
 
 private:
-    std::optional<int> drawNumbersGrid(const ImVec2& windowPos, const ImVec2& windowSize, const ImVec2& mousePos, bool updateDisplayInfos)
-    {
-        std::optional<int> refiningToBin = std::nullopt;
-        for (auto &[x, gridY] : numberGrid->getGrid()) {
-            for (auto &[y, gridNumber] : gridY) {
-
-                std::string numberToDraw = "numbers/" + std::to_string(gridNumber->num) + ".png";
-                auto [width, height] = imageDisplay->getImageSize(numberToDraw);
-                double badScale = gridNumber->badGroup ? gridNumber->badGroup->scale : 0.0;
-
-                if (updateDisplayInfos) {
-                    // Only need to update when viewport has changed
-                    ImVec2 localNumberPos = ImVec2((x * displaySettings.gridSpacing + panelOffset.x)*panelScale, (y * displaySettings.gridSpacing + panelOffset.y)*panelScale);
-                    gridNumber->displayInfos.centerX = localNumberPos.x + windowPos.x;
-                    gridNumber->displayInfos.centerY = localNumberPos.y + windowPos.y;
-
-                    double baseNumberScale = displaySettings.imageScale*panelScale;
-                    double widthOffset = (baseNumberScale*width/2.f);
-                    double heightOffset = (baseNumberScale*height/2.f);
-                    gridNumber->displayInfos.isVisible = gridNumber->displayInfos.centerX + widthOffset < windowPos.x + windowSize.x && gridNumber->displayInfos.centerX - widthOffset > windowPos.x &&
-                                                            gridNumber->displayInfos.centerY + heightOffset < windowPos.y + windowSize.y - displayPresets.numberWindowBufferBottom && gridNumber->displayInfos.centerY - heightOffset > windowPos.y + displayPresets.numberWindowBufferTop;
+    // One operator's view of the shared grid. pos and size cover the viewport's whole share of the
+    // window, insetTop and insetBottom the parts of it under the header and bins.
+    struct Viewport
+    {
+        ImVec2 panelOffset = ImVec2(0,0);
+        float panelScale = 0.15f;
+
+        // Centred on the grid by its first updateViewport
+        bool initialized = false;
+        // Set when the viewport is changed from outside updateViewport, so it gets clamped again
+        bool dirty = false;
+
+        ImVec2 pos = ImVec2(0,0);
+        ImVec2 size = ImVec2(0,0);
+        float insetTop = 0.f;
+        float insetBottom = 0.f;
+
+        GridRect visibleRange;
+        // Off screen unless the mouse is over this viewport
+        ImVec2 mousePos = ImVec2(-FLT_MAX, -FLT_MAX);
+
+        bool contains(const ImVec2& point) const
+        {
+            return point.x >= pos.x && point.x < pos.x + size.x && point.y >= pos.y && point.y < pos.y + size.y;
+        }
+    };
+    // A visible number resolved to its final screen position, scale and colour
+    struct GridQuad
+    {
+        ImVec2 pos;
+        float scale;
+        ImU32 col;
+        uint8_t digit;
+    };
+
+    void drawNumbersGrid()
+    {
+        ProfileScope profileScope(*frameProfiler, FrameStage::GridDraw);
+
+        // Only cells inside each viewport's numbers area are visited, positions are derived from its offset and scale
+        size_t cellCount = 0;
+        for (size_t v = 0; v < viewports.size(); v++) {
+            auto &viewport = viewports[v];
+            viewport.visibleRange = getVisibleRange(viewport);
+            visibleRanges[v] = viewport.visibleRange;
+            cellCount += static_cast<size_t>(viewport.visibleRange.maxX - viewport.visibleRange.minX) * (viewport.visibleRange.maxY - viewport.visibleRange.minY);
+        }
+        numberGrid->setVisibleRanges(visibleRanges);
+        frameProfiler->addCounter(FrameCounter::VisibleCells, static_cast<double>(cellCount));
+
+        // Every viewport's quads share one scratch buffer and go out as one batch, so a viewport adds
+        // cells to build but no draw calls or texture binds
+        GridQuad* quads = scratchArena->allocateArray<GridQuad>(cellCount);
+        int* bandQuadCounts = scratchArena->allocateArray<int>(workerPool->getThreadCount() * bandsPerThread);
+        size_t quadCount = 0;
+        for (size_t v = 0; v < viewports.size(); v++) {
+            const auto &viewport = viewports[v];
+            const auto &visibleRange = viewport.visibleRange;
+
+            // Hover and refine clicks can only touch cells near the cursor. They're resolved up front so the
+            // bands below only read bad group state.
+            auto cursorRange = getCursorRange(viewport);
+            handleCursorInteraction(cursorRange.intersection(visibleRange), viewport);
+
+            // Build each band of columns on a worker thread into its own slice of the viewport's part of
+            // the buffer. A band can't produce more quads than it has cells, so slice b starts at its first
+            // column's first cell.
+            int columns = visibleRange.maxX - visibleRange.minX;
+            int rows = visibleRange.maxY - visibleRange.minY;
+            int bandCount = std::min(columns, workerPool->getThreadCount() * bandsPerThread);
+            GridQuad* viewportQuads = quads + quadCount;
+            auto bandMinX = [&](int band) { return visibleRange.minX + columns * band / bandCount; };
+            auto bandQuads = [&](int band) { return viewportQuads + static_cast<size_t>(bandMinX(band) - visibleRange.minX) * rows; };
+            parallelFor(*workerPool, bandCount, [&](int band) {
+                GridRect bandRect{bandMinX(band), visibleRange.minY, bandMinX(band + 1), visibleRange.maxY};
+                bandQuadCounts[band] = buildGridBand(bandRect, cursorRange, v, bandQuads(band));
+            });
+
+            // Close the gaps between bands, in band order so the output matches a single-threaded build
+            for (int band = 0; band < bandCount; band++) {
+                const GridQuad* bandQuad = bandQuads(band);
+                if (bandQuad != quads + quadCount) {
+                    std::copy(bandQuad, bandQuad + bandQuadCounts[band], quads + quadCount);
                 }
+                quadCount += bandQuadCounts[band];
+            }
+        }
 
-                // Don't draw numbers out of viewport
-                if (!gridNumber->displayInfos.isVisible) {
+        ImageBatch batch(ImGui::GetWindowDrawList(), *digitAtlas, static_cast<int>(quadCount));
+        for (size_t q = 0; q < quadCount; q++) {
+            batch.add(quads[q].digit, quads[q].pos, quads[q].scale, quads[q].col);
+        }
+        t += 1;
+    }
+
+    void updateGridRenderScale()
+    {
+        if (!displaySettings.gridRenderScaleAuto) {
+            gridLayer->setScale(displaySettings.gridRenderScale);
+            return;
+        }
+
+        // Once per frame read back. Drop resolution quickly when over budget, recover slowly once
+        // comfortably under it.
+        if (gpuTimer->getCompletedFrames() == lastGpuFrame) {
+            return;
+        }
+        lastGpuFrame = gpuTimer->getCompletedFrames();
+        if (auto gpuTime = gpuTimer->getLastTime(GpuSpan::Grid)) {
+            if (*gpuTime > displaySettings.gridGpuBudgetMs) {
+                gridLayer->setScale(gridLayer->getScale() * 0.9f);
+            } else if (*gpuTime < displaySettings.gridGpuBudgetMs * 0.6f) {
+                gridLayer->setScale(gridLayer->getScale() * 1.02f);
+            }
+        }
+    }
+
+    void handleCursorInteraction(const GridRect& range, const Viewport& viewport)
+    {
+        bool refineHeld = ImGui::IsKeyDown(ImGuiKey_MouseLeft);
+        for (int x = range.minX; x < range.maxX; x++) {
+            for (int y = range.minY; y < range.maxY; y++) {
+                const auto &gridNumber = *numberGrid->getGridNumber(x, y);
+                auto badGroup = numberGrid->getBadGroup(gridNumber.badGroupId);
+                if (!badGroup || !badGroup->isActive || badGroup->refined) {
                     continue;
                 }
 
-                auto centerPos = ImVec2(gridNumber->displayInfos.centerX, gridNumber->displayInfos.centerY);
+                auto numberScale = getScaleFromCursor(getDriftedCenter(x, y, gridNumber, viewport), viewport.mousePos);
 
-                // Animate number on screen
-                float numberAlpha = 255;
-                if (gridNumber->regenerateScale < 1.f) {
-                    gridNumber->regenerateScale += numberGrid->randomNumber(0,10)*0.001f;
-                    numberAlpha = static_cast<int>(std::clamp(gridNumber->regenerateScale*2.f*255.f, 0.f, 255.f));
+                // Make number 'super active'
+                if (numberScale > 1.0f) {
+                    badGroup->superActive = true;
+                }
+                // Mark as refined on 'LEFT CLICK'
+                if (refineHeld && numberScale >= (0.5f + displaySettings.mouseScaleMultiplier)) {
+                    refineGroup(*badGroup, viewport);
+                }
+            }
+        }
+    }
+
+    // Runs on worker threads: only writes the band's own cells and output slice, returns the quads written
+    int buildGridBand(const GridRect& band, const GridRect& cursorRange, size_t viewportIdx, GridQuad* quads)
+    {
+        const auto &viewport = viewports[viewportIdx];
+        int quadCount = 0;
+        const auto &badGroups = numberGrid->getBadGroups();
+
+        for (int x = band.minX; x < band.maxX; x++) {
+            for (int y = band.minY; y < band.maxY; y++) {
+                auto &gridNumber = *numberGrid->getGridNumber(x, y);
+                // Checked against the table, not just NoBadGroup, since a dataset's cells come from a file
+                const BadGroup* badGroup = gridNumber.badGroupId < badGroups.size() ? &badGroups[gridNumber.badGroupId] : nullptr;
+
+                // Refined numbers are drawn by the refine animation until they regenerate
+                if (badGroup && badGroup->refined) {
+                    continue;
                 }
 
-                // Offset from noise scale
-                double noiseScale = perlin.noise3D((x * displaySettings.noiseScale), (y * displaySettings.noiseScale), t*displaySettings.noiseSpeed);
-                if (gridNumber->displayInfos.horizontalOffset) {
-                    centerPos.x += noiseScale*displaySettings.noiseScaleOffset;
-                } else {
-                    centerPos.y += noiseScale*displaySettings.noiseScaleOffset;
+                double badScale = badGroup ? badGroup->scale : 0.0;
+                auto centerPos = getDriftedCenter(x, y, gridNumber, viewport);
+
+                // Animate number on screen, once per frame for cells shown in more than one viewport
+                float numberAlpha = 255;
+                float regenerateScale = gridNumber.getRegenerateScale();
+                if (regenerateScale < 1.f) {
+                    if (!isInEarlierViewport(x, y, viewportIdx)) {
+                        gridNumber.regenerateTicks += cellRandom(x, y, 0, 0, 10);
+                        regenerateScale = gridNumber.getRegenerateScale();
+                    }
+                    numberAlpha = static_cast<int>(std::clamp(regenerateScale*2.f*255.f, 0.f, 255.f));
                 }
 
                 // Colour
                 auto col = ColorValues::lumonBlue.Value;
                 col.w = numberAlpha;
-                if (revealMap && gridNumber->badGroup) {
-                    col = gridNumber->badGroup->isActive ? ImVec4(255,255,0,numberAlpha) : ImVec4(255,0,0,255);
+                if (revealMap && badGroup) {
+                    col = badGroup->isActive ? ImVec4(255,255,0,numberAlpha) : ImVec4(255,0,0,255);
                 }
 
                 // Scale from mouse hovering
-                auto numberScale = getScaleFromCursor(centerPos, mousePos);
-
-                // Handle if part of bad group
-                if (gridNumber->badGroup) {
-                    if (gridNumber->badGroup->isActive) {
-                        // Make number 'super active'
-                        if (numberScale > 1.0f) {
-                            gridNumber->badGroup->superActive = true;
-                        }
-                        // Mark as refined on 'LEFT CLICK'
-                        if (!gridNumber->badGroup->refined && numberScale >= (0.5f + displaySettings.mouseScaleMultiplier) && ImGui::IsKeyDown(ImGuiKey_MouseLeft)) {
-                            gridNumber->badGroup->refined = true;
-                            bins[gridNumber->badGroup->binIdx].badGroupsRefined++;
-                        }
-                    }
+                float numberScale = cursorRange.contains(x, y) ? getScaleFromCursor(centerPos, viewport.mousePos) : 1.0f;
 
-                    // Add jitter to 'super active' bad numbers
-                    if (gridNumber->badGroup->superActive) {
-                        centerPos.x += numberGrid->randomNumber(-10, 10)*badScale;
-                        centerPos.y += numberGrid->randomNumber(-10, 10)*badScale;
-                    }
+                // Add jitter to 'super active' bad numbers
+                if (badGroup && badGroup->superActive) {
+                    centerPos.x += cellRandom(x, y, 1, -10, 10)*badScale;
+                    centerPos.y += cellRandom(x, y, 2, -10, 10)*badScale;
+                }
 
-                    // Animate position if number has been refined
-                    if (gridNumber->badGroup->refined) {
-                        float startX = gridNumber->displayInfos.centerX;
-                        float startY = gridNumber->displayInfos.centerY;
+                float combinedScale = regenerateScale*displaySettings.imageScale*numberScale*viewport.panelScale + badScale;
+                const auto &size = digitAtlas->images[gridNumber.num].size;
+                quads[quadCount++] = GridQuad{ImVec2(centerPos.x - (size.x*combinedScale)/2.f, centerPos.y - (size.y*combinedScale)/2.f), combinedScale, ImGui::GetColorU32(col), static_cast<uint8_t>(gridNumber.num)};
+            }
+        }
+        return quadCount;
+    }
 
-                        if (gridNumber->displayInfos.refinedX == -1) {
-                            gridNumber->displayInfos.refinedX = startX;
-                            gridNumber->displayInfos.refinedY = startY;
-                        }
+    // Deterministic per-cell random number for this frame, so bands give the same result on any thread
+    int cellRandom(int x, int y, uint32_t stream, int min, int max) const
+    {
+        uint32_t h = static_cast<uint32_t>(x) * 0x8da6b343u ^ static_cast<uint32_t>(y) * 0xd8163841u ^ static_cast<uint32_t>(t) * 0xcb1ab31fu ^ (seed + stream * 0x9e3779b9u);
+        h ^= h >> 16;
+        h *= 0x7feb352du;
+        h ^= h >> 15;
+        h *= 0x846ca68bu;
+        h ^= h >> 16;
+        return min + static_cast<int>(h % static_cast<uint32_t>(max - min + 1));
+    }
 
-                        auto binIdx = gridNumber->badGroup->binIdx;
-                        if (binIdx > 4) {
-                            std::cout << "Error: Bin index greater than expected. Setting to max." << std::endl;
-                            binIdx = 4;
-                        }
+    // Viewports are built one after another, so a cell in an earlier one has already been animated this frame
+    bool isInEarlierViewport(int x, int y, size_t viewportIdx) const
+    {
+        for (size_t v = 0; v < viewportIdx; v++) {
+            if (viewports[v].visibleRange.contains(x, y)) {
+                return true;
+            }
+        }
+        return false;
+    }
 
-                        float distX = bins[binIdx].pos.x - gridNumber->displayInfos.refinedX;
-                        float distY = bins[binIdx].pos.y - gridNumber->displayInfos.refinedY;
-                        float distance = sqrt(distX * distX + distY * distY);
-
-                        if (distance > displaySettings.refinedToBinSpeed) {
-                            float dirX = distX / distance;
-                            float dirY = distY / distance;
-                            gridNumber->displayInfos.refinedX += dirX * displaySettings.refinedToBinSpeed;
-                            gridNumber->displayInfos.refinedY += dirY * displaySettings.refinedToBinSpeed;
-                            centerPos = ImVec2(gridNumber->displayInfos.refinedX, gridNumber->displayInfos.refinedY);
-
-                            refiningToBin = gridNumber->badGroup->binIdx;
-                        } else {
-                            gridNumber->badGroup.reset(); // No longer a bad number
-                            gridNumber->num = numberGrid->randomNumber(0,9);
-                            gridNumber->regenerateScale = 0.f;
+    bool isInAnyViewport(const GridRect& bounds) const
+    {
+        for (const auto &viewport : viewports) {
+            if (bounds.intersects(viewport.visibleRange)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    ImVec2 getDriftedCenter(int x, int y, const Number& gridNumber, const Viewport& viewport) const
+    {
+        auto centerPos = getNumberCenter(x, y, viewport);
+
+        // Offset from noise scale
+        double noiseScale = perlin.noise3D((x * displaySettings.noiseScale), (y * displaySettings.noiseScale), t*displaySettings.noiseSpeed);
+        if (gridNumber.horizontalOffset) {
+            centerPos.x += noiseScale*displaySettings.noiseScaleOffset;
+        } else {
+            centerPos.y += noiseScale*displaySettings.noiseScaleOffset;
+        }
+        return centerPos;
+    }
+
+    // Sends every number of the group towards its bin. Refines made on another kiosk of a shared
+    // session animate the same way but count towards that kiosk's bins.
+    void refineGroup(BadGroup& badGroup, const Viewport& viewport, bool remote = false)
+    {
+        numberGrid->refineGroup(badGroup.id);
+        if (remote) {
+            remoteRefinedGroups[badGroup.id] = true;
+        } else {
+            bins[badGroup.binIdx].refinesStarted++;
+        }
+        if (refineJournal) {
+            journal::Record record;
+            record.type = journal::RecordType::RefineStarted;
+            record.bin = static_cast<uint8_t>(badGroup.binIdx);
+            record.flags = remote ? journal::remoteFlag : 0;
+            record.viewport = static_cast<uint8_t>(&viewport - viewports.data());
+            record.groupId = badGroup.id;
+            record.numberCount = static_cast<uint32_t>(badGroup.numberCount);
+            record.binCount = static_cast<uint32_t>(bins[badGroup.binIdx].refinesStarted);
+            refineJournal->record(record);
+        }
+        forEachGroupNumber(*numberGrid, badGroup, [&](int x, int y, Number&) {
+            refineAnimator->add(x, y, badGroup.id, badGroup.binIdx, getNumberCenter(x, y, viewport), viewport.panelScale);
+        });
+    }
+
+    // Refines requested over the control socket, resolved once this frame's viewport is known
+    void applyPendingRefines(const Viewport& viewport)
+    {
+        for (uint32_t id : pendingRefines) {
+            auto badGroup = numberGrid->getBadGroup(id);
+            if (badGroup && !badGroup->refined) {
+                refineGroup(*badGroup, viewport);
+            }
+        }
+        pendingRefines.clear();
+    }
+
+    // Sends this frame's grid changes and bin counts to the other kiosks, then applies theirs. The
+    // grid's events from applying them are passed to the minimap only, so they aren't sent back.
+    void syncSession(const Viewport& viewport)
+    {
+        sessionSync->publish(gridEvents, *numberGrid);
+        for (int b = 0; b < binCount; b++) {
+            sessionSync->setBinCount(b, bins[b].badGroupsRefined);
+        }
+        sessionSync->flush();
+
+        syncDeltas.clear();
+        sessionSync->receive(syncDeltas);
+        for (const auto &delta : syncDeltas) {
+            switch (delta.type) {
+                case SyncDeltaType::GroupActivated:
+                    // Only pulses here if the group is in this kiosk's view as well
+                    numberGrid->activateGroup(delta.groupId);
+                    break;
+                case SyncDeltaType::GroupRefined: {
+                    auto badGroup = numberGrid->getBadGroup(delta.groupId);
+                    if (!badGroup) {
+                        break;
+                    }
+                    if (!badGroup->refined) {
+                        refineGroup(*badGroup, viewport, true);
+                    } else if (delta.supersedesLocal && !remoteRefinedGroups[badGroup->id]) {
+                        // Both kiosks refined it and the other one won, so the group moves to its bins
+                        remoteRefinedGroups[badGroup->id] = true;
+                        if (badGroup->numberCount == 0) {
+                            bins[badGroup->binIdx].badGroupsRefined--;
                         }
                     }
+                    break;
                 }
+                case SyncDeltaType::DigitRegenerated:
+                    applyRemoteDigit(delta.x, delta.y, delta.digit);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        const auto &stats = sessionSync->getStats();
+        frameProfiler->addCounter(FrameCounter::SyncBytesSent, static_cast<double>(stats.tickBytesSent));
+        frameProfiler->addCounter(FrameCounter::SyncBytesReceived, static_cast<double>(stats.tickBytesReceived));
+
+        numberGrid->takeEvents(gridEvents);
+        minimap->applyEvents(gridEvents);
+    }
+
+    // A number that is still flying to its bin here takes the digit when it lands, so it only leaves
+    // its group once
+    void applyRemoteDigit(int x, int y, uint8_t digit)
+    {
+        Number* number = numberGrid->getGridNumber(x, y);
+        if (!number) {
+            return;
+        }
+        auto badGroup = numberGrid->getBadGroup(number->badGroupId);
+        if (badGroup && badGroup->refined) {
+            remoteDigits[static_cast<size_t>(x) * gridSize + y] = digit;
+            return;
+        }
+        numberGrid->setNumber(x, y, digit);
+    }
 
-                // Draw number
-                float combinedScale = gridNumber->regenerateScale*displaySettings.imageScale*numberScale*panelScale + badScale;
-                ImGui::SetCursorPos(ImVec2(centerPos.x - ImGui::GetWindowPos().x - ((width*combinedScale)/2.f), centerPos.y - ImGui::GetWindowPos().y - ((height*combinedScale)/2.f)));
-                imageDisplay->drawImGuiImage(numberToDraw, combinedScale, col);
+    // Groups refined into the bin here and, in a shared session, on the other kiosks
+    int getBinGroupsRefined(int binIdx) const
+    {
+        int refined = bins[binIdx].badGroupsRefined;
+        if (sessionSync) {
+            refined += sessionSync->getRemoteBinCount(binIdx);
+        }
+        return refined;
+    }
+
+    std::string dumpState() const
+    {
+        nlohmann::json state;
+        // Top level fields describe the focused viewport
+        auto viewportState = [](const Viewport& viewport) {
+            const auto &range = viewport.visibleRange;
+            return nlohmann::json{{"panelOffset", {viewport.panelOffset.x, viewport.panelOffset.y}}, {"panelScale", viewport.panelScale},
+                                  {"visibleRange", {range.minX, range.minY, range.maxX, range.maxY}}};
+        };
+        state = viewportState(viewports[focusedViewport]);
+        state["focusedViewport"] = focusedViewport;
+        auto &viewportStates = state["viewports"] = nlohmann::json::array();
+        for (const auto &viewport : viewports) {
+            viewportStates.push_back(viewportState(viewport));
+        }
+        state["activeGroups"] = numberGrid->getActiveGroupCount();
+        state["maxActiveGroups"] = numberGrid->getMaxActiveGroups();
+        state["refiningNumbers"] = refineAnimator->getTweens().size();
+
+        // Candidates for activate/refine: unrefined groups with numbers in view
+        auto &visibleGroups = state["visibleGroups"] = nlohmann::json::array();
+        for (const auto &badGroup : numberGrid->getBadGroups()) {
+            if (!badGroup.refined && badGroup.numberCount > 0 && isInAnyViewport(badGroup.bounds)) {
+                visibleGroups.push_back({{"id", badGroup.id}, {"bin", badGroup.binIdx + 1}, {"active", badGroup.isActive}});
             }
         }
-        t += 1;
 
-        return refiningToBin;
+        auto &binStates = state["bins"] = nlohmann::json::array();
+        for (int b = 0; b < binCount; b++) {
+            binStates.push_back({{"id", bins[b].id}, {"groups", bins[b].maxBadGroups}, {"refined", getBinGroupsRefined(b)}});
+        }
+        return state.dump();
     }
 
-    void drawBins(const ImVec2& windowPos, const ImVec2& windowSize, ImDrawList* drawList, std::optional<int> numberRefiningToBin)
+    void advanceRefineAnimations()
     {
-        std::string binPercentPath = "bins/bin-percent.png";
-        auto [widthP, heightP] = imageDisplay->getImageSize(binPercentPath);
-        for (auto &b : bins) {
-            // Scale based on viewport size
-            auto pos = b.updatePos(windowSize, windowPos, displayPresets.numberWindowBufferBottom - displayPresets.binOffset);
+        std::array<ImVec2, binCount> binPositions;
+        for (int b = 0; b < binCount; b++) {
+            binPositions[b] = bins[b].pos;
+        }
 
-            // Draw bin images
-            std::string binPath = "bins/bin0" + std::to_string(b.id) + ".png";
-            auto [width, height] = imageDisplay->getImageSize(binPath);
-            ImGui::SetCursorPos(ImVec2(pos.x - windowPos.x - (width*displayPresets.binImageScale/2.f), pos.y - windowPos.y - (height*displayPresets.binImageScale/2.f)));
-            imageDisplay->drawImGuiImage(binPath, displayPresets.binImageScale, ColorValues::lumonBlue);
+        for (const auto &completion : refineAnimator->advance(binPositions, displaySettings.refinedToBinSpeed)) {
+            // No longer a bad number, with the digit another kiosk gave it if one came in on the way
+            auto remoteDigit = remoteDigits.empty() ? remoteDigits.end() : remoteDigits.find(static_cast<size_t>(completion.x) * gridSize + completion.y);
+            if (remoteDigit != remoteDigits.end()) {
+                numberGrid->setNumber(completion.x, completion.y, remoteDigit->second);
+                remoteDigits.erase(remoteDigit);
+            } else {
+                numberGrid->regenerateNumber(completion.x, completion.y);
+            }
+            bins[completion.binIdx].numbersRefined++;
 
-            auto percentPos = ImVec2(pos.x, pos.y + displayPresets.binPercentBarOffset);
-            ImGui::SetCursorPos(ImVec2(percentPos.x - windowPos.x - (widthP*displayPresets.binImageScale/2.f), percentPos.y - windowPos.y - (heightP*displayPresets.binImageScale/2.f)));
-            imageDisplay->drawImGuiImage(binPercentPath, displayPresets.binImageScale, ColorValues::lumonBlue);
+            // Group counts towards its bin once its last number lands
+            auto badGroup = numberGrid->getBadGroup(completion.groupId);
+            if (!badGroup || badGroup->numberCount != 0) {
+                continue;
+            }
+            bool remote = sessionSync && remoteRefinedGroups[badGroup->id];
+            if (!remote) {
+                bins[completion.binIdx].badGroupsRefined++;
+            }
+            if (refineJournal) {
+                journal::Record record;
+                record.type = journal::RecordType::GroupRefined;
+                record.bin = static_cast<uint8_t>(completion.binIdx);
+                record.flags = remote ? journal::remoteFlag : 0;
+                record.groupId = badGroup->id;
+                record.binCount = static_cast<uint32_t>(bins[completion.binIdx].badGroupsRefined);
+                refineJournal->record(record);
+            }
+        }
+    }
+
+    void drawRefiningNumbers()
+    {
+        const auto &tweens = refineAnimator->getTweens();
+        ImageBatch batch(ImGui::GetWindowDrawList(), *digitAtlas, static_cast<int>(tweens.size()));
+        for (size_t i = 0; i < tweens.size(); i++) {
+            auto &gridNumber = *numberGrid->getGridNumber(tweens.numberX[i], tweens.numberY[i]);
+            auto badGroup = numberGrid->getBadGroup(tweens.groupId[i]);
+            double badScale = badGroup ? badGroup->scale : 0.0;
+
+            const auto &size = digitAtlas->images[gridNumber.num].size;
+
+            float regenerateScale = std::min(gridNumber.getRegenerateScale(), 1.f);
+            auto col = ColorValues::lumonBlue.Value;
+            col.w = static_cast<int>(std::clamp(regenerateScale*2.f*255.f, 0.f, 255.f));
+
+            float combinedScale = regenerateScale*displaySettings.imageScale*tweens.scale[i] + badScale;
+            batch.add(gridNumber.num, ImVec2(tweens.posX[i] - (size.x*combinedScale)/2.f, tweens.posY[i] - (size.y*combinedScale)/2.f), combinedScale, ImGui::GetColorU32(col));
+        }
+    }
+
+    ImVec2 getNumberCenter(int x, int y, const Viewport& viewport) const
+    {
+        return ImVec2((x * displaySettings.gridSpacing + viewport.panelOffset.x)*viewport.panelScale + viewport.pos.x,
+                      (y * displaySettings.gridSpacing + viewport.panelOffset.y)*viewport.panelScale + viewport.pos.y);
+    }
+
+    // Block of cells whose (noise-offset) centre can fall within the mouse scale radius
+    GridRect getCursorRange(const Viewport& viewport) const
+    {
+        const auto &mousePos = viewport.mousePos;
+        if (!ImGui::IsMousePosValid(&mousePos) || displaySettings.gridSpacing <= 0.f) {
+            return GridRect{};
+        }
+
+        float reach = (displaySettings.mouseScaleRadius + std::abs(displaySettings.noiseScaleOffset)) / viewport.panelScale / displaySettings.gridSpacing;
+        float cellX = ((mousePos.x - viewport.pos.x)/viewport.panelScale - viewport.panelOffset.x) / displaySettings.gridSpacing;
+        float cellY = ((mousePos.y - viewport.pos.y)/viewport.panelScale - viewport.panelOffset.y) / displaySettings.gridSpacing;
+
+        auto toIndex = [&](float value) {
+            return static_cast<int>(std::clamp(value, 0.f, static_cast<float>(gridSize)));
+        };
+        return GridRect{toIndex(std::floor(cellX - reach)), toIndex(std::floor(cellY - reach)),
+                        toIndex(std::floor(cellX + reach) + 1.f), toIndex(std::floor(cellY + reach) + 1.f)};
+    }
+
+    // Cells whose image fits fully inside the viewport's numbers area, solved per axis rather than tested per cell
+    GridRect getVisibleRange(const Viewport& viewport) const
+    {
+        auto [width, height] = digitAtlas->images[0].size;
+        float panelScale = viewport.panelScale;
+        float baseNumberScale = displaySettings.imageScale*panelScale;
+
+        auto axisRange = [&](float offset, float halfExtent, float minEdge, float maxEdge) -> std::pair<int, int> {
+            auto inside = [&](int i) {
+                float center = (i * displaySettings.gridSpacing + offset)*panelScale;
+                return center - halfExtent > minEdge && center + halfExtent < maxEdge;
+            };
+
+            // Estimate the first visible index, then settle it exactly
+            float step = displaySettings.gridSpacing*panelScale;
+            int first = 0;
+            if (step > 0.f) {
+                float estimate = std::ceil((minEdge + halfExtent)/step - offset/displaySettings.gridSpacing);
+                first = static_cast<int>(std::clamp(estimate, 0.f, static_cast<float>(gridSize)));
+            }
+            while (first > 0 && inside(first - 1)) {
+                first--;
+            }
+            while (first < gridSize && !inside(first)) {
+                first++;
+            }
+            int last = first;
+            while (last < gridSize && inside(last)) {
+                last++;
+            }
+            return {first, last};
+        };
+
+        auto [minX, maxX] = axisRange(viewport.panelOffset.x, baseNumberScale*width/2.f, 0.f, viewport.size.x);
+        auto [minY, maxY] = axisRange(viewport.panelOffset.y, baseNumberScale*height/2.f, viewport.insetTop, viewport.size.y - viewport.insetBottom);
+        return GridRect{minX, minY, maxX, maxY};
+    }
+
+    // Square in the top right corner of the numbers area
+    std::pair<ImVec2, ImVec2> getMinimapRect(const ImVec2& windowPos, const ImVec2& windowSize) const
+    {
+        ImVec2 max = ImVec2(windowPos.x + windowSize.x - displayPresets.minimapMargin, windowPos.y + displayPresets.numberWindowBufferTop + displayPresets.minimapMargin + displayPresets.minimapSize);
+        return {ImVec2(max.x - displayPresets.minimapSize, max.y - displayPresets.minimapSize), max};
+    }
+
+    // Puts a grid position (in cells) in the middle of the viewport's numbers area, clamped by updateViewport next frame
+    void centerViewportOn(Viewport& viewport, const ImVec2& gridPos)
+    {
+        float centerY = (viewport.insetTop + viewport.size.y - viewport.insetBottom) / 2.f;
+        viewport.panelOffset.x = viewport.size.x / 2.f / viewport.panelScale - gridPos.x * displaySettings.gridSpacing;
+        viewport.panelOffset.y = centerY / viewport.panelScale - gridPos.y * displaySettings.gridSpacing;
+        viewport.dirty = true;
+    }
+
+    // Splits the numbers area into columns, or two rows of two for four viewports. The header and bins
+    // stay shared; the top row's viewports reach up over the header and the bottom row's down over the
+    // bins, as a single viewport covers the whole window.
+    void layoutViewports(const ImVec2& windowPos, const ImVec2& windowSize)
+    {
+        int count = static_cast<int>(viewports.size());
+        int columns = count == 4 ? 2 : count;
+        int rows = count == 4 ? 2 : 1;
+        float top = displayPresets.numberWindowBufferTop;
+        float bottom = displayPresets.numberWindowBufferBottom;
+        float areaHeight = windowSize.y - top - bottom;
+        for (int i = 0; i < count; i++) {
+            auto &viewport = viewports[i];
+            int column = i % columns;
+            int row = i / columns;
+            float minX = windowSize.x * column / columns;
+            float maxX = windowSize.x * (column + 1) / columns;
+            float minY = row == 0 ? 0.f : top + areaHeight * row / rows;
+            float maxY = row == rows - 1 ? windowSize.y : top + areaHeight * (row + 1) / rows;
+            viewport.pos = ImVec2(windowPos.x + minX, windowPos.y + minY);
+            viewport.size = ImVec2(maxX - minX, maxY - minY);
+            viewport.insetTop = row == 0 ? top : 0.f;
+            viewport.insetBottom = row == rows - 1 ? bottom : 0.f;
+        }
+    }
+
+    void drawBins(const ImVec2& windowPos, const ImVec2& windowSize, ImDrawList* drawList, uint32_t receivingBins)
+    {
+        const auto &percentSize = binAtlas->images[binPercentImage].size;
+        float binScale = displayPresets.binImageScale;
+        ImU32 binCol = ImGui::GetColorU32(ColorValues::lumonBlue.Value);
+        auto centered = [&](const ImVec2& center, const ImVec2& size) {
+            return ImVec2(center.x - size.x*binScale/2.f, center.y - size.y*binScale/2.f);
+        };
+
+        // All bin images go out as one batch, the bars and text are drawn over them afterwards
+        {
+            ImageBatch batch(drawList, *binAtlas, binCount*3);
+            for (auto &b : bins) {
+                // Scale based on viewport size
+                auto pos = b.updatePos(windowSize, windowPos, displayPresets.numberWindowBufferBottom - displayPresets.binOffset);
+
+                const auto &binSize = binAtlas->images[b.id - 1].size;
+                batch.add(b.id - 1, centered(pos, binSize), binScale, binCol);
+                batch.add(binPercentImage, centered(ImVec2(pos.x, pos.y + displayPresets.binPercentBarOffset), percentSize), binScale, binCol);
+
+                // Animate bin open
+                if (receivingBins & (1u << (b.id - 1))) {
+                    auto openPos = centered(pos, binAtlas->images[binOpenImage].size);
+                    batch.add(binOpenImage, ImVec2(openPos.x, openPos.y - binSize.y*binScale), binScale, binCol);
+                }
+            }
+        }
+
+        for (const auto &b : bins) {
+            const auto &pos = b.pos;
 
             // Draw percentage bar and text
-            ImVec2 trCorner = ImVec2(percentPos.x - (widthP*displayPresets.binImageScale/2.f), percentPos.y - (heightP*displayPresets.binImageScale/2.f));
-            ImVec2 brCorner = ImVec2(percentPos.x + (widthP*displayPresets.binImageScale/2.f), percentPos.y + (heightP*displayPresets.binImageScale/2.f));
+            auto percentPos = ImVec2(pos.x, pos.y + displayPresets.binPercentBarOffset);
+            ImVec2 trCorner = ImVec2(percentPos.x - (percentSize.x*binScale/2.f), percentPos.y - (percentSize.y*binScale/2.f));
+            ImVec2 brCorner = ImVec2(percentPos.x + (percentSize.x*binScale/2.f), percentPos.y + (percentSize.y*binScale/2.f));
 
-            double percentD = double(b.badGroupsRefined) / double(b.maxBadGroups);
+            double percentD = std::min(double(getBinGroupsRefined(b.id - 1)) / double(b.maxBadGroups), 1.0);
             int percentInt = lround(percentD * 100.f);
-            std::string percentString = std::to_string(percentInt) + "%";
-            drawList->AddText(font, displayPresets.fontSize, ImVec2(trCorner.x + 5.f, (trCorner.y + brCorner.y)/2.f - displayPresets.fontSize/2.f), ColorValues::lumonBlue, percentString.c_str());
+            char percentText[16];
+            snprintf(percentText, sizeof(percentText), "%d%%", percentInt);
+            drawList->AddText(font, displayPresets.fontSize, ImVec2(trCorner.x + 5.f, (trCorner.y + brCorner.y)/2.f - displayPresets.fontSize/2.f), ColorValues::lumonBlue, percentText);
 
             drawList->AddRectFilled(trCorner, ImVec2(trCorner.x + ((brCorner.x - trCorner.x)* percentD), brCorner.y), ImColor(ColorValues::lumonBlue.Value.x, ColorValues::lumonBlue.Value.y, ColorValues::lumonBlue.Value.z, 0.3f));
-
-            // Animate bin open
-            if (numberRefiningToBin && *numberRefiningToBin == b.id - 1) {
-                std::string binOpenPath = "bins/bin-open.png";
-                auto [widthO, heightO] = imageDisplay->getImageSize(binOpenPath);
-                ImGui::SetCursorPos(ImVec2(pos.x - windowPos.x - (widthO*displayPresets.binImageScale/2.f), pos.y - windowPos.y - (heightO*displayPresets.binImageScale/2.f) - (height*displayPresets.binImageScale)));
-                imageDisplay->drawImGuiImage(binOpenPath, displayPresets.binImageScale, ColorValues::lumonBlue);
-            }
         }
     }
 
@@ -306,40 +909,57 @@ private:
         float bottomLineY = windowPos.y + windowSize.y - displayPresets.numberWindowBufferBottom;
         drawLine(bottomLineY);
         drawLine(bottomLineY + displayPresets.lineGraphicsSpacing);
+
+        // Dividers between split screen viewports, along their left and top edges inside the numbers area
+        for (const auto &viewport : viewports) {
+            float numbersTop = viewport.pos.y + viewport.insetTop;
+            float numbersBottom = viewport.pos.y + viewport.size.y - viewport.insetBottom;
+            if (viewport.pos.x > windowPos.x) {
+                drawList->AddLine(ImVec2(viewport.pos.x, numbersTop), ImVec2(viewport.pos.x, numbersBottom), ColorValues::lumonBlue, displayPresets.lineThickness);
+            }
+            if (viewport.insetTop == 0.f) {
+                drawList->AddLine(ImVec2(viewport.pos.x, numbersTop), ImVec2(viewport.pos.x + viewport.size.x, numbersTop), ColorValues::lumonBlue, displayPresets.lineThickness);
+            }
+        }
     }
 
-    bool updateViewport(const ImVec2& windowSize)
+    // Only the focused viewport takes keyboard and wheel input
+    bool updateViewport(Viewport& viewport, bool focused)
     {
-        static bool viewportInit = false;
-        bool viewportChanged = !viewportInit;
-        
-        // Handle mouse wheel for up/down movement
-        float mouseWheel = ImGui::GetIO().MouseWheel;
-        if (mouseWheel != 0.0f) {
-            // Positive wheel = scroll up, negative wheel = scroll down
-            // So we invert the sign to make scrolling feel natural
-            panelOffset.y += controlSettings.arrowSensitivity * mouseWheel;
-            viewportChanged = true;
-        }
-        
-        // Handle left/right arrow key input (keeping these unchanged as requested)
-        if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow)) {
-            panelOffset.x += controlSettings.arrowSensitivity;
-            viewportChanged = true;
-        } else if (ImGui::IsKeyPressed(ImGuiKey_RightArrow)) {
-            panelOffset.x -= controlSettings.arrowSensitivity;
-            viewportChanged = true;
-        }
+        bool viewportChanged = !viewport.initialized || viewport.dirty;
+        viewport.dirty = false;
+        auto &panelOffset = viewport.panelOffset;
+        auto &panelScale = viewport.panelScale;
+
+        if (focused) {
+            // Handle mouse wheel for up/down movement
+            float mouseWheel = ImGui::GetIO().MouseWheel;
+            if (mouseWheel != 0.0f) {
+                // Positive wheel = scroll up, negative wheel = scroll down
+                // So we invert the sign to make scrolling feel natural
+                panelOffset.y += controlSettings.arrowSensitivity * mouseWheel;
+                viewportChanged = true;
+            }
 
-        // Remove up/down arrow key handling as we're replacing with mouse wheel
+            // Handle left/right arrow key input (keeping these unchanged as requested)
+            if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow)) {
+                panelOffset.x += controlSettings.arrowSensitivity;
+                viewportChanged = true;
+            } else if (ImGui::IsKeyPressed(ImGuiKey_RightArrow)) {
+                panelOffset.x -= controlSettings.arrowSensitivity;
+                viewportChanged = true;
+            }
+
+            // Remove up/down arrow key handling as we're replacing with mouse wheel
 
-        // Handle zoom
-        if (ImGui::IsKeyPressed(ImGuiKey_Comma)) {
-            panelScale -= controlSettings.zoomSensitivity;
-            viewportChanged = true;
-        } else if (ImGui::IsKeyPressed(ImGuiKey_Period)) {
-            panelScale += controlSettings.zoomSensitivity;
-            viewportChanged = true;
+            // Handle zoom
+            if (ImGui::IsKeyPressed(ImGuiKey_Comma)) {
+                panelScale -= controlSettings.zoomSensitivity;
+                viewportChanged = true;
+            } else if (ImGui::IsKeyPressed(ImGuiKey_Period)) {
+                panelScale += controlSettings.zoomSensitivity;
+                viewportChanged = true;
+            }
         }
         panelScale = std::clamp(panelScale, displaySettings.minZoomScale, displaySettings.maxZoomScale);
 
@@ -348,22 +968,22 @@ private:
             float gridWidthScaled  = gridSize * displaySettings.gridSpacing * panelScale;
             float gridHeightScaled = gridSize * displaySettings.gridSpacing * panelScale;
 
-            float minOffsetX = -gridWidthScaled + windowSize.x;
+            float minOffsetX = -gridWidthScaled + viewport.size.x;
             float maxOffsetX = 0;
-            float minOffsetY = -gridHeightScaled + windowSize.y - displayPresets.numberWindowBufferTop;
-            float maxOffsetY = displayPresets.numberWindowBufferTop;
+            float minOffsetY = -gridHeightScaled + viewport.size.y - viewport.insetTop;
+            float maxOffsetY = viewport.insetTop;
 
-            if (!viewportInit) {
+            if (!viewport.initialized) {
                 // Start at center of grid
-                panelOffset.x = (windowSize.x - gridWidthScaled) / 2.0f / panelScale;
-                panelOffset.y = (windowSize.y - gridHeightScaled) / 2.0f / panelScale;
+                panelOffset.x = (viewport.size.x - gridWidthScaled) / 2.0f / panelScale;
+                panelOffset.y = (viewport.size.y - gridHeightScaled) / 2.0f / panelScale;
             }
 
             panelOffset.x = std::clamp(panelOffset.x, minOffsetX / panelScale, maxOffsetX / panelScale);
             panelOffset.y = std::clamp(panelOffset.y, minOffsetY / panelScale, maxOffsetY / panelScale);
         }
 
-        viewportInit = true;
+        viewport.initialized = true;
         return viewportChanged;
     }
 
@@ -383,6 +1003,14 @@ private:
         ImGui::InputFloat("Min Scale Multiplier", &displaySettings.minZoomScale);
         ImGui::InputFloat("Max Scale Multiplier", &displaySettings.maxZoomScale);
         ImGui::InputFloat("Refined to Bin Speed", &displaySettings.refinedToBinSpeed);
+        ImGui::InputInt("Max Active Bad Groups", &displaySettings.maxActiveBadGroups);
+        ImGui::SliderFloat("Numbers Render Scale", &displaySettings.gridRenderScale, 0.25f, 1.f);
+        ImGui::Checkbox("Auto Render Scale", &displaySettings.gridRenderScaleAuto);
+        ImGui::InputInt("Minimap From Grid Size", &displaySettings.minimapMinGridSize);
+        ImGui::InputFloat("Numbers GPU Budget (ms)", &displaySettings.gridGpuBudgetMs);
+        if (displaySettings.gridRenderScaleAuto) {
+            ImGui::Text("Current Render Scale: %.2f", gridLayer->getScale());
+        }
         ImGui::InputText("Header Text", &displaySettings.headerText[0], displaySettings.headerText.capacity() + 1);
         ImGui::Text("Noise:");
         ImGui::InputFloat("Noise Speed", &displaySettings.noiseSpeed);
@@ -394,6 +1022,10 @@ private:
         ImGui::Separator();
         ImGui::Text("Debug:");
         ImGui::Checkbox("revealMap", &revealMap);
+        if (gpuTimer->isSupported()) {
+            auto gpuMs = [&](GpuSpan span) { return gpuTimer->getLastTime(span).value_or(0.0); };
+            ImGui::Text("GPU (ms): grid %.2f, overlays %.2f, submit %.2f", gpuMs(GpuSpan::Grid), gpuMs(GpuSpan::Overlays), gpuMs(GpuSpan::Submit));
+        }
     }
 
     bool updateDisplaySettings(PresetDisplaySettings &settings, float globalScale)
@@ -420,6 +1052,8 @@ private:
         settings.settingsFontScale *= newScale;
         settings.lineGraphicsSpacing *= newScale;
         settings.lineThickness *= newScale;
+        settings.minimapSize *= newScale;
+        settings.minimapMargin *= newScale;
 
         lastViewportSize = viewportSize;
         lastGlobalScale = globalScale;
@@ -440,14 +1074,34 @@ private:
         return 1.0f;
     }
 
-    int gridSize = 100;
+    int gridSize;
     std::shared_ptr<ImageDisplay> imageDisplay;
     std::shared_ptr<NumberGrid> numberGrid;
 
+    // Drained from the grid once a frame. The two trade buffers, so this is reserved like the grid's queue.
+    static constexpr size_t gridEventsReserve = 1024;
+    std::vector<GridEvent> gridEvents;
+    std::shared_ptr<Minimap> minimap;
+
+    // Refine activity for offline analysis, when --journal is given
+    std::shared_ptr<RefineJournal> refineJournal;
+
+    // Shared session, when --sync is given
+    std::shared_ptr<SessionSync> sessionSync;
+    std::vector<SyncDelta> syncDeltas;
+    // Indexed by group id, refines that count towards another kiosk's bins
+    std::vector<bool> remoteRefinedGroups;
+    // By cell index, digits from other kiosks for numbers still on their way to a bin here
+    std::unordered_map<size_t, uint8_t> remoteDigits;
+
     ImFont* font;
 
-    ImVec2 panelOffset = ImVec2(0,0);
-    float panelScale = 0.15f;
+    static constexpr int maxViewports = 4;
+    std::vector<Viewport> viewports;
+    // Each viewport's visibleRange, as the grid and minimap take them
+    std::vector<GridRect> visibleRanges;
+    size_t focusedViewport = 0;
+    std::vector<uint32_t> pendingRefines;
 
     std::string settingsSavePath = "./settings.json";
     DisplaySettings displaySettings;
@@ -457,6 +1111,26 @@ private:
 
     siv::PerlinNoise perlin{ 555 };
     int t = 0;
+    unsigned int seed;
+
+    // Grid drawing is split into this many bands per thread so uneven bands still balance out
+    static constexpr int bandsPerThread = 2;
+    std::shared_ptr<WorkerPool> workerPool;
+    // Per-frame temporaries, reset before every ImGui frame
+    std::shared_ptr<ScratchArena> scratchArena;
+
+    // Digit images are indexed by digit, bin images by bin id - 1 followed by the shared bin graphics
+    std::shared_ptr<const ImageAtlas> digitAtlas;
+    std::shared_ptr<const ImageAtlas> binAtlas;
+    static constexpr int binPercentImage = binCount;
+    static constexpr int binOpenImage = binCount + 1;
+
+    std::shared_ptr<FrameProfiler> frameProfiler;
+    std::shared_ptr<GpuTimer> gpuTimer;
+    uint64_t lastGpuFrame = 0;
+    std::shared_ptr<ScaledLayer> gridLayer;
+
+    std::shared_ptr<RefineAnimator> refineAnimator = createRefineAnimator();
 
     // Debug options
     bool revealMap = false;
@@ -476,13 +1150,15 @@ private:
 
         int badGroupsRefined = 0;
         int maxBadGroups = 0;
+        int refinesStarted = 0;
+        int numbersRefined = 0;
 
         ImVec2 updatePos(const ImVec2 &windowSize, const ImVec2 &windowPos, float offsetY) {
             pos = ImVec2(windowPos.x + (windowSize.x / 6.f)*id, windowPos.y + windowSize.y - offsetY);
             return pos;
         }
     };
-    std::array<Bin, 5> bins = {Bin{1}, Bin{2}, Bin{3}, Bin{4}, Bin{5}};
+    std::array<Bin, binCount> bins = {Bin{1}, Bin{2}, Bin{3}, Bin{4}, Bin{5}};
 
     ImVec2 lastViewportSize = ImVec2(1280, 720);
     float lastGlobalScale = 1.f;
@@ -496,8 +1172,8 @@ private:
         const float padding = 20.0f;
         const float logoSize = 40.0f;
         
-        // Add debug output to verify menu dimensions and window size
-        std::cout << "Window size: " << windowSize.x << "x" << windowSize.y << ", Menu: " << menuWidth << "x" << menuHeight << std::endl;
+        // Debug output to verify menu dimensions and window size, drawn every frame while open
+        LOG_RATE_LIMITED(LogLevel::Debug, 1, "Window size: %.0fx%.0f, Menu: %.0fx%.0f", windowSize.x, windowSize.y, menuWidth, menuHeight);
         
         // Center menu on screen
         ImVec2 menuPos = ImVec2(
@@ -604,7 +1280,18 @@ private:
     }
 };
 
-std::shared_ptr<NumbersPanel> createNumbersPanel(const std::shared_ptr<ImageDisplay>& imageDisplay)
+std::shared_ptr<NumbersPanel> createNumbersPanel(const std::shared_ptr<ImageDisplay>& imageDisplay, const std::shared_ptr<FrameProfiler>& frameProfiler,
+                                                 const std::shared_ptr<GpuTimer>& gpuTimer, const std::shared_ptr<ScratchArena>& scratchArena, const LaunchOptions& options)
 {
-    return std::make_shared<NumbersPanelImpl>(imageDisplay);
+    std::shared_ptr<NumberGrid> numberGrid;
+    if (options.datasetPath) {
+        numberGrid = loadNumberGrid(*options.datasetPath, options.seed);
+        if (!numberGrid) {
+            LOG_ERROR("Can't start without the dataset %s", options.datasetPath->c_str());
+            return nullptr;
+        }
+    } else {
+        numberGrid = createNumberGrid(options.gridSize, options.seed);
+    }
+    return std::make_shared<NumbersPanelImpl>(std::move(numberGrid), imageDisplay, frameProfiler, gpuTimer, scratchArena, options);
 }
\ No newline at end of file
@@ -1,7 +1,14 @@
 #pragma once
 #include <memory>
+#include <string>
 
+class FrameProfiler;
+class GpuTimer;
+struct ControlCommand;
 class ImageDisplay;
+class MetricsRegistry;
+class ScratchArena;
+struct LaunchOptions;
 
 class NumbersPanel {
 public:
@@ -13,7 +20,15 @@ public:
 
     virtual void triggerLoadAnimation() = 0;
 
+    // Viewport, activation, refine and state requests from the control socket
+    virtual std::string handleCommand(const ControlCommand& command) = 0;
+
+    virtual void publishMetrics(MetricsRegistry& metrics) const = 0;
+
     virtual ~NumbersPanel() = default;
 };
 
-std::shared_ptr<NumbersPanel> createNumbersPanel(const std::shared_ptr<ImageDisplay>& imageDisplay);
\ No newline at end of file
+// Returns nullptr if the --dataset file can't be loaded. Falling back to a generated grid would only
+// hide the mistake, and a kiosk of a shared session would end up on a grid the others don't have.
+std::shared_ptr<NumbersPanel> createNumbersPanel(const std::shared_ptr<ImageDisplay>& imageDisplay, const std::shared_ptr<FrameProfiler>& frameProfiler,
+                                                 const std::shared_ptr<GpuTimer>& gpuTimer, const std::shared_ptr<ScratchArena>& scratchArena, const LaunchOptions& options);
\ No newline at end of file
@@ -1,7 +1,8 @@
 #pragma once
 
+#include "Log.h"
+
 #include <fstream>
-#include <iostream>
 #include <optional>
 #include <json.hpp>
 
@@ -24,6 +25,9 @@ struct PresetDisplaySettings
 
     float lineGraphicsSpacing = 10.f;
     float lineThickness = 5.f;
+
+    float minimapSize = 150.f;
+    float minimapMargin = 15.f;
 };
 
 // Helpers
@@ -32,7 +36,7 @@ inline std::optional<nlohmann::json> loadSettingsFromJson(const std::string& jso
     try {
         std::ifstream file(jsonPath);
         if (!file.is_open()) {
-            std::cerr << "Error: Cannot open settings file: " << jsonPath << std::endl;
+            LOG_ERROR("Cannot open settings file: %s", jsonPath.c_str());
             return std::nullopt;
         }
 
@@ -40,7 +44,7 @@ inline std::optional<nlohmann::json> loadSettingsFromJson(const std::string& jso
         file >> json;
         return json;
     } catch (const std::exception& e) {
-        std::cerr << "Error loading json: " << e.what() << std::endl;
+        LOG_ERROR("Error loading json: %s", e.what());
     }
 
     return std::nullopt;
@@ -50,16 +54,16 @@ inline void saveSettingsJson(const nlohmann::json& settingsJson, const std::stri
     try {
         std::ofstream file(jsonPath);
         if (!file.is_open()) {
-            std::cerr << "Error: Cannot open file for writing: " << jsonPath << std::endl;
+            LOG_ERROR("Cannot open file for writing: %s", jsonPath.c_str());
             return;
         }
 
         file << settingsJson.dump(4);
         file.flush();
         file.close();
-        std::cout << "Settings saved to disk." << std::endl;
+        LOG_INFO("Settings saved to disk.");
     } catch (const std::exception& e) {
-        std::cerr << "Error saving settings: " << e.what() << std::endl;
+        LOG_ERROR("Error saving settings: %s", e.what());
     }
 }
 
@@ -81,9 +85,21 @@ struct DisplaySettings
 
     float refinedToBinSpeed = 3.0f;
 
+    // Bad groups that can be active at once, raise for denser 'stress' scenes
+    int maxActiveBadGroups = 1;
+
+    // Numbers layer resolution as a fraction of the screen, or adjusted to keep its GPU time under budget
+    float gridRenderScale = 1.f;
+    bool gridRenderScaleAuto = false;
+    float gridGpuBudgetMs = 4.f;
+
+    // The minimap is shown for grids at least this many cells wide, 0 always shows it
+    int minimapMinGridSize = 101;
+
     std::string headerText = "@andrewchilicki";
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(DisplaySettings,
+    // Missing keys keep their defaults so settings files from older builds still load
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(DisplaySettings,
             globalScale,
             imageScale,
             gridSpacing,
@@ -95,6 +111,11 @@ struct DisplaySettings
             noiseScale,
             noiseScaleOffset,
             refinedToBinSpeed,
+            maxActiveBadGroups,
+            gridRenderScale,
+            gridRenderScaleAuto,
+            gridGpuBudgetMs,
+            minimapMinGridSize,
             headerText
         );
 };
@@ -104,7 +125,7 @@ struct ControlSettings
     float arrowSensitivity = 25.f;
     float zoomSensitivity = 0.1f;
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(ControlSettings, arrowSensitivity, zoomSensitivity);
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(ControlSettings, arrowSensitivity, zoomSensitivity);
 };
 
 struct Settings
@@ -112,7 +133,7 @@ struct Settings
     DisplaySettings displaySettings;
     ControlSettings controlSettings;
 
-    NLOHMANN_DEFINE_TYPE_INTRUSIVE(Settings, displaySettings, controlSettings);
+    NLOHMANN_DEFINE_TYPE_INTRUSIVE_WITH_DEFAULT(Settings, displaySettings, controlSettings);
 };
 
 inline std::optional<Settings> loadSettings(const std::string& jsonPath)
@@ -122,7 +143,7 @@ inline std::optional<Settings> loadSettings(const std::string& jsonPath)
             return json->get<Settings>();
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error loading settings: " << e.what() << std::endl;
+        LOG_ERROR("Error loading settings: %s", e.what());
     }
     return std::nullopt;
 }
@@ -132,6 +153,6 @@ inline void saveSettings(const Settings& settings, const std::string& jsonPath)
         nlohmann::json json = settings;
         saveSettingsJson(json, jsonPath);
     } catch (const std::exception& e) {
-        std::cerr << "Error saving settings: " << e.what() << std::endl;
+        LOG_ERROR("Error saving settings: %s", e.what());
     }
 }
\ No newline at end of file
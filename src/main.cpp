@@ -1,59 +1,198 @@
+#include "AppFrame.h"
+#include "Control/ControlServer.h"
+#include "Headless/HeadlessRunner.h"
+#include "LaunchOptions.h"
+#include "Input/InputReplay.h"
+#include "Input/LatencyProbe.h"
+#include "Profiling/AllocationTracker.h"
+#include "Profiling/FrameProfiler.h"
+#include "Profiling/PerfCounters.h"
+#include "Rendering/FramePacer.h"
+#include "Rendering/GpuTimer.h"
+#include "Rendering/StreamingRenderer.h"
+#include "Telemetry/MetricsRegistry.h"
+#include "Telemetry/MetricsServer.h"
 #include "UI/UIManager.h"
+#include "Log.h"
+
+#include "Rendering/GL.h"
 
 #include "imgui.h"
 #include "backends/imgui_impl_glfw.h"
+#define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 #include <imgui_impl_opengl3.h>
-#include <iostream>
 
 void glfw_error_callback(int error, const char* description) {
-    std::cerr << "GLFW Error (" << error << "): " << description << std::endl;
+    LOG_ERROR("GLFW Error (%d): %s", error, description);
 }
 
 int main(int argc, char** argv) {
+    LaunchOptions options = parseLaunchOptions(argc, argv);
+
+    // Headless runs go through EGL and never touch GLFW or a display server
+    if (options.headless) {
+        return runHeadless(options);
+    }
+
     // Set error callback
     glfwSetErrorCallback(glfw_error_callback);
 
     // Initialize GLFW
     if (!glfwInit()) {
-        std::cerr << "Failed to initialize GLFW!" << std::endl;
+        LOG_ERROR("Failed to initialize GLFW!");
         return -1;
     }
 
-    bool fullscreen = false;
-    for (int i = 1; i < argc; ++i) {
-        if (strcmp(argv[i], "--full-screen") == 0) {
-            fullscreen = true;
-            break;
+    // Replays reuse the recorded seed and window size so every frame matches the original session
+    std::shared_ptr<InputPlayer> inputPlayer;
+    if (options.replayPath) {
+        inputPlayer = createInputPlayer(*options.replayPath);
+        if (!inputPlayer) {
+            glfwTerminate();
+            return -1;
         }
+        options.seed = inputPlayer->getSeed();
+        options.fullscreen = false;
+        LOG_INFO("Replaying %d frames from %s (seed %u)", inputPlayer->getFrameCount(), options.replayPath->c_str(), options.seed);
     }
 
-    GLFWwindow* window;
-    if (fullscreen)
-    {
-        GLFWmonitor* primaryMonitor = glfwGetPrimaryMonitor();
-        const GLFWvidmode* mode = glfwGetVideoMode(primaryMonitor);
-        window = glfwCreateWindow(mode->width, mode->height, "MDR Severance", primaryMonitor, nullptr);
-    } else
-    {
-        window = glfwCreateWindow(1920, 1080, "MDR Severance", nullptr, nullptr);
+    auto createWindow = [&]() -> GLFWwindow* {
+        if (inputPlayer)
+        {
+            auto displaySize = inputPlayer->getDisplaySize();
+            return glfwCreateWindow(static_cast<int>(displaySize.x), static_cast<int>(displaySize.y), "MDR Severance", nullptr, nullptr);
+        } else if (options.fullscreen)
+        {
+            GLFWmonitor* primaryMonitor = glfwGetPrimaryMonitor();
+            const GLFWvidmode* mode = glfwGetVideoMode(primaryMonitor);
+            return glfwCreateWindow(mode->width, mode->height, "MDR Severance", primaryMonitor, nullptr);
+        }
+        return glfwCreateWindow(1920, 1080, "MDR Severance", nullptr, nullptr);
+    };
+
+#ifdef LUMON_GLES
+    // Native GLES through EGL, 3.0 where the driver has it and 2.0 otherwise
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_ES_API);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+    GLFWwindow* window = createWindow();
+    if (!window) {
+        LOG_WARNING("No GLES 3.0 context, trying GLES 2.0");
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 2);
+        window = createWindow();
     }
+#else
+    GLFWwindow* window = createWindow();
+#endif
 
     if (!window) {
-        std::cerr << "Failed to create GLFW window!" << std::endl;
+        LOG_ERROR("Failed to create GLFW window!");
         glfwTerminate();
         return -1;
     }
 
     // Set the OpenGL context
     glfwMakeContextCurrent(window);
-    glfwSwapInterval(1); // Enable vsync
+    glfwSwapInterval(options.swapInterval);
+    LOG_INFO("GL context: %s (%s)", reinterpret_cast<const char*>(glGetString(GL_VERSION)), reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+#ifdef LUMON_GLES
+    if (!hasElementIndexUint()) {
+        LOG_ERROR("GLES 2.0 context without GL_OES_element_index_uint, the grid needs 32-bit indices");
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return -1;
+    }
+#endif
+
+    std::shared_ptr<GpuTimer> gpuTimer = createGpuTimer();
+    // Only replays and --frame-times look back over the frames, a kiosk left running keeps just the last one
+    size_t historyFrames = 0;
+    if (inputPlayer) {
+        historyFrames = static_cast<size_t>(inputPlayer->getFrameCount());
+    } else if (options.frameTimesPath) {
+        // A minute at 60 Hz before the first doubling
+        historyFrames = 3600;
+    }
+    std::shared_ptr<FrameProfiler> frameProfiler = createFrameProfiler(historyFrames, options.perfCounters ? createPerfCounters() : nullptr);
+    std::shared_ptr<UIManager> uiManager = createUIManager(options, frameProfiler, gpuTimer);
+    if (!uiManager) {
+        gpuTimer.reset();
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return -1;
+    }
+
+    // Before ImGui's backend, which chains to the probe's callbacks. Replayed input never goes through GLFW.
+    std::shared_ptr<LatencyProbe> latencyProbe;
+    if (!inputPlayer) {
+        latencyProbe = createLatencyProbe(window);
+    }
+    uiManager->init(window);
+
+    // Without vsync the app has to pace itself
+    std::shared_ptr<FramePacer> framePacer;
+    if (options.lowLatency || options.swapInterval == 0) {
+        double refreshRate = options.refreshRate.value_or(0.0);
+        if (refreshRate <= 0.0) {
+            GLFWmonitor* monitor = glfwGetWindowMonitor(window);
+            if (!monitor) {
+                monitor = glfwGetPrimaryMonitor();
+            }
+            const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+            refreshRate = mode && mode->refreshRate > 0 ? mode->refreshRate : 60.0;
+        }
+        framePacer = createFramePacer(refreshRate, options.swapInterval != 0);
+        LOG_INFO("Low latency pacing at %.2f Hz, %s", refreshRate, options.swapInterval != 0 ? "vsync" : "no vsync");
+    }
+
+    std::shared_ptr<StreamingRenderer> streamingRenderer;
+    if (options.streamingRenderer) {
+        streamingRenderer = createStreamingRenderer(frameProfiler, options.framesInFlight);
+        if (!streamingRenderer) {
+            LOG_WARNING("Falling back to the default renderer");
+        }
+    }
+
+    // Published every frame, scraped from the server's own thread
+    std::shared_ptr<MetricsRegistry> metrics;
+    std::shared_ptr<MetricsServer> metricsServer;
+    if (options.metricsAddress) {
+        metrics = createMetricsRegistry();
+        metricsServer = createMetricsServer(*options.metricsAddress, metrics);
+        if (!metricsServer) {
+            metrics.reset();
+        }
+    }
+
+    std::shared_ptr<ControlServer> controlServer;
+    if (options.controlSocket) {
+        controlServer = createControlServer(*options.controlSocket);
+    }
+
+    std::optional<AllocationCheck> allocationCheck;
+    if (options.allocCheckWarmupFrames) {
+        allocationCheck.emplace(*options.allocCheckWarmupFrames);
+    }
+
+    std::shared_ptr<InputRecorder> inputRecorder;
+    if (options.recordPath) {
+        int width, height;
+        glfwGetWindowSize(window, &width, &height);
+        inputRecorder = createInputRecorder(*options.recordPath, options.seed, ImVec2(static_cast<float>(width), static_cast<float>(height)));
+        LOG_INFO("Recording input to %s (seed %u)", options.recordPath->c_str(), options.seed);
+    }
 
-    std::shared_ptr<UIManager> uiManager = createUIManager();
-    uiManager->init();
     while (!glfwWindowShouldClose(window)) {
-        // Poll events
+        // Wait for the last moment before the deadline, then poll
+        if (framePacer) {
+            framePacer->waitForFrameStart();
+        }
         glfwPollEvents();
+        if (latencyProbe) {
+            latencyProbe->latchFrame();
+        }
 
         // Close application with 'ESCAPE' key
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
@@ -66,26 +205,65 @@ int main(int argc, char** argv) {
         // Start ImGui frame
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
 
-        // Draw
-        uiManager->draw();
+        // Swap live input for the recording, or capture it
+        if (inputPlayer && !inputPlayer->injectFrame()) {
+            break;
+        }
+        if (inputRecorder) {
+            inputRecorder->captureFrame();
+        }
 
-        // Update
-        uiManager->update();
+        // Scripted commands land between frames, after input so a hover isn't overwritten
+        if (controlServer) {
+            controlServer->applyPendingCommands(*uiManager);
+        }
+
+        runAppFrame(*uiManager, *frameProfiler, *gpuTimer, streamingRenderer.get(), metrics.get());
+        if (allocationCheck) {
+            allocationCheck->checkFrame(*frameProfiler);
+        }
 
-        // Render ImGui
-        ImGui::Render();
-        ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+        if (framePacer) {
+            framePacer->frameBuilt();
+        }
 
         // Swap buffers
         glfwSwapBuffers(window);
+        if (framePacer) {
+            framePacer->frameSwapped();
+        }
+        if (latencyProbe) {
+            latencyProbe->frameSwapped(*frameProfiler);
+        }
+    }
+
+    if (inputRecorder) {
+        inputRecorder->save();
+    }
+    if (options.frameTimesPath) {
+        frameProfiler->writeFrameTimes(*options.frameTimesPath);
+    }
+    if (inputPlayer) {
+        getLogger().flush();
+        frameProfiler->printSummary();
     }
 
     // Cleanup
+    latencyProbe.reset();
+    controlServer.reset();
+    metricsServer.reset();
+    streamingRenderer.reset();
     uiManager->cleanup();
+    // GL objects (layer targets, timer queries) go while the context is still current
+    uiManager.reset();
+    gpuTimer.reset();
     glfwDestroyWindow(window);
     glfwTerminate();
 
+    if (allocationCheck && !allocationCheck->passed()) {
+        LOG_ERROR("Allocation check failed: %d frame(s) allocated after warm-up", allocationCheck->getFailedFrames());
+        return 1;
+    }
     return 0;
-}
\ No newline at end of file
+}
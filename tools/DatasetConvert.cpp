@@ -0,0 +1,401 @@
+// Converts a grid written as CSV or JSON into a dataset file for --dataset.
+//
+// Usage: lumon_dataset [--chunk-size 64] [--seed n] input.csv|input.json output.lmd
+//
+// CSV: one line per grid row, one field per cell. A field is the cell's digit, and a bad cell adds
+// '@' and the bin its group goes to, e.g. "7@3". Bad cells touching each other, diagonals included,
+// with the same bin form one group.
+//
+// JSON: {"rows": ["0123...", ...], "groups": [{"bin": 3, "cells": [[x, y], ...]}, ...]}, one
+// string of digits per row and groups listed explicitly.
+//
+// The grid has to be square. Input is read row by row straight into the mapped output, so a CSV
+// far larger than memory converts fine; JSON is parsed whole and suits smaller, curated grids.
+// --seed picks the digits' small horizontal offsets, which aren't part of either input.
+
+#include "GridDatasetFormat.h"
+#include "Number.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <json.hpp>
+#include <random>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t defaultChunkSize = 64;
+    constexpr uint32_t countBlock = 16;
+
+    // Builds the dataset in a shared mapping of the output. Until finish() a cell's group id is a
+    // provisional label, merged with its neighbours' labels through a union-find.
+    class DatasetWriter
+    {
+    public:
+        DatasetWriter(std::string path, uint32_t chunkSize, unsigned int seed) : path(std::move(path)), generator(seed)
+        {
+            header.chunkSize = chunkSize;
+            header.countBlock = std::min(countBlock, chunkSize);
+        }
+
+        ~DatasetWriter()
+        {
+            if (cells) {
+                munmap(cells, header.cellsBytes());
+            }
+            if (fd >= 0) {
+                close(fd);
+                if (!finished) {
+                    unlink(path.c_str());
+                }
+            }
+        }
+
+        bool create(uint32_t gridSize)
+        {
+            if (gridSize == 0 || gridSize > gridDataset::maxGridSize) {
+                std::cerr << "Grids can be 1 to " << gridDataset::maxGridSize << " cells wide, not " << gridSize << std::endl;
+                return false;
+            }
+            header.gridSize = gridSize;
+            header.cellsOffset = gridDataset::cellsAlignment;
+
+            fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0 || ftruncate(fd, static_cast<off_t>(header.cellsOffset + header.cellsBytes())) != 0) {
+                std::cerr << "Can't create " << path << ": " << strerror(errno) << std::endl;
+                return false;
+            }
+            void* mapping = mmap(nullptr, header.cellsBytes(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, static_cast<off_t>(header.cellsOffset));
+            if (mapping == MAP_FAILED) {
+                std::cerr << "Can't map " << path << ": " << strerror(errno) << std::endl;
+                return false;
+            }
+            cells = static_cast<uint8_t*>(mapping);
+
+            // Padding cells past the grid edge stay like this
+            uint8_t empty[gridDataset::cellSize];
+            gridDataset::encodeCell(gridDataset::noGroup, gridDataset::settledFade, 0, false, empty);
+            for (uint64_t offset = 0; offset < header.cellsBytes(); offset += gridDataset::cellSize) {
+                memcpy(cells + offset, empty, sizeof(empty));
+            }
+            return true;
+        }
+
+        uint32_t getGridSize() const { return header.gridSize; }
+
+        // A new provisional group, joined to others with join()
+        uint32_t addLabel(int bin)
+        {
+            labelParents.push_back(static_cast<uint32_t>(labelParents.size()));
+            labelBins.push_back(static_cast<uint8_t>(bin));
+            return labelParents.back();
+        }
+
+        int getLabelBin(uint32_t label) const { return labelBins[label]; }
+
+        void join(uint32_t a, uint32_t b)
+        {
+            a = findLabel(a);
+            b = findLabel(b);
+            if (a != b) {
+                labelParents[std::max(a, b)] = std::min(a, b);
+            }
+        }
+
+        void setCell(uint32_t x, uint32_t y, int digit, uint32_t label)
+        {
+            gridDataset::encodeCell(label, gridDataset::settledFade, static_cast<uint8_t>(digit), std::bernoulli_distribution(0.5)(generator),
+                                    cells + header.cellOffset(x, y));
+        }
+
+        uint32_t getCellLabel(uint32_t x, uint32_t y) const
+        {
+            return static_cast<uint32_t>(gridDataset::get(cells + header.cellOffset(x, y), 4));
+        }
+
+        void setCellLabel(uint32_t x, uint32_t y, uint32_t label)
+        {
+            gridDataset::put(cells + header.cellOffset(x, y), label, 4);
+        }
+
+        // Numbers the groups in the order the grid first reaches them and writes the tables
+        bool finish()
+        {
+            std::vector<uint32_t> groupIds(labelParents.size(), gridDataset::noGroup);
+            std::vector<gridDataset::Group> groups;
+            std::vector<uint32_t> counts(static_cast<size_t>(header.blocksPerSide()) * header.blocksPerSide(), 0);
+            for (uint32_t x = 0; x < header.gridSize; x++) {
+                for (uint32_t y = 0; y < header.gridSize; y++) {
+                    uint32_t label = getCellLabel(x, y);
+                    if (label == gridDataset::noGroup) {
+                        continue;
+                    }
+                    uint32_t root = findLabel(label);
+                    if (groupIds[root] == gridDataset::noGroup) {
+                        groupIds[root] = static_cast<uint32_t>(groups.size());
+                        auto &group = groups.emplace_back();
+                        group.bin = labelBins[root];
+                        group.minX = group.maxX = static_cast<int32_t>(x);
+                        group.minY = group.maxY = static_cast<int32_t>(y);
+                    }
+                    auto &group = groups[groupIds[root]];
+                    group.numberCount++;
+                    group.minX = std::min(group.minX, static_cast<int32_t>(x));
+                    group.minY = std::min(group.minY, static_cast<int32_t>(y));
+                    group.maxX = std::max(group.maxX, static_cast<int32_t>(x) + 1);
+                    group.maxY = std::max(group.maxY, static_cast<int32_t>(y) + 1);
+                    setCellLabel(x, y, groupIds[root]);
+                    counts[static_cast<size_t>(x / header.countBlock) * header.blocksPerSide() + y / header.countBlock]++;
+                }
+            }
+
+            header.groupCount = static_cast<uint32_t>(groups.size());
+            header.groupsOffset = header.cellsOffset + header.cellsBytes();
+            header.countsOffset = header.groupsOffset + groups.size() * gridDataset::groupSize;
+
+            std::vector<uint8_t> tables(groups.size() * gridDataset::groupSize + counts.size() * 4);
+            for (size_t i = 0; i < groups.size(); i++) {
+                gridDataset::encodeGroup(groups[i], &tables[i * gridDataset::groupSize]);
+            }
+            uint8_t* countsOut = &tables[groups.size() * gridDataset::groupSize];
+            for (size_t i = 0; i < counts.size(); i++) {
+                gridDataset::put(countsOut + i * 4, counts[i], 4);
+            }
+            uint8_t headerBytes[gridDataset::headerSize];
+            gridDataset::encodeHeader(header, headerBytes);
+
+            if (msync(cells, header.cellsBytes(), MS_SYNC) != 0 || !writeAt(tables.data(), tables.size(), header.groupsOffset) ||
+                !writeAt(headerBytes, sizeof(headerBytes), 0) || fsync(fd) != 0) {
+                std::cerr << "Failed to write " << path << ": " << strerror(errno) << std::endl;
+                return false;
+            }
+            finished = true;
+            std::cout << "Wrote " << path << ": " << header.gridSize << "x" << header.gridSize << " cells in chunks of " << header.chunkSize << ", "
+                      << groups.size() << " bad group(s), " << header.countsOffset + counts.size() * 4 << " bytes" << std::endl;
+            return true;
+        }
+
+    private:
+        uint32_t findLabel(uint32_t label)
+        {
+            while (labelParents[label] != label) {
+                labelParents[label] = labelParents[labelParents[label]];
+                label = labelParents[label];
+            }
+            return label;
+        }
+
+        bool writeAt(const uint8_t* data, size_t size, uint64_t offset)
+        {
+            while (size > 0) {
+                ssize_t result = pwrite(fd, data, size, static_cast<off_t>(offset));
+                if (result < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (result <= 0) {
+                    return false;
+                }
+                data += result;
+                size -= static_cast<size_t>(result);
+                offset += static_cast<uint64_t>(result);
+            }
+            return true;
+        }
+
+        std::string path;
+        std::mt19937 generator;
+        gridDataset::Header header;
+        int fd = -1;
+        uint8_t* cells = nullptr;
+        bool finished = false;
+
+        std::vector<uint32_t> labelParents;
+        std::vector<uint8_t> labelBins;
+    };
+
+    std::vector<std::string> splitFields(const std::string& line)
+    {
+        std::vector<std::string> fields;
+        size_t start = 0;
+        for (;;) {
+            size_t end = line.find(',', start);
+            auto field = line.substr(start, end == std::string::npos ? std::string::npos : end - start);
+            field.erase(0, field.find_first_not_of(" \t"));
+            field.erase(field.find_last_not_of(" \t\r") + 1);
+            fields.push_back(std::move(field));
+            if (end == std::string::npos) {
+                return fields;
+            }
+            start = end + 1;
+        }
+    }
+
+    bool convertCsv(std::istream& in, DatasetWriter& writer)
+    {
+        std::string line;
+        uint32_t y = 0;
+        while (std::getline(in, line)) {
+            if (line.find_first_not_of(" \t\r") == std::string::npos) {
+                continue;
+            }
+            auto fields = splitFields(line);
+            if (y == 0 && !writer.create(static_cast<uint32_t>(fields.size()))) {
+                return false;
+            }
+            if (y >= writer.getGridSize() || fields.size() != writer.getGridSize()) {
+                std::cerr << "Row " << y + 1 << " has " << fields.size() << " cell(s), the grid has to be " << writer.getGridSize() << " square" << std::endl;
+                return false;
+            }
+
+            for (uint32_t x = 0; x < fields.size(); x++) {
+                const auto &field = fields[x];
+                bool valid = !field.empty() && field[0] >= '0' && field[0] <= '9';
+                int bin = 0;
+                if (valid && field.size() > 1) {
+                    valid = field.size() == 3 && field[1] == '@' && field[2] >= '1' && field[2] < '1' + binCount;
+                    bin = field[2] - '0';
+                }
+                if (!valid) {
+                    std::cerr << "Row " << y + 1 << ", column " << x + 1 << ": expected a digit, or a digit, '@' and a bin 1-" << binCount
+                              << ", not \"" << field << "\"" << std::endl;
+                    return false;
+                }
+
+                uint32_t label = gridDataset::noGroup;
+                if (bin > 0) {
+                    // Neighbours already written: left, and the three above
+                    const int neighbours[4][2] = {{-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+                    for (const auto &offset : neighbours) {
+                        int nx = static_cast<int>(x) + offset[0], ny = static_cast<int>(y) + offset[1];
+                        if (nx < 0 || ny < 0 || nx >= static_cast<int>(writer.getGridSize())) {
+                            continue;
+                        }
+                        uint32_t neighbour = writer.getCellLabel(static_cast<uint32_t>(nx), static_cast<uint32_t>(ny));
+                        if (neighbour == gridDataset::noGroup || writer.getLabelBin(neighbour) != bin - 1) {
+                            continue;
+                        }
+                        if (label == gridDataset::noGroup) {
+                            label = neighbour;
+                        } else {
+                            writer.join(label, neighbour);
+                        }
+                    }
+                    if (label == gridDataset::noGroup) {
+                        label = writer.addLabel(bin - 1);
+                    }
+                }
+                writer.setCell(x, y, field[0] - '0', label);
+            }
+            y++;
+        }
+        if (y != writer.getGridSize() || y == 0) {
+            std::cerr << "The grid has " << y << " row(s), it has to be square" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool convertJson(std::istream& in, DatasetWriter& writer)
+    {
+        nlohmann::json document;
+        try {
+            document = nlohmann::json::parse(in);
+        } catch (const nlohmann::json::exception& e) {
+            std::cerr << "Invalid JSON: " << e.what() << std::endl;
+            return false;
+        }
+        if (!document.contains("rows") || !document["rows"].is_array()) {
+            std::cerr << "Expected an object with a \"rows\" array" << std::endl;
+            return false;
+        }
+
+        const auto &rows = document["rows"];
+        if (!writer.create(static_cast<uint32_t>(rows.size()))) {
+            return false;
+        }
+        for (uint32_t y = 0; y < rows.size(); y++) {
+            std::string row = rows[y].is_string() ? rows[y].get<std::string>() : std::string();
+            if (row.size() != rows.size() || row.find_first_not_of("0123456789") != std::string::npos) {
+                std::cerr << "Row " << y + 1 << " has to be a string of " << rows.size() << " digit(s)" << std::endl;
+                return false;
+            }
+            for (uint32_t x = 0; x < row.size(); x++) {
+                writer.setCell(x, y, row[x] - '0', gridDataset::noGroup);
+            }
+        }
+
+        if (!document.contains("groups")) {
+            return true;
+        }
+        uint32_t gridSize = writer.getGridSize();
+        for (const auto &group : document["groups"]) {
+            int bin = group.value("bin", 0);
+            if (bin < 1 || bin > binCount || !group.contains("cells") || !group["cells"].is_array()) {
+                std::cerr << "Every group needs a \"bin\" of 1-" << binCount << " and a \"cells\" array" << std::endl;
+                return false;
+            }
+            uint32_t label = writer.addLabel(bin - 1);
+            for (const auto &position : group["cells"]) {
+                if (!position.is_array() || position.size() != 2 || !position[0].is_number_integer() || !position[1].is_number_integer()) {
+                    std::cerr << "Group cells have to be [x, y] pairs" << std::endl;
+                    return false;
+                }
+                int x = position[0].get<int>(), y = position[1].get<int>();
+                if (x < 0 || y < 0 || static_cast<uint32_t>(x) >= gridSize || static_cast<uint32_t>(y) >= gridSize) {
+                    std::cerr << "Group cell [" << x << ", " << y << "] is outside the grid" << std::endl;
+                    return false;
+                }
+                if (writer.getCellLabel(static_cast<uint32_t>(x), static_cast<uint32_t>(y)) != gridDataset::noGroup) {
+                    std::cerr << "Cell [" << x << ", " << y << "] is in more than one group" << std::endl;
+                    return false;
+                }
+                writer.setCellLabel(static_cast<uint32_t>(x), static_cast<uint32_t>(y), label);
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t chunkSize = defaultChunkSize;
+    unsigned int seed = 0;
+    std::vector<std::string> paths;
+    bool validArgs = true;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--chunk-size") == 0 && i + 1 < argc) {
+            chunkSize = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            validArgs = validArgs && gridDataset::isPowerOfTwo(chunkSize) && chunkSize <= 1024;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (argv[i][0] == '-') {
+            validArgs = false;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (!validArgs || paths.size() != 2) {
+        std::cerr << "Usage: " << argv[0] << " [--chunk-size 64] [--seed n] input.csv|input.json output.lmd" << std::endl;
+        std::cerr << "Chunk sizes are powers of two up to 1024 cells" << std::endl;
+        return 1;
+    }
+
+    std::ifstream in(paths[0], std::ios::binary);
+    if (!in) {
+        std::cerr << "Can't open " << paths[0] << std::endl;
+        return 1;
+    }
+    bool json = paths[0].size() >= 5 && paths[0].compare(paths[0].size() - 5, 5, ".json") == 0;
+
+    DatasetWriter writer(paths[1], chunkSize, seed);
+    bool converted = json ? convertJson(in, writer) : convertCsv(in, writer);
+    return converted && writer.finish() ? 0 : 1;
+}
@@ -0,0 +1,231 @@
+// Summarises refinement journals written with --journal.
+//
+// Usage: lumon_journal [--csv records.csv] journal.000001.lmj [journal.000002.lmj ...]
+//
+// Files are read in the order they were written, and may come from several runs. Reports
+// refines started and groups refined per bin and viewport, how long groups took from refine to
+// their last number landing, refines per hour, and any records lost to a full queue or a crash.
+
+#include "Journal/JournalFormat.h"
+#include "Numbers/Number.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    struct JournalFile
+    {
+        std::string path;
+        journal::Header header;
+        std::vector<journal::Record> records;
+        // Bytes after the last good record, from a write cut short or a corrupt record
+        size_t trailingBytes = 0;
+    };
+
+    struct BinSummary
+    {
+        uint64_t refinesStarted = 0;
+        uint64_t remoteRefinesStarted = 0;
+        uint64_t groupsRefined = 0;
+        uint64_t numbersRefined = 0;
+        std::vector<double> refineSeconds;
+    };
+
+    std::optional<JournalFile> readJournal(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            std::cerr << "Can't open " << path << std::endl;
+            return std::nullopt;
+        }
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        JournalFile journalFile;
+        journalFile.path = path;
+        if (data.size() < journal::headerSize || !journal::decodeHeader(data.data(), journalFile.header)) {
+            std::cerr << path << " is not a refinement journal (or was written by a newer version)" << std::endl;
+            return std::nullopt;
+        }
+
+        size_t offset = journal::headerSize;
+        journal::Record record;
+        while (offset + journal::recordSize <= data.size() && journal::decodeRecord(&data[offset], record)) {
+            journalFile.records.push_back(record);
+            offset += journal::recordSize;
+        }
+        journalFile.trailingBytes = data.size() - offset;
+        return journalFile;
+    }
+
+    std::string formatTime(uint64_t micros)
+    {
+        time_t seconds = static_cast<time_t>(micros / 1000000);
+        char text[32];
+        strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", localtime(&seconds));
+        return text;
+    }
+
+    double percentile(std::vector<double>& values, double fraction)
+    {
+        if (values.empty()) {
+            return 0.0;
+        }
+        size_t index = std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()));
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index];
+    }
+
+    void writeCsv(const std::string& path, const std::vector<JournalFile>& files)
+    {
+        std::ofstream out(path);
+        out << "file_index,sequence,time_us,type,bin,remote,viewport,group,numbers,bin_count\n";
+        for (const auto &file : files) {
+            for (const auto &record : file.records) {
+                out << file.header.fileIndex << ',' << record.sequence << ',' << record.timeMicros << ','
+                    << (record.type == journal::RecordType::RefineStarted ? "refine_started" : "group_refined") << ','
+                    << record.bin + 1 << ',' << ((record.flags & journal::remoteFlag) ? 1 : 0) << ','
+                    << (record.viewport == journal::noViewport ? -1 : record.viewport) << ',' << record.groupId << ','
+                    << record.numberCount << ',' << record.binCount << '\n';
+            }
+        }
+        std::cout << "Wrote records to " << path << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string csvPath;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--csv") == 0 && i + 1 < argc) {
+            csvPath = argv[++i];
+        } else if (argv[i][0] == '-') {
+            paths.clear();
+            break;
+        } else {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--csv records.csv] journal.000001.lmj [journal.000002.lmj ...]" << std::endl;
+        return 1;
+    }
+
+    std::vector<JournalFile> files;
+    for (const auto &path : paths) {
+        if (auto file = readJournal(path)) {
+            files.push_back(std::move(*file));
+        }
+    }
+    if (files.empty()) {
+        return 1;
+    }
+    std::stable_sort(files.begin(), files.end(), [](const JournalFile& a, const JournalFile& b) {
+        return a.header.createdMicros != b.header.createdMicros ? a.header.createdMicros < b.header.createdMicros : a.header.fileIndex < b.header.fileIndex;
+    });
+
+    std::array<BinSummary, binCount> bins;
+    std::map<int, uint64_t> viewportRefines;
+    std::map<std::string, uint64_t> hourlyRefines;
+    // Refine start per group, matched by the GroupRefined record of the same run
+    std::unordered_map<uint32_t, uint64_t> refineStarts;
+    uint64_t recordCount = 0, lostRecords = 0, unmatchedCompletions = 0;
+    uint64_t firstTime = UINT64_MAX, lastTime = 0;
+    // Sequence expected next, 0 at the start of a run
+    uint64_t nextSequence = 0;
+
+    for (const auto &file : files) {
+        std::cout << file.path << ": file " << file.header.fileIndex << ", seed " << file.header.seed << ", grid " << file.header.gridSize
+                  << ", created " << formatTime(file.header.createdMicros) << ", " << file.records.size() << " record(s)";
+        if (file.trailingBytes > 0) {
+            std::cout << ", " << file.trailingBytes << " unreadable byte(s) at the end";
+        }
+        std::cout << std::endl;
+
+        // A new run restarts sequence numbers and group ids at its first file
+        if (file.records.empty() || file.records.front().sequence == 0) {
+            nextSequence = 0;
+            refineStarts.clear();
+        }
+        for (const auto &record : file.records) {
+            recordCount++;
+            if (record.sequence > nextSequence) {
+                lostRecords += record.sequence - nextSequence;
+            }
+            nextSequence = static_cast<uint64_t>(record.sequence) + 1;
+            firstTime = std::min(firstTime, record.timeMicros);
+            lastTime = std::max(lastTime, record.timeMicros);
+
+            if (record.bin >= binCount) {
+                continue;
+            }
+            auto &bin = bins[record.bin];
+            bool remote = record.flags & journal::remoteFlag;
+            if (record.type == journal::RecordType::RefineStarted) {
+                (remote ? bin.remoteRefinesStarted : bin.refinesStarted)++;
+                bin.numbersRefined += record.numberCount;
+                viewportRefines[record.viewport]++;
+                hourlyRefines[formatTime(record.timeMicros).substr(0, 13) + ":00"]++;
+                refineStarts[record.groupId] = record.timeMicros;
+            } else if (record.type == journal::RecordType::GroupRefined) {
+                bin.groupsRefined++;
+                auto start = refineStarts.find(record.groupId);
+                if (start == refineStarts.end()) {
+                    unmatchedCompletions++;
+                    continue;
+                }
+                bin.refineSeconds.push_back(static_cast<double>(record.timeMicros - start->second) / 1e6);
+                refineStarts.erase(start);
+            }
+        }
+    }
+
+    std::cout << "\n" << recordCount << " record(s)";
+    if (recordCount > 0) {
+        std::cout << " from " << formatTime(firstTime) << " to " << formatTime(lastTime);
+    }
+    std::cout << std::endl;
+    if (lostRecords > 0) {
+        std::cout << lostRecords << " record(s) missing from the sequence, dropped while the journal queue was full" << std::endl;
+    }
+    if (unmatchedCompletions > 0) {
+        std::cout << unmatchedCompletions << " group(s) finished refining without a refine start in these files" << std::endl;
+    }
+
+    std::cout << "\nBin  Started  Remote  Refined  Numbers  Refine s p50 / p90 / max" << std::endl;
+    for (int b = 0; b < binCount; b++) {
+        auto &bin = bins[b];
+        char line[160];
+        auto maxSeconds = bin.refineSeconds.empty() ? 0.0 : *std::max_element(bin.refineSeconds.begin(), bin.refineSeconds.end());
+        snprintf(line, sizeof(line), "%3d  %7llu  %6llu  %7llu  %7llu  %6.2f / %6.2f / %6.2f", b + 1,
+                 static_cast<unsigned long long>(bin.refinesStarted), static_cast<unsigned long long>(bin.remoteRefinesStarted),
+                 static_cast<unsigned long long>(bin.groupsRefined), static_cast<unsigned long long>(bin.numbersRefined),
+                 percentile(bin.refineSeconds, 0.5), percentile(bin.refineSeconds, 0.9), maxSeconds);
+        std::cout << line << std::endl;
+    }
+
+    std::cout << "\nRefines started per viewport:" << std::endl;
+    for (const auto &[viewport, count] : viewportRefines) {
+        std::cout << "  " << (viewport == journal::noViewport ? std::string("none") : std::to_string(viewport)) << ": " << count << std::endl;
+    }
+    std::cout << "\nRefines started per hour:" << std::endl;
+    for (const auto &[hour, count] : hourlyRefines) {
+        std::cout << "  " << hour << "  " << count << std::endl;
+    }
+
+    if (!csvPath.empty()) {
+        writeCsv(csvPath, files);
+    }
+    return 0;
+}